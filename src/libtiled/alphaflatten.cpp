@@ -0,0 +1,145 @@
+/*
+ * alphaflatten.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "alphaflatten.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ALPHAFLATTEN_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace Tiled;
+
+static inline quint32 flattenPixel(quint32 pixel)
+{
+    return (pixel & 0xFF000000) ? (pixel | 0xFF000000) : pixel;
+}
+
+// Flattened pixels are either fully opaque, so premultiplying doesn't change
+// them, or fully transparent, which premultiplies to zero.  The conversion
+// keeps the top four bits of each channel like QImage::convertToFormat().
+static inline quint16 flattenPixelToARGB4444(quint32 pixel)
+{
+    if (!(pixel & 0xFF000000))
+        return 0;
+    return quint16(0xF000
+                   | ((pixel >> 12) & 0x0F00)
+                   | ((pixel >> 8) & 0x00F0)
+                   | ((pixel >> 4) & 0x000F));
+}
+
+static void flattenRow(quint32 *pixels, int count)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256i alphaMask8 = _mm256_set1_epi32(int(0xFF000000));
+    const __m256i zero8 = _mm256_setzero_si256();
+    for (; i + 8 <= count; i += 8) {
+        __m256i *p = reinterpret_cast<__m256i*>(pixels + i);
+        const __m256i v = _mm256_loadu_si256(p);
+        const __m256i transparent = _mm256_cmpeq_epi32(_mm256_and_si256(v, alphaMask8), zero8);
+        _mm256_storeu_si256(p, _mm256_or_si256(v, _mm256_andnot_si256(transparent, alphaMask8)));
+    }
+#endif
+#ifdef ALPHAFLATTEN_SSE2
+    const __m128i alphaMask = _mm_set1_epi32(int(0xFF000000));
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i *p = reinterpret_cast<__m128i*>(pixels + i);
+        const __m128i v = _mm_loadu_si128(p);
+        const __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(v, alphaMask), zero);
+        _mm_storeu_si128(p, _mm_or_si128(v, _mm_andnot_si128(transparent, alphaMask)));
+    }
+#endif
+    for (; i < count; ++i)
+        pixels[i] = flattenPixel(pixels[i]);
+}
+
+#ifdef ALPHAFLATTEN_SSE2
+static inline __m128i flattenToARGB4444x4(__m128i v)
+{
+    const __m128i alphaMask = _mm_set1_epi32(int(0xFF000000));
+    const __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(v, alphaMask), _mm_setzero_si128());
+    v = _mm_andnot_si128(transparent, _mm_or_si128(v, alphaMask));
+
+    // The top nibble of each channel, then pairs of nibbles side by side:
+    // bits 0-7 hold g,b and bits 16-23 hold a,r.
+    v = _mm_and_si128(_mm_srli_epi32(v, 4), _mm_set1_epi32(0x0F0F0F0F));
+    v = _mm_or_si128(v, _mm_srli_epi32(v, 4));
+    v = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi32(0x000000FF)),
+                     _mm_and_si128(_mm_srli_epi32(v, 8), _mm_set1_epi32(0x0000FF00)));
+
+    // Bias into signed range so the saturating pack keeps every value.
+    return _mm_sub_epi32(v, _mm_set1_epi32(0x8000));
+}
+#endif
+
+static void flattenRowToARGB4444(const quint32 *src, quint16 *dst, int count)
+{
+    int i = 0;
+#ifdef ALPHAFLATTEN_SSE2
+    const __m128i bias = _mm_set1_epi16(short(0x8000));
+    for (; i + 8 <= count; i += 8) {
+        const __m128i lo = flattenToARGB4444x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        const __m128i hi = flattenToARGB4444x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                         _mm_add_epi16(_mm_packs_epi32(lo, hi), bias));
+    }
+#endif
+    for (; i < count; ++i)
+        dst[i] = flattenPixelToARGB4444(src[i]);
+}
+
+void Tiled::flattenAlpha(QImage &image, const QRect &rect)
+{
+    Q_ASSERT(image.format() == QImage::Format_ARGB32);
+    const QRect r = rect.isNull() ? image.rect() : (rect & image.rect());
+    if (r.isEmpty())
+        return;
+    for (int y = r.top(); y <= r.bottom(); ++y) {
+        quint32 *pixels = reinterpret_cast<quint32*>(image.scanLine(y));
+        flattenRow(pixels + r.left(), r.width());
+    }
+}
+
+QImage Tiled::flattenAlphaToARGB4444(const QImage &image)
+{
+    Q_ASSERT(image.format() == QImage::Format_ARGB32);
+    QImage result(image.size(), QImage::Format_ARGB4444_Premultiplied);
+    if (result.isNull())
+        return result;
+    for (int y = 0; y < image.height(); ++y) {
+        flattenRowToARGB4444(reinterpret_cast<const quint32*>(image.constScanLine(y)),
+                             reinterpret_cast<quint16*>(result.scanLine(y)),
+                             image.width());
+    }
+    return result;
+}
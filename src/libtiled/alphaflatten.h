@@ -0,0 +1,58 @@
+/*
+ * alphaflatten.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ALPHAFLATTEN_H
+#define ALPHAFLATTEN_H
+
+#include "tiled_global.h"
+
+#include <QImage>
+#include <QRect>
+
+namespace Tiled {
+
+/**
+ * Makes every pixel in \a rect of \a image that isn't fully transparent
+ * fully opaque, leaving its color alone.  This is how map thumbnails and the
+ * mini-map hide the soft edges of scaled-down tiles.
+ *
+ * \a image must be in QImage::Format_ARGB32.  A null \a rect means the whole
+ * image, otherwise it is clipped to the image.
+ */
+void TILEDSHARED_EXPORT flattenAlpha(QImage &image, const QRect &rect = QRect());
+
+/**
+ * Does the same as flattenAlpha() and converts the result to
+ * QImage::Format_ARGB4444_Premultiplied in a single pass.  \a image must be
+ * in QImage::Format_ARGB32 and is left unchanged.
+ */
+QImage TILEDSHARED_EXPORT flattenAlphaToARGB4444(const QImage &image);
+
+} // namespace Tiled
+
+#endif // ALPHAFLATTEN_H
@@ -126,14 +126,20 @@ QByteArray Tiled::compress(const QByteArray &data, CompressionMethod method)
     strm.avail_out = out.size();
 
     const int windowBits = (method == Gzip) ? 15 + 16 : 15;
+    const int level = (method == ZlibFast) ? Z_BEST_SPEED : Z_DEFAULT_COMPRESSION;
 
-    err = deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits,
+    err = deflateInit2(&strm, level, Z_DEFLATED, windowBits,
                        8, Z_DEFAULT_STRATEGY);
     if (err != Z_OK) {
         logZlibError(err);
         return QByteArray();
     }
 
+    // Usually avoids growing the output buffer below.
+    out.resize(qMax(out.size(), int(deflateBound(&strm, data.length()))));
+    strm.next_out = (Bytef *) out.data();
+    strm.avail_out = out.size();
+
     do {
         err = deflate(&strm, Z_FINISH);
         Q_ASSERT(err != Z_STREAM_ERROR);
@@ -37,7 +37,8 @@ namespace Tiled {
 
 enum CompressionMethod {
     Gzip,
-    Zlib
+    Zlib,
+    ZlibFast    // zlib format at the fastest compression level
 };
 
 /**
@@ -61,6 +62,9 @@ QByteArray TILEDSHARED_EXPORT decompress(const QByteArray &data,
  *
  * Needed because qCompress does not support gzip compression.
  *
+ * ZlibFast produces ordinary zlib data, so it is decompressed like Zlib, but
+ * trades a larger result for much less time spent compressing.
+ *
  * @param data the uncompressed data
  * @return the compressed data, or a null QByteArray if compression failed
  */
@@ -23,6 +23,7 @@
 
 #include "tilelayer.h"
 
+#include <QHash>
 #include <QMap>
 
 namespace Tiled {
@@ -46,14 +47,32 @@ public:
 
     /**
      * Insert the given \a tileset with \a firstGid as its first global ID.
+     *
+     * When writing, several tilesets may share the same \a firstGid (for
+     * example identical tilesets from different sub-maps). Only the last one
+     * inserted is used by gidToCell().
      */
     void insert(uint firstGid, Tileset *tileset)
-    { mFirstGidToTileset.insert(firstGid, tileset); }
+    {
+        mFirstGidToTileset.insert(firstGid, tileset);
+        mTilesetToFirstGid.insert(tileset, firstGid);
+    }
 
     /**
      * Clears the gid mapper, so that it can be reused.
      */
-    void clear() { mFirstGidToTileset.clear(); }
+    void clear()
+    {
+        mFirstGidToTileset.clear();
+        mTilesetToFirstGid.clear();
+    }
+
+    /**
+     * Returns the first global ID of the given \a tileset, or 0 when the
+     * tileset isn't known.
+     */
+    uint firstGid(const Tileset *tileset) const
+    { return mTilesetToFirstGid.value(tileset); }
 
     /**
      * Returns true when no tilesets are known to this gid mapper.
@@ -81,6 +100,7 @@ public:
 
 private:
     QMap<uint, Tileset*> mFirstGidToTileset;
+    QHash<const Tileset*, uint> mTilesetToFirstGid;
     QMap<const Tileset*, int> mTilesetColumnCounts;
 };
 
@@ -253,6 +253,9 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
     bool shifted = inUpperHalf ^ inLeftHalf;
 
     QTransform baseTransform = painter->transform();
+#ifdef ZOMBOID
+    CellRenderer cellRenderer(painter);
+#endif
 
     for (int y = startPos.y(); y - tileHeight < rect.bottom();
          y += tileHeight / 2)
@@ -262,7 +265,7 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
         for (int x = startPos.x(); x < rect.right(); x += tileWidth) {
 #ifdef ZOMBOID
             // Multi-threading
-            if (mAbortDrawing && *mAbortDrawing) {
+            if (isDrawingAborted()) {
                 painter->setTransform(baseTransform);
                 return;
             }
@@ -308,11 +311,10 @@ void IsometricRenderer::drawTileLayer(QPainter *painter,
                     }
 
                     const QTransform transform(m11, m12, m21, m22, dx, dy);
-                    painter->setTransform(transform * baseTransform);
-
 #ifdef ZOMBOID
-                    painter->drawImage(0, 0, img);
+                    cellRenderer.render(img, transform);
 #else
+                    painter->setTransform(transform * baseTransform);
                     painter->drawPixmap(0, 0, img);
 #endif
                 }
@@ -401,9 +403,10 @@ void IsometricRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *l
     /*static*/ QVector<const Cell*> cells(40); // or QVarLengthArray
     /*static*/ QVector<qreal> opacities(40); // or QVarLengthArray
 
-    layerGroup->prepareDrawing(this, rect);
+    if (!layerGroupsPrepared())
+        layerGroup->prepareDrawing(this, rect);
 
-    qreal opacity = painter->opacity();
+    CellRenderer cellRenderer(painter);
 
     for (int y = startPos.y(); y - tileHeight < rect.bottom();
          y += tileHeight / 2)
@@ -415,7 +418,7 @@ void IsometricRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *l
             if (layerGroup->orderedCellsAt(columnItr, cells, opacities)) {
                 for (int i = 0; i < cells.size(); i++) {
                     // Multi-threading
-                    if (mAbortDrawing && *mAbortDrawing) {
+                    if (isDrawingAborted()) {
                         painter->setTransform(baseTransform);
                         return;
                     }
@@ -455,11 +458,7 @@ void IsometricRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *l
                         }
 
                         const QTransform transform(m11, m12, m21, m22, dx, dy);
-                        painter->setTransform(transform * baseTransform);
-
-                        painter->setOpacity(opacities[i] * opacity);
-
-                        painter->drawImage(0, 0, img);
+                        cellRenderer.render(img, transform, opacities[i]);
                     }
                 }
             }
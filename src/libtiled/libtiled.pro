@@ -23,6 +23,13 @@ DEFINES += ZOMBOID
 contains(QT_CONFIG, reduce_exports): CONFIG += hide_symbols
 #OBJECTS_DIR = .obj
 SOURCES += compression.cpp \
+    lotfilereader.cpp \
+    lotfilewriter.cpp \
+    lotsquaregrid.cpp \
+    alphaflatten.cpp \
+    mapbinarycache.cpp \
+    tilesetbinarycache.cpp \
+    taskrunner.cpp \
     imagelayer.cpp \
     isometricrenderer.cpp \
     layer.cpp \
@@ -34,6 +41,7 @@ SOURCES += compression.cpp \
     objectgroup.cpp \
     orthogonalrenderer.cpp \
     properties.cpp \
+    regionbitmap.cpp \
     staggeredrenderer.cpp \
     tilelayer.cpp \
     tileset.cpp \
@@ -42,6 +50,13 @@ SOURCES += compression.cpp \
     ztilelayergroup.cpp \
     tile.cpp
 HEADERS += compression.h \
+    lotfilereader.h \
+    lotfilewriter.h \
+    lotsquaregrid.h \
+    alphaflatten.h \
+    mapbinarycache.h \
+    tilesetbinarycache.h \
+    taskrunner.h \
     imagelayer.h \
     isometricrenderer.h \
     layer.h \
@@ -54,6 +69,7 @@ HEADERS += compression.h \
     objectgroup.h \
     orthogonalrenderer.h \
     properties.h \
+    regionbitmap.h \
     staggeredrenderer.h \
     tile.h \
     tiled_global.h \
@@ -0,0 +1,226 @@
+/*
+ * lotfilereader.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "lotfilereader.h"
+
+#include <QDataStream>
+#include <QFile>
+
+using namespace Tiled;
+
+LotFileReader::LotFileReader() :
+    mVersion(0)
+{
+}
+
+bool LotFileReader::read(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        mError = tr("Could not open file for reading.\n%1").arg(file.errorString());
+        return false;
+    }
+    return read(file.readAll());
+}
+
+bool LotFileReader::read(const QByteArray &data)
+{
+    mError.clear();
+    mTileNames.clear();
+    mRooms.clear();
+    mBuildings.clear();
+    mGrid.reset(0, 0, 0);
+
+    QDataStream in(data);
+    in.setByteOrder(QDataStream::LittleEndian);
+    if (!readHeader(in, data.size()))
+        return false;
+
+    const int chunkCount = chunksX() * chunksY();
+    QVector<qint64> positions(chunkCount);
+    for (int m = 0; m < chunkCount; m++)
+        in >> positions[m];
+    if (in.status() != QDataStream::Ok) {
+        mError = tr("The chunk table is truncated.");
+        return false;
+    }
+    const qint64 dataPosition = in.device()->pos();
+
+    QVector<uint> idToGid(mTileNames.size());
+    for (int id = 0; id < idToGid.size(); id++)
+        idToGid[id] = uint(id);
+
+    for (int cy = 0; cy < chunksY(); cy++) {
+        for (int cx = 0; cx < chunksX(); cx++) {
+            const qint64 pos = positions[cx + cy * chunksX()];
+            bool ok = (pos >= dataPosition) && (pos < data.size());
+            if (ok) {
+                QDataStream chunk(QByteArray::fromRawData(data.constData() + pos, int(data.size() - pos)));
+                chunk.setByteOrder(QDataStream::LittleEndian);
+                ok = mGrid.decodeChunk(chunk, cx, cy, idToGid);
+            }
+            if (!ok) {
+                mError = tr("Chunk %1,%2 is corrupt.").arg(cx).arg(cy);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+QStringList LotFileReader::tileNamesAt(int x, int y, int z) const
+{
+    const int index = mGrid.index(x, y, z);
+    const uint *ids = mGrid.tiles(index);
+    QStringList names;
+    for (int i = 0; i < mGrid.count(index); i++)
+        names += mTileNames[int(ids[i])];
+    return names;
+}
+
+// Every count in the header is checked against the size of the file, so a
+// corrupt file can't make us allocate more than it could possibly hold.
+bool LotFileReader::readHeader(QDataStream &in, qint64 size)
+{
+    quint8 magic[4];
+    for (quint8 &c : magic)
+        in >> c;
+    if (in.status() != QDataStream::Ok || magic[0] != 'P' || magic[1] != 'Z'
+            || magic[2] != 'B' || magic[3] != 'Y') {
+        mError = tr("Not a .pzby file.");
+        return false;
+    }
+
+    qint32 version;
+    in >> version;
+    if (in.status() != QDataStream::Ok || version != 0) {
+        mError = tr("Unsupported .pzby version %1.").arg(version);
+        return false;
+    }
+    mVersion = version;
+
+    qint32 tileCount;
+    in >> tileCount;
+    if (tileCount < 0 || tileCount > size) {
+        mError = tr("The tile table is corrupt.");
+        return false;
+    }
+    mTileNames.reserve(tileCount);
+    for (int i = 0; i < tileCount && in.status() == QDataStream::Ok; i++)
+        mTileNames += readString(in);
+
+    qint32 chunksX, chunksY, levels;
+    in >> chunksX >> chunksY >> levels;
+    if (in.status() != QDataStream::Ok || chunksX <= 0 || chunksY <= 0
+            || levels <= 0 || levels > 64
+            || qint64(chunksX) * chunksY * qint64(sizeof(qint64) * 2) > size) {
+        mError = tr("The header is corrupt.");
+        return false;
+    }
+
+    qint32 roomCount;
+    in >> roomCount;
+    if (roomCount < 0 || roomCount > size) {
+        mError = tr("The room list is corrupt.");
+        return false;
+    }
+    mRooms.resize(roomCount);
+    for (Room &room : mRooms) {
+        room.name = readString(in);
+        qint32 level, rectCount;
+        in >> level >> rectCount;
+        room.level = level;
+        if (in.status() != QDataStream::Ok || rectCount < 0 || rectCount > size)
+            break;
+        room.rects.resize(rectCount);
+        for (QRect &rect : room.rects) {
+            qint32 x, y, w, h;
+            in >> x >> y >> w >> h;
+            rect.setRect(x, y, w, h);
+        }
+        qint32 objectCount;
+        in >> objectCount;
+        if (in.status() != QDataStream::Ok || objectCount < 0 || objectCount > size)
+            break;
+        room.objects.resize(objectCount);
+        for (RoomObject &object : room.objects) {
+            qint32 metaEnum, x, y;
+            in >> metaEnum >> x >> y;
+            object.metaEnum = metaEnum;
+            object.x = x;
+            object.y = y;
+        }
+    }
+    if (in.status() != QDataStream::Ok) {
+        mError = tr("The room list is corrupt.");
+        return false;
+    }
+
+    qint32 buildingCount;
+    in >> buildingCount;
+    if (buildingCount < 0 || buildingCount > size) {
+        mError = tr("The building list is corrupt.");
+        return false;
+    }
+    mBuildings.resize(buildingCount);
+    for (QVector<int> &building : mBuildings) {
+        qint32 count;
+        in >> count;
+        if (in.status() != QDataStream::Ok || count < 0 || count > size)
+            break;
+        building.resize(count);
+        for (int &roomID : building) {
+            qint32 id;
+            in >> id;
+            roomID = id;
+        }
+    }
+    if (in.status() != QDataStream::Ok) {
+        mError = tr("The building list is corrupt.");
+        return false;
+    }
+
+    mGrid.reset(chunksX, chunksY, levels);
+    return true;
+}
+
+// LotFileWriter::writeString() writes Latin-1 and ends each string with a
+// newline.
+QString LotFileReader::readString(QDataStream &in)
+{
+    QByteArray bytes;
+    quint8 c;
+    while (true) {
+        in >> c;
+        if (in.status() != QDataStream::Ok || c == '\n')
+            break;
+        bytes += char(c);
+    }
+    return QString::fromLatin1(bytes);
+}
@@ -0,0 +1,128 @@
+/*
+ * lotfilereader.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LOTFILEREADER_H
+#define LOTFILEREADER_H
+
+#include "tiled_global.h"
+
+#include "lotsquaregrid.h"
+
+#include <QCoreApplication>
+#include <QRect>
+#include <QStringList>
+#include <QVector>
+
+namespace Tiled {
+
+/**
+ * Reads a .pzby file as written by NewMapBinaryFile: the tile names, rooms
+ * and buildings from the header, and the squares of every chunk.
+ *
+ * The squares end up in a LotSquareGrid whose tiles are indexes into
+ * tileNames() rather than gids, so a file that was read can be compared
+ * square by square with the cell it was exported from.
+ */
+class TILEDSHARED_EXPORT LotFileReader
+{
+    Q_DECLARE_TR_FUNCTIONS(LotFileReader)
+
+public:
+    struct RoomObject
+    {
+        int metaEnum;
+        int x;
+        int y;
+    };
+
+    struct Room
+    {
+        QString name;
+        int level;
+        QVector<QRect> rects;
+        QVector<RoomObject> objects;
+    };
+
+    LotFileReader();
+
+    bool read(const QString &fileName);
+    bool read(const QByteArray &data);
+
+    QString errorString() const
+    { return mError; }
+
+    int version() const
+    { return mVersion; }
+
+    const QStringList &tileNames() const
+    { return mTileNames; }
+
+    int chunksX() const
+    { return mGrid.chunksX(); }
+
+    int chunksY() const
+    { return mGrid.chunksY(); }
+
+    int levels() const
+    { return mGrid.levels(); }
+
+    const QVector<Room> &rooms() const
+    { return mRooms; }
+
+    /**
+     * The room IDs of each building.
+     */
+    const QVector<QVector<int>> &buildings() const
+    { return mBuildings; }
+
+    const LotSquareGrid &grid() const
+    { return mGrid; }
+
+    /**
+     * The names of the tiles at \a x,\a y on level \a z, bottom to top.
+     */
+    QStringList tileNamesAt(int x, int y, int z) const;
+
+    int roomIDAt(int x, int y, int z) const
+    { return mGrid.roomID(mGrid.index(x, y, z)); }
+
+private:
+    bool readHeader(QDataStream &in, qint64 size);
+    static QString readString(QDataStream &in);
+
+    QString mError;
+    int mVersion;
+    QStringList mTileNames;
+    QVector<Room> mRooms;
+    QVector<QVector<int>> mBuildings;
+    LotSquareGrid mGrid;
+};
+
+} // namespace Tiled
+
+#endif // LOTFILEREADER_H
@@ -0,0 +1,94 @@
+/*
+ * lotfilewriter.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "lotfilewriter.h"
+
+#include <QDataStream>
+
+using namespace Tiled;
+
+void LotFileWriter::writeHeader(QDataStream &out, const QStringList &tileNames,
+                                int chunksX, int chunksY, int levels,
+                                const QVector<LotFileReader::Room> &rooms,
+                                const QVector<QVector<int>> &buildings)
+{
+    out << quint8('P') << quint8('Z') << quint8('B') << quint8('Y');
+    out << qint32(0); // version
+
+    out << qint32(tileNames.size());
+    for (const QString &name : tileNames)
+        writeString(out, name);
+
+    out << qint32(chunksX);
+    out << qint32(chunksY);
+    out << qint32(levels);
+
+    out << qint32(rooms.size());
+    for (const LotFileReader::Room &room : rooms) {
+        writeString(out, room.name);
+        out << qint32(room.level);
+
+        out << qint32(room.rects.size());
+        for (const QRect &rect : room.rects) {
+            out << qint32(rect.x());
+            out << qint32(rect.y());
+            out << qint32(rect.width());
+            out << qint32(rect.height());
+        }
+
+        out << qint32(room.objects.size());
+        for (const LotFileReader::RoomObject &object : room.objects) {
+            out << qint32(object.metaEnum);
+            out << qint32(object.x);
+            out << qint32(object.y);
+        }
+    }
+
+    out << qint32(buildings.size());
+    for (const QVector<int> &building : buildings) {
+        out << qint32(building.size());
+        for (int roomID : building)
+            out << qint32(roomID);
+    }
+}
+
+void LotFileWriter::writeChunkTable(QDataStream &out, const QVector<qint64> &positions)
+{
+    for (qint64 pos : positions)
+        out << pos;
+}
+
+void LotFileWriter::writeString(QDataStream &out, const QString &str)
+{
+    for (int i = 0; i < str.length(); i++) {
+        if (str[i].toLatin1() == '\n')
+            continue;
+        out << quint8(str[i].toLatin1());
+    }
+    out << quint8('\n');
+}
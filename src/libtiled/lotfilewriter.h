@@ -0,0 +1,73 @@
+/*
+ * lotfilewriter.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LOTFILEWRITER_H
+#define LOTFILEWRITER_H
+
+#include "tiled_global.h"
+
+#include "lotfilereader.h"
+
+class QDataStream;
+
+namespace Tiled {
+
+/**
+ * Writes the parts of a .pzby file that LotFileReader reads back: the
+ * header with the tile names, rooms and buildings, and the chunk table.
+ * The chunks themselves are written by LotSquareGrid::encodeChunk().
+ *
+ * The stream must be little-endian.
+ */
+class TILEDSHARED_EXPORT LotFileWriter
+{
+public:
+    /**
+     * Writes the header.  The tiles in the chunks are indexes into
+     * \a tileNames, the room IDs indexes into \a rooms.
+     */
+    static void writeHeader(QDataStream &out, const QStringList &tileNames,
+                            int chunksX, int chunksY, int levels,
+                            const QVector<LotFileReader::Room> &rooms,
+                            const QVector<QVector<int>> &buildings);
+
+    /**
+     * Writes the file position of each chunk, row by row.
+     */
+    static void writeChunkTable(QDataStream &out, const QVector<qint64> &positions);
+
+    /**
+     * Writes \a str as Latin-1 followed by a newline.  Newlines in \a str
+     * are dropped.
+     */
+    static void writeString(QDataStream &out, const QString &str);
+};
+
+} // namespace Tiled
+
+#endif // LOTFILEWRITER_H
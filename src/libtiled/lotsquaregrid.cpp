@@ -0,0 +1,176 @@
+/*
+ * lotsquaregrid.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "lotsquaregrid.h"
+
+#include <QDataStream>
+#include <QtAlgorithms>
+
+using namespace Tiled;
+
+const uint LotSquareGrid::InvalidGid;
+
+LotSquareGrid::LotSquareGrid() :
+    mChunksX(0),
+    mChunksY(0),
+    mLevels(0)
+{
+}
+
+void LotSquareGrid::reset(int chunksX, int chunksY, int levels)
+{
+    mChunksX = chunksX;
+    mChunksY = chunksY;
+    mLevels = levels;
+    const int count = chunksX * chunksY * levels * SquaresPerChunk;
+    mFirst.fill(0, count);
+    mCount.fill(0, count);
+    mRoomID.fill(-1, count);
+    mTiles.resize(0);
+    mOccupied.fill(0, chunksX * chunksY * levels * 2);
+}
+
+bool LotSquareGrid::isChunkEmpty(int cx, int cy) const
+{
+    const int chunk = cx + cy * mChunksX;
+    const quint64 *occupied = mOccupied.constData() + chunk * mLevels * 2;
+    for (int i = 0; i < mLevels * 2; i++) {
+        if (occupied[i])
+            return false;
+    }
+    return true;
+}
+
+void LotSquareGrid::encodeChunk(QDataStream &out, int cx, int cy,
+                                const QVector<qint32> &gidToId) const
+{
+    if (isChunkEmpty(cx, cy)) {
+        out << qint32(-1) << qint32(mLevels * SquaresPerChunk);
+        return;
+    }
+
+    const int chunk = cx + cy * mChunksX;
+
+    // A run of empty squares carries on from one level to the next.
+    int skip = 0;
+    for (int z = 0; z < mLevels; z++) {
+        const int first = (chunk * mLevels + z) * SquaresPerChunk;
+        const quint64 *occupied = mOccupied.constData() + (chunk * mLevels + z) * 2;
+        int next = 0;
+        for (int word = 0; word < 2; word++) {
+            quint64 bits = occupied[word];
+            while (bits) {
+                const int square = word * 64 + int(qCountTrailingZeroBits(bits));
+                bits &= bits - 1;
+                skip += square - next;
+                next = square + 1;
+                if (skip > 0) {
+                    out << qint32(-1) << qint32(skip);
+                    skip = 0;
+                }
+                const int index = first + square;
+                const int count = mCount[index];
+                out << qint32(count + 1) << qint32(mRoomID[index]);
+                const uint *gids = tiles(index);
+                for (int i = 0; i < count; i++) {
+                    Q_ASSERT(gidToId[int(gids[i])] != -1);
+                    out << qint32(gidToId[int(gids[i])]);
+                }
+            }
+        }
+        skip += SquaresPerChunk - next;
+    }
+    if (skip > 0)
+        out << qint32(-1) << qint32(skip);
+}
+
+bool LotSquareGrid::decodeChunk(QDataStream &in, int cx, int cy,
+                                const QVector<uint> &idToGid)
+{
+    struct Square
+    {
+        int index;
+        int roomID;
+        int first;
+        int count;
+    };
+
+    // Decode into lists first, a chunk that fails mustn't leave tiles in
+    // the grid.
+    QVector<Square> squares;
+    QVector<uint> gids;
+    const int first = (cx + cy * mChunksX) * mLevels * SquaresPerChunk;
+    const int squareCount = mLevels * SquaresPerChunk;
+    int square = 0;
+    while (square < squareCount) {
+        qint32 count;
+        in >> count;
+        if (count == -1) {
+            qint32 skip;
+            in >> skip;
+            if (skip <= 0 || skip > squareCount - square)
+                return false;
+            square += skip;
+            continue;
+        }
+        if (count < 2 || count > 0xFFFF)
+            return false;
+        qint32 roomID;
+        in >> roomID;
+        Square s = { first + square, roomID, gids.size(), count - 1 };
+        for (int i = 0; i < count - 1; i++) {
+            qint32 id;
+            in >> id;
+            const uint gid = idToGid.value(id, InvalidGid);
+            if (gid == InvalidGid)
+                return false;
+            gids += gid;
+        }
+        if (in.status() != QDataStream::Ok)
+            return false;
+        squares += s;
+        ++square;
+    }
+
+    for (const Square &s : qAsConst(squares)) {
+        Q_ASSERT(mCount[s.index] == 0);
+        for (int i = 0; i < s.count; i++)
+            addTile(s.index, gids[s.first + i]);
+        mRoomID[s.index] = s.roomID;
+    }
+    return true;
+}
+
+qint64 LotSquareGrid::bytesAllocated() const
+{
+    return qint64(mFirst.capacity()) * sizeof(uint)
+            + qint64(mCount.capacity()) * sizeof(quint16)
+            + qint64(mRoomID.capacity()) * sizeof(qint32)
+            + qint64(mTiles.capacity()) * sizeof(uint)
+            + qint64(mOccupied.capacity()) * sizeof(quint64);
+}
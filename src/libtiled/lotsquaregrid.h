@@ -0,0 +1,143 @@
+/*
+ * lotsquaregrid.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LOTSQUAREGRID_H
+#define LOTSQUAREGRID_H
+
+#include "tiled_global.h"
+
+#include <QVector>
+
+class QDataStream;
+
+namespace Tiled {
+
+/**
+ * The tiles and room IDs of every square in a cell, on every level, as
+ * written to the chunks of a .pzby file.
+ *
+ * Squares are stored chunk by chunk in the order a chunk is written, so
+ * encoding a chunk walks the arrays front to back.  The tile IDs of all
+ * squares share one buffer; square i holds the count(i) IDs starting at
+ * tiles(i).  A square's tiles must be added one after the other.
+ *
+ * Each level of each chunk also has a bitmask of its occupied squares, so
+ * encodeChunk() can jump from one occupied square to the next and write an
+ * empty chunk as a single record.
+ *
+ * reset() keeps the memory already allocated, so filling the grid cell
+ * after cell reuses it instead of allocating per tile.
+ */
+class TILEDSHARED_EXPORT LotSquareGrid
+{
+public:
+    enum {
+        ChunkWidth = 10,
+        ChunkHeight = 10,
+        SquaresPerChunk = ChunkWidth * ChunkHeight
+    };
+
+    LotSquareGrid();
+
+    void reset(int chunksX, int chunksY, int levels);
+
+    int chunksX() const { return mChunksX; }
+    int chunksY() const { return mChunksY; }
+    int levels() const { return mLevels; }
+
+    int index(int x, int y, int z) const
+    {
+        int chunk = (x / ChunkWidth) + (y / ChunkHeight) * mChunksX;
+        int square = (x % ChunkWidth) * ChunkHeight + (y % ChunkHeight);
+        return (chunk * mLevels + z) * SquaresPerChunk + square;
+    }
+
+    void addTile(int index, uint gid)
+    {
+        if (mCount[index] == 0) {
+            mFirst[index] = uint(mTiles.size());
+            mOccupied[(index / SquaresPerChunk) * 2 + (index % SquaresPerChunk) / 64]
+                    |= quint64(1) << ((index % SquaresPerChunk) % 64);
+        }
+        Q_ASSERT(mFirst[index] + mCount[index] == uint(mTiles.size()));
+        Q_ASSERT(mCount[index] < 0xFFFF);
+        mTiles.append(gid);
+        mCount[index]++;
+    }
+
+    const uint *tiles(int index) const
+    { return mTiles.constData() + mFirst[index]; }
+
+    int count(int index) const
+    { return mCount[index]; }
+
+    int roomID(int index) const
+    { return mRoomID[index]; }
+
+    void setRoomID(int index, int roomID)
+    { mRoomID[index] = roomID; }
+
+    bool isChunkEmpty(int cx, int cy) const;
+
+    /**
+     * Writes the chunk at \a cx,\a cy in .pzby format: for every level, the
+     * squares column by column, each either a run of empty squares or a tile
+     * count, room ID and tile IDs.  \a gidToId maps the gids added to the
+     * grid to the IDs in the file's tile table.
+     */
+    void encodeChunk(QDataStream &out, int cx, int cy,
+                     const QVector<qint32> &gidToId) const;
+
+    /**
+     * Reads the chunk at \a cx,\a cy written by encodeChunk(), which must
+     * have no tiles yet.  \a idToGid maps the IDs in the file's tile table
+     * back to gids.  Returns false without changing the grid if the data is
+     * truncated or malformed, or uses an ID that \a idToGid maps to
+     * InvalidGid or doesn't have.
+     */
+    bool decodeChunk(QDataStream &in, int cx, int cy,
+                     const QVector<uint> &idToGid);
+
+    static const uint InvalidGid = 0xFFFFFFFF;
+
+    qint64 bytesAllocated() const;
+
+private:
+    int mChunksX;
+    int mChunksY;
+    int mLevels;
+    QVector<uint> mFirst;
+    QVector<quint16> mCount;
+    QVector<qint32> mRoomID;
+    QVector<uint> mTiles;
+    QVector<quint64> mOccupied; // 2 per level per chunk
+};
+
+} // namespace Tiled
+
+#endif // LOTSQUAREGRID_H
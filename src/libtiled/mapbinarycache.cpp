@@ -0,0 +1,194 @@
+/*
+ * mapbinarycache.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mapbinarycache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QtEndian>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+static const quint32 CACHE_MAGIC = 0x43584D54; // "TMXC"
+static const quint32 CACHE_VERSION = 1;
+static const int HASH_SIZE = 16; // MD5
+static const int HEADER_SIZE = 4 + 4 + 8 + 8 + HASH_SIZE + 4 + 4;
+
+static quint32 align4(quint32 n)
+{
+    return (n + 3) & ~3;
+}
+
+MapBinaryCache::MapBinaryCache()
+    : mData(0)
+    , mTmxModified(0)
+    , mTmxSize(0)
+{
+}
+
+QString MapBinaryCache::cachePath(const QString &tmxPath)
+{
+    return tmxPath + QLatin1String(".cache");
+}
+
+bool MapBinaryCache::open(const QString &cachePath)
+{
+    close();
+
+    mFile.setFileName(cachePath);
+    if (!mFile.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 fileSize = mFile.size();
+    if (fileSize < HEADER_SIZE || fileSize > 0x7FFFFFFF)
+        return false;
+
+    mData = mFile.map(0, fileSize);
+    if (!mData) {
+        mFile.close();
+        return false;
+    }
+
+    const uchar *p = mData;
+    if (qFromLittleEndian<quint32>(p) != CACHE_MAGIC
+            || qFromLittleEndian<quint32>(p + 4) != CACHE_VERSION) {
+        close();
+        return false;
+    }
+    mTmxModified = qFromLittleEndian<qint64>(p + 8);
+    mTmxSize = qFromLittleEndian<qint64>(p + 16);
+    mTmxHash = QByteArray(reinterpret_cast<const char*>(p + 24), HASH_SIZE);
+    p += 24 + HASH_SIZE;
+    const quint32 xmlSize = qFromLittleEndian<quint32>(p);
+    const quint32 blobCount = qFromLittleEndian<quint32>(p + 4);
+    p += 8;
+
+    if (HEADER_SIZE + qint64(blobCount) * 8 + xmlSize > fileSize) {
+        close();
+        return false;
+    }
+
+    mXml.offset = HEADER_SIZE + blobCount * 8;
+    mXml.size = xmlSize;
+
+    mBlobs.resize(blobCount);
+    for (quint32 i = 0; i < blobCount; ++i, p += 8) {
+        Range &blob = mBlobs[i];
+        blob.offset = qFromLittleEndian<quint32>(p);
+        blob.size = qFromLittleEndian<quint32>(p + 4);
+        if (qint64(blob.offset) + blob.size > fileSize) {
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void MapBinaryCache::close()
+{
+    if (mData)
+        mFile.unmap(const_cast<uchar*>(mData));
+    mData = 0;
+    mFile.close();
+    mBlobs.clear();
+}
+
+QByteArray MapBinaryCache::xml() const
+{
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(mData + mXml.offset),
+                                   int(mXml.size));
+}
+
+QByteArray MapBinaryCache::blob(int index) const
+{
+    if (index < 0 || index >= mBlobs.size())
+        return QByteArray();
+    const Range &blob = mBlobs.at(index);
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(mData + blob.offset),
+                                   int(blob.size));
+}
+
+QByteArray MapBinaryCache::hash(const QByteArray &tmxData)
+{
+    return QCryptographicHash::hash(tmxData, QCryptographicHash::Md5);
+}
+
+bool MapBinaryCache::write(const QString &cachePath,
+                           qint64 tmxModified, qint64 tmxSize,
+                           const QByteArray &tmxHash, const QByteArray &xml,
+                           const QVector<QByteArray> &blobs)
+{
+    Q_ASSERT(tmxHash.size() == HASH_SIZE);
+
+    // Written to a temporary file and renamed, so other threads or processes
+    // never see a partial cache.
+    QSaveFile file(cachePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    out << CACHE_MAGIC;
+    out << CACHE_VERSION;
+    out << tmxModified;
+    out << tmxSize;
+    out.writeRawData(tmxHash.constData(), HASH_SIZE);
+    out << quint32(xml.size());
+    out << quint32(blobs.size());
+
+    quint32 offset = align4(HEADER_SIZE + blobs.size() * 8 + xml.size());
+    foreach (const QByteArray &blob, blobs) {
+        out << offset;
+        out << quint32(blob.size());
+        offset = align4(offset + blob.size());
+    }
+
+    static const char padding[4] = { 0, 0, 0, 0 };
+    quint32 pos = HEADER_SIZE + blobs.size() * 8;
+    out.writeRawData(xml.constData(), xml.size());
+    pos += xml.size();
+    out.writeRawData(padding, int(align4(pos) - pos));
+    pos = align4(pos);
+    foreach (const QByteArray &blob, blobs) {
+        out.writeRawData(blob.constData(), blob.size());
+        pos += blob.size();
+        out.writeRawData(padding, int(align4(pos) - pos));
+        pos = align4(pos);
+    }
+
+    if (out.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
+    }
+
+    return file.commit();
+}
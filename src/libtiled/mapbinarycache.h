@@ -0,0 +1,102 @@
+/*
+ * mapbinarycache.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MAPBINARYCACHE_H
+#define MAPBINARYCACHE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+namespace Tiled {
+namespace Internal {
+
+/**
+  * A binary cache of a .tmx file, stored next to it.  The cache holds the
+  * map's XML with every base64 payload (tile layer data, BMP pixels and
+  * no-blend bits) replaced by "#N", plus payload N already decoded and
+  * decompressed.  The cache file is memory-mapped, so the XML and payloads
+  * are read without copying.
+  *
+  * A cache is valid for a .tmx file with the same size and either the same
+  * modification time or the same MD5 hash.
+  */
+class MapBinaryCache
+{
+public:
+    MapBinaryCache();
+
+    static QString cachePath(const QString &tmxPath);
+
+    /**
+      * Memory-maps the given cache file.  Returns false if the file doesn't
+      * exist or isn't a valid cache.
+      */
+    bool open(const QString &cachePath);
+    void close();
+
+    qint64 tmxModified() const { return mTmxModified; }
+    qint64 tmxSize() const { return mTmxSize; }
+    QByteArray tmxHash() const { return mTmxHash; }
+
+    /**
+      * The returned byte arrays reference the mapped file and are valid until
+      * close() is called.
+      */
+    QByteArray xml() const;
+    int blobCount() const { return mBlobs.size(); }
+    QByteArray blob(int index) const;
+
+    static QByteArray hash(const QByteArray &tmxData);
+
+    static bool write(const QString &cachePath,
+                      qint64 tmxModified, qint64 tmxSize,
+                      const QByteArray &tmxHash, const QByteArray &xml,
+                      const QVector<QByteArray> &blobs);
+
+private:
+    struct Range
+    {
+        quint32 offset;
+        quint32 size;
+    };
+
+    QFile mFile;
+    const uchar *mData;
+    qint64 mTmxModified;
+    qint64 mTmxSize;
+    QByteArray mTmxHash;
+    Range mXml;
+    QVector<Range> mBlobs;
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+#endif // MAPBINARYCACHE_H
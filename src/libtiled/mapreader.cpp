@@ -35,12 +35,16 @@
 #include "imagelayer.h"
 #include "objectgroup.h"
 #include "map.h"
+#include "mapbinarycache.h"
 #include "mapobject.h"
 #include "tile.h"
 #include "tilelayer.h"
 #include "tileset.h"
 
 #include <QCoreApplication>
+#ifdef ZOMBOID
+#include <QDateTime>
+#endif
 #include <QDebug>
 #include <QDir>
 #include <QFileInfo>
@@ -50,6 +54,9 @@
 using namespace SharedTools;
 #endif
 #include <QXmlStreamReader>
+#ifdef ZOMBOID
+#include "taskrunner.h"
+#endif
 
 using namespace Tiled;
 using namespace Tiled::Internal;
@@ -66,9 +73,20 @@ public:
         p(mapReader),
         mMap(0),
         mReadingExternalTileset(false)
+#ifdef ZOMBOID
+        , mDecodeLayersInParallel(false)
+        , mUseBinaryCache(false)
+        , mCache(0)
+        , mRecording(false)
+        , mRecordFailed(false)
+        , mRecordCursor(0)
+#endif
     {}
 
     Map *readMap(QIODevice *device, const QString &path);
+#ifdef ZOMBOID
+    Map *readMapCached(const QString &fileName);
+#endif
     Tileset *readTileset(QIODevice *device, const QString &path);
 
 #ifdef ZOMBOID
@@ -82,6 +100,7 @@ public:
 private:
     void readUnknownElement();
 
+    Map *readMapDocument(const QString &path);
     Map *readMap();
 
     Tileset *readTileset();
@@ -90,9 +109,11 @@ private:
 
     TileLayer *readLayer();
     void readLayerData(TileLayer *tileLayer);
-    void decodeBinaryLayerData(TileLayer *tileLayer,
-                               QStringView text,
-                               QStringView compression);
+    QString decodeBinaryLayerData(TileLayer *tileLayer,
+                                  const QByteArray &latin1Text,
+                                  QStringView compression,
+                                  QByteArray *tileDataOut = 0) const;
+    QString setLayerGids(TileLayer *tileLayer, const QByteArray &tileData) const;
     void decodeCSVLayerData(TileLayer *tileLayer, const QString &text);
 
     /**
@@ -125,9 +146,19 @@ private:
     void readBmpImage();
     void readBmpPixels(int index, const QList<QRgb> &colors);
     void decodeBmpPixels(int bmpIndex, const QList<QRgb> &colors, QStringView text);
+    void setBmpPixels(int bmpIndex, const QList<QRgb> &colors, const QByteArray &tileData);
 
     void readNoBlend();
     void decodeNoBlendBits(MapNoBlend *noBlend, QStringView text);
+    void setNoBlendBits(MapNoBlend *noBlend, const QByteArray &tileData);
+
+    void decodePendingLayers();
+
+    bool readTmxData(const QString &fileName, QByteArray &data);
+    bool cachedPayload(QStringView text, QByteArray &data);
+    int recordPayload(QStringView text);
+    void writeCache(const QString &fileName, qint64 tmxModified,
+                    const QByteArray &tmxData);
 #endif
 
     MapReader *p;
@@ -139,19 +170,60 @@ private:
     bool mReadingExternalTileset;
 
     QXmlStreamReader xml;
+
+#ifdef ZOMBOID
+public:
+    bool mDecodeLayersInParallel;
+    bool mUseBinaryCache;
+
+private:
+    // Set while reading the XML held by a MapBinaryCache.
+    const MapBinaryCache *mCache;
+
+    // Set while reading a .tmx file to create a MapBinaryCache from.
+    bool mRecording;
+    bool mRecordFailed;
+    QString mRecordText;
+    int mRecordCursor;
+    QVector<QPair<int,int> > mRecordRanges;
+    QVector<QByteArray> mRecordBlobs;
+
+    /**
+     * Base64 layer data captured during the XML pass, decoded by
+     * decodePendingLayers() once all the tilesets are known.
+     */
+    class PendingLayer
+    {
+    public:
+        TileLayer *mLayer;
+        QByteArray mText; // base64 text, or decoded data from a cache
+        bool mDecoded;
+        QString mCompression;
+        int mRecordIndex;
+        QByteArray mTileData;
+        QString mError;
+    };
+    QList<PendingLayer> mPendingLayers;
+
+    void decodePendingLayer(PendingLayer *pending) const;
+#endif
 };
 
 } // namespace Internal
 } // namespace Tiled
 
 Map *MapReaderPrivate::readMap(QIODevice *device, const QString &path)
+{
+    xml.setDevice(device);
+    return readMapDocument(path);
+}
+
+Map *MapReaderPrivate::readMapDocument(const QString &path)
 {
     mError.clear();
     mPath = path;
     Map *map = 0;
 
-    xml.setDevice(device);
-
     if (xml.readNextStartElement() && xml.name() == QLatin1String("map")) {
         map = readMap();
     } else {
@@ -247,17 +319,32 @@ Map *MapReaderPrivate::readMap()
 
     mMap = new Map(orientation, mapWidth, mapHeight, tileWidth, tileHeight);
 
+#ifdef ZOMBOID
+    // When decoding in parallel, layers are added to the map only after their
+    // data is decoded, since TileLayer::setCell() updates the map.
+    QList<Layer*> layers;
+#endif
+
     while (xml.readNextStartElement()) {
         if (xml.name() == QLatin1String("properties"))
             mMap->mergeProperties(readProperties());
         else if (xml.name() == QLatin1String("tileset"))
             mMap->addTileset(readTileset());
+#ifdef ZOMBOID
+        else if (xml.name() == QLatin1String("layer"))
+            layers += readLayer();
+        else if (xml.name() == QLatin1String("objectgroup"))
+            layers += readObjectGroup();
+        else if (xml.name() == QLatin1String("imagelayer"))
+            layers += readImageLayer();
+#else
         else if (xml.name() == QLatin1String("layer"))
             mMap->addLayer(readLayer());
         else if (xml.name() == QLatin1String("objectgroup"))
             mMap->addLayer(readObjectGroup());
         else if (xml.name() == QLatin1String("imagelayer"))
             mMap->addLayer(readImageLayer());
+#endif
 #ifdef ZOMBOID
         else if (xml.name() == QLatin1String("bmp-settings"))
             readBmpSettings();
@@ -270,6 +357,15 @@ Map *MapReaderPrivate::readMap()
             readUnknownElement();
     }
 
+#ifdef ZOMBOID
+    if (!xml.hasError())
+        decodePendingLayers();
+    mPendingLayers.clear();
+
+    foreach (Layer *layer, layers)
+        mMap->addLayer(layer);
+#endif
+
     // Clean up in case of error
     if (xml.hasError()) {
         // The tilesets are not owned by the map
@@ -486,9 +582,34 @@ void MapReaderPrivate::readLayerData(TileLayer *tileLayer)
             }
         } else if (xml.isCharacters() && !xml.isWhitespace()) {
             if (encoding == QLatin1String("base64")) {
-                decodeBinaryLayerData(tileLayer,
-                                      xml.text(),
-                                      compression);
+#ifdef ZOMBOID
+                PendingLayer pending;
+                pending.mLayer = tileLayer;
+                pending.mDecoded = cachedPayload(xml.text(), pending.mText);
+                if (!pending.mDecoded)
+                    pending.mText = xml.text().toLatin1();
+                pending.mCompression = compression.toString();
+                pending.mRecordIndex = recordPayload(xml.text());
+                if (mDecodeLayersInParallel) {
+                    mPendingLayers += pending;
+                    continue;
+                }
+                QString error;
+                if (pending.mDecoded) {
+                    error = setLayerGids(tileLayer, pending.mText);
+                } else {
+                    QByteArray *tileData = (pending.mRecordIndex != -1)
+                            ? &mRecordBlobs[pending.mRecordIndex] : 0;
+                    error = decodeBinaryLayerData(tileLayer, pending.mText,
+                                                  compression, tileData);
+                }
+#else
+                QString error = decodeBinaryLayerData(tileLayer,
+                                                      xml.text().toLatin1(),
+                                                      compression);
+#endif
+                if (!error.isEmpty())
+                    xml.raiseError(error);
             } else if (encoding == QLatin1String("csv")) {
                 decodeCSVLayerData(tileLayer, xml.text().toString());
             } else {
@@ -500,16 +621,16 @@ void MapReaderPrivate::readLayerData(TileLayer *tileLayer)
     }
 }
 
-void MapReaderPrivate::decodeBinaryLayerData(TileLayer *tileLayer,
-                                             QStringView text,
-                                             QStringView compression)
+/**
+ * Decodes base64 (and optionally compressed) layer data into \a tileLayer.
+ * Doesn't touch the XML reader so it may run on another thread. Returns an
+ * error message, or an empty string on success.
+ */
+QString MapReaderPrivate::decodeBinaryLayerData(TileLayer *tileLayer,
+                                                const QByteArray &latin1Text,
+                                                QStringView compression,
+                                                QByteArray *tileDataOut) const
 {
-#if QT_VERSION < 0x040800
-    const QString textData = QString::fromRawData(text.unicode(), text.size());
-    const QByteArray latin1Text = textData.toLatin1();
-#else
-    const QByteArray latin1Text = text.toLatin1();
-#endif
     QByteArray tileData = QByteArray::fromBase64(latin1Text);
     const int size = (tileLayer->width() * tileLayer->height()) * 4;
 
@@ -517,15 +638,27 @@ void MapReaderPrivate::decodeBinaryLayerData(TileLayer *tileLayer,
         || compression == QLatin1String("gzip")) {
         tileData = decompress(tileData, size);
     } else if (!compression.isEmpty()) {
-        xml.raiseError(tr("Compression method '%1' not supported")
-                       .arg(compression.toString()));
-        return;
+        return tr("Compression method '%1' not supported")
+                .arg(compression.toString());
     }
 
+    if (tileDataOut)
+        *tileDataOut = tileData;
+
+    return setLayerGids(tileLayer, tileData);
+}
+
+/**
+ * Sets the cells of \a tileLayer from decoded, uncompressed layer data.
+ */
+QString MapReaderPrivate::setLayerGids(TileLayer *tileLayer,
+                                       const QByteArray &tileData) const
+{
+    const int size = (tileLayer->width() * tileLayer->height()) * 4;
+
     if (size != tileData.length()) {
-        xml.raiseError(tr("Corrupt layer data for layer '%1'")
-                       .arg(tileLayer->name()));
-        return;
+        return tr("Corrupt layer data for layer '%1'")
+                .arg(tileLayer->name());
     }
 
     const unsigned char *data =
@@ -539,7 +672,17 @@ void MapReaderPrivate::decodeBinaryLayerData(TileLayer *tileLayer,
                          data[i + 2] << 16 |
                          data[i + 3] << 24;
 
-        tileLayer->setCell(x, y, cellForGid(gid));
+        // The layer is new, so empty cells needn't be set.
+        if (gid != 0) {
+            bool ok;
+            const Cell cell = mGidMapper.gidToCell(gid, ok);
+            if (!ok) {
+                if (mGidMapper.isEmpty())
+                    return tr("Tile used but no tilesets specified");
+                return tr("Invalid tile: %1").arg(gid);
+            }
+            tileLayer->setCell(x, y, cell);
+        }
 
         x++;
         if (x == tileLayer->width()) {
@@ -547,8 +690,184 @@ void MapReaderPrivate::decodeBinaryLayerData(TileLayer *tileLayer,
             y++;
         }
     }
+
+    return QString();
 }
 
+#ifdef ZOMBOID
+void MapReaderPrivate::decodePendingLayers()
+{
+    if (mPendingLayers.isEmpty())
+        return;
+
+    QVector<TaskRunner::Task> tasks;
+    for (int i = 0; i < mPendingLayers.size(); ++i) {
+        PendingLayer *pending = &mPendingLayers[i];
+        tasks += [this, pending]() { decodePendingLayer(pending); };
+    }
+    TaskRunner::run(tasks);
+
+    foreach (const PendingLayer &pending, mPendingLayers) {
+        if (!pending.mError.isEmpty()) {
+            xml.raiseError(pending.mError);
+            break;
+        }
+        if (pending.mRecordIndex != -1)
+            mRecordBlobs[pending.mRecordIndex] = pending.mTileData;
+    }
+}
+
+// The layer isn't part of the map yet, so nothing shared is touched except
+// the (read-only) GidMapper.
+void MapReaderPrivate::decodePendingLayer(PendingLayer *pending) const
+{
+    if (pending->mDecoded) {
+        pending->mError = setLayerGids(pending->mLayer, pending->mText);
+    } else {
+        QByteArray *tileData = (pending->mRecordIndex != -1)
+                ? &pending->mTileData : 0;
+        pending->mError = decodeBinaryLayerData(pending->mLayer,
+                                                pending->mText,
+                                                pending->mCompression,
+                                                tileData);
+    }
+    pending->mText.clear();
+}
+
+bool MapReaderPrivate::readTmxData(const QString &fileName, QByteArray &data)
+{
+    QtLockedFile file(fileName);
+    if (!openFile(&file))
+        return false;
+    data = file.readAll();
+    return true;
+}
+
+/**
+ * When reading the XML from a MapBinaryCache, each base64 payload was
+ * replaced by "#N".  Returns true and sets \a data to the already-decoded
+ * payload N in that case.
+ */
+bool MapReaderPrivate::cachedPayload(QStringView text, QByteArray &data)
+{
+    if (!mCache)
+        return false;
+    bool ok = text.size() > 1 && text.at(0) == QLatin1Char('#');
+    const int index = ok ? text.mid(1).toString().toInt(&ok) : -1;
+    if (!ok || index < 0 || index >= mCache->blobCount()) {
+        xml.raiseError(tr("Corrupt map cache"));
+        data.clear();
+        return true;
+    }
+    data = mCache->blob(index);
+    return true;
+}
+
+/**
+ * When creating a MapBinaryCache, remembers where the base64 payload \a text
+ * is in the .tmx file so it can be cut out.  Returns the index in
+ * mRecordBlobs where the decoded payload should be stored, or -1.
+ */
+int MapReaderPrivate::recordPayload(QStringView text)
+{
+    if (!mRecording || mRecordFailed)
+        return -1;
+
+    // The reader's character offset is normally just past the text.  If not,
+    // search forward for it.
+    int start = int(xml.characterOffset()) - text.size();
+    if (start < mRecordCursor || start + text.size() > mRecordText.size()
+            || text.compare(QStringView(mRecordText).mid(start, text.size())) != 0)
+        start = mRecordText.indexOf(text, mRecordCursor);
+    if (start == -1) {
+        mRecordFailed = true;
+        return -1;
+    }
+    mRecordCursor = start + text.size();
+    mRecordRanges += qMakePair(start, int(text.size()));
+    mRecordBlobs += QByteArray();
+    return mRecordBlobs.size() - 1;
+}
+
+void MapReaderPrivate::writeCache(const QString &fileName, qint64 tmxModified,
+                                  const QByteArray &tmxData)
+{
+    // The XML is stored as UTF-8 whatever the original encoding was.
+    const QString encoding = xml.documentEncoding().toString();
+    if (!encoding.isEmpty()
+            && encoding.compare(QLatin1String("UTF-8"), Qt::CaseInsensitive) != 0)
+        return;
+
+    QString text;
+    text.reserve(mRecordText.size() / 8);
+    int pos = 0;
+    for (int i = 0; i < mRecordRanges.size(); ++i) {
+        text += QStringView(mRecordText).mid(pos, mRecordRanges[i].first - pos);
+        text += QLatin1Char('#') + QString::number(i);
+        pos = mRecordRanges[i].first + mRecordRanges[i].second;
+    }
+    text += QStringView(mRecordText).mid(pos);
+
+    MapBinaryCache::write(MapBinaryCache::cachePath(fileName), tmxModified,
+                          tmxData.size(), MapBinaryCache::hash(tmxData),
+                          text.toUtf8(), mRecordBlobs);
+}
+
+Map *MapReaderPrivate::readMapCached(const QString &fileName)
+{
+    const QFileInfo info(fileName);
+    const QString path = info.absolutePath();
+    const qint64 tmxModified = info.lastModified().toMSecsSinceEpoch();
+    QByteArray tmxData;
+    bool haveTmxData = false;
+
+    MapBinaryCache cache;
+    if (cache.open(MapBinaryCache::cachePath(fileName))
+            && cache.tmxSize() == info.size()) {
+        bool valid = cache.tmxModified() == tmxModified;
+        if (!valid) {
+            // The file may have been touched without changing.
+            if (!readTmxData(fileName, tmxData))
+                return 0;
+            haveTmxData = true;
+            valid = MapBinaryCache::hash(tmxData) == cache.tmxHash();
+        }
+        if (valid) {
+            mCache = &cache;
+            xml.clear();
+            xml.addData(cache.xml());
+            Map *map = readMapDocument(path);
+            mCache = 0;
+            if (map)
+                return map;
+            qDebug() << "Ignoring bad map cache for" << fileName << ":"
+                     << errorString();
+        }
+    }
+    cache.close();
+
+    if (!haveTmxData && !readTmxData(fileName, tmxData))
+        return 0;
+
+    mRecording = true;
+    mRecordFailed = false;
+    mRecordText = QString::fromUtf8(tmxData);
+    mRecordCursor = 0;
+
+    xml.clear();
+    xml.addData(tmxData);
+    Map *map = readMapDocument(path);
+    if (map && !mRecordFailed)
+        writeCache(fileName, tmxModified, tmxData);
+
+    mRecording = false;
+    mRecordText.clear();
+    mRecordRanges.clear();
+    mRecordBlobs.clear();
+    return map;
+}
+#endif
+
 #if defined(ZOMBOID) /*&& defined(_DEBUG)*/
 void QString_split(const QChar &sep, QString::SplitBehavior behavior, Qt::CaseSensitivity cs, const QString &in, QVector<int>& out)
 {
@@ -1126,7 +1445,11 @@ void MapReaderPrivate::readBmpPixels(int index, const QList<QRgb> &colors)
         if (xml.isEndElement()) {
             break;
         } else if (xml.isCharacters() && !xml.isWhitespace()) {
-            decodeBmpPixels(index, colors, xml.text());
+            QByteArray tileData;
+            if (cachedPayload(xml.text(), tileData))
+                setBmpPixels(index, colors, tileData);
+            else
+                decodeBmpPixels(index, colors, xml.text());
         }
     }
 }
@@ -1144,6 +1467,18 @@ void MapReaderPrivate::decodeBmpPixels(int bmpIndex, const QList<QRgb> &colors,
 
     tileData = decompress(tileData, size);
 
+    const int recordIndex = recordPayload(text);
+    if (recordIndex != -1)
+        mRecordBlobs[recordIndex] = tileData;
+
+    setBmpPixels(bmpIndex, colors, tileData);
+}
+
+void MapReaderPrivate::setBmpPixels(int bmpIndex, const QList<QRgb> &colors,
+                                    const QByteArray &tileData)
+{
+    const int size = (mMap->width() * mMap->height()) * 4;
+
     if (size != tileData.length()) {
         xml.raiseError(tr("Corrupt bmp data"));
         return;
@@ -1187,7 +1522,11 @@ void MapReaderPrivate::readNoBlend()
                 if (xml.isEndElement()) {
                     break;
                 } else if (xml.isCharacters() && !xml.isWhitespace()) {
-                    decodeNoBlendBits(noBlend, xml.text());
+                    QByteArray tileData;
+                    if (cachedPayload(xml.text(), tileData))
+                        setNoBlendBits(noBlend, tileData);
+                    else
+                        decodeNoBlendBits(noBlend, xml.text());
                 }
             }
         } else {
@@ -1209,6 +1548,18 @@ void MapReaderPrivate::decodeNoBlendBits(MapNoBlend *noBlend, QStringView text)
 
     tileData = decompress(tileData, size);
 
+    const int recordIndex = recordPayload(text);
+    if (recordIndex != -1)
+        mRecordBlobs[recordIndex] = tileData;
+
+    setNoBlendBits(noBlend, tileData);
+}
+
+void MapReaderPrivate::setNoBlendBits(MapNoBlend *noBlend,
+                                      const QByteArray &tileData)
+{
+    const int size = (noBlend->width() * noBlend->height());
+
     if (size != tileData.length()) {
         xml.raiseError(tr("Corrupt noblend data"));
         return;
@@ -1248,9 +1599,39 @@ Map *MapReader::readMap(QIODevice *device, const QString &path)
     return d->readMap(device, path);
 }
 
+#ifdef ZOMBOID
+void MapReader::setDecodeLayersInParallel(bool parallel)
+{
+    d->mDecodeLayersInParallel = parallel;
+}
+
+bool MapReader::decodeLayersInParallel() const
+{
+    return d->mDecodeLayersInParallel;
+}
+
+void MapReader::setUseBinaryCache(bool use)
+{
+    d->mUseBinaryCache = use;
+}
+
+bool MapReader::useBinaryCache() const
+{
+    return d->mUseBinaryCache;
+}
+
+QString MapReader::binaryCachePath(const QString &fileName)
+{
+    return MapBinaryCache::cachePath(fileName);
+}
+#endif
+
 Map *MapReader::readMap(const QString &fileName)
 {
 #ifdef ZOMBOID
+    if (d->mUseBinaryCache)
+        return d->readMapCached(fileName);
+
     SharedTools::QtLockedFile file(fileName);
 #else
     QFile file(fileName);
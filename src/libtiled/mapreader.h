@@ -101,6 +101,26 @@ public:
 #ifdef ZOMBOID
     void setTilesetImageCache(TilesetImageCache *cache) { mTilesetImageCache = cache; }
     TilesetImageCache *tilesetImageCache() const { return mTilesetImageCache; }
+
+    /**
+     * When enabled, the XML pass only captures the base64 layer data, which
+     * is then decoded in parallel by TaskRunner before readMap() returns.
+     * Off by default.
+     */
+    void setDecodeLayersInParallel(bool parallel);
+    bool decodeLayersInParallel() const;
+
+    /**
+     * When enabled, readMap(fileName) keeps a memory-mapped binary copy of
+     * the map next to the .tmx file (see binaryCachePath()) holding the
+     * decoded layer data.  The copy is used while the .tmx file's size and
+     * timestamp (or contents) are unchanged, and rewritten otherwise.  Off by
+     * default.
+     */
+    void setUseBinaryCache(bool use);
+    bool useBinaryCache() const;
+
+    static QString binaryCachePath(const QString &fileName);
 #endif
 
 protected:
@@ -57,3 +57,55 @@ QPolygonF MapRenderer::lineToPolygon(const QPointF &start, const QPointF &end)
     polygon[3] = end + perpendicular + direction;
     return polygon;
 }
+
+#ifdef ZOMBOID
+CellRenderer::CellRenderer(QPainter *painter)
+    : mPainter(painter)
+    , mBaseTransform(painter->transform())
+    , mBaseOpacity(painter->opacity())
+    , mOpacity(mBaseOpacity)
+    , mTransformChanged(false)
+{
+}
+
+CellRenderer::~CellRenderer()
+{
+    if (mTransformChanged)
+        mPainter->setTransform(mBaseTransform);
+    if (mOpacity != mBaseOpacity)
+        mPainter->setOpacity(mBaseOpacity);
+}
+
+void CellRenderer::render(const QImage &image, const QTransform &transform,
+                          qreal opacity)
+{
+    opacity *= mBaseOpacity;
+    if (opacity != mOpacity) {
+        mPainter->setOpacity(opacity);
+        mOpacity = opacity;
+    }
+
+    const bool flipped = transform.m12() != 0 || transform.m21() != 0
+            || transform.m11() <= 0 || transform.m22() <= 0;
+    if (flipped) {
+        mPainter->setTransform(transform * mBaseTransform);
+        mTransformChanged = true;
+        mPainter->drawImage(0, 0, image);
+        return;
+    }
+
+    if (mTransformChanged) {
+        mPainter->setTransform(mBaseTransform);
+        mTransformChanged = false;
+    }
+
+    if (transform.m11() == 1 && transform.m22() == 1) {
+        mPainter->drawImage(QPointF(transform.dx(), transform.dy()), image);
+    } else {
+        const QRectF target(transform.dx(), transform.dy(),
+                            image.width() * transform.m11(),
+                            image.height() * transform.m22());
+        mPainter->drawImage(target, image);
+    }
+}
+#endif // ZOMBOID
@@ -31,6 +31,7 @@
 
 #include "tiled_global.h"
 
+#include <QAtomicInt>
 #include <QPainter>
 
 namespace Tiled {
@@ -54,10 +55,11 @@ class TILEDSHARED_EXPORT MapRenderer
 public:
 #ifdef ZOMBOID
     MapRenderer(const Map *map)
-        : mAbortDrawing(0)
-        , mMap(map)
+        : mMap(map)
+        , mAbortDrawing(0)
         , mMaxLevel(0)
         , m2x(false)
+        , mLayerGroupsPrepared(false)
     {}
 #else
     MapRenderer(const Map *map) : mMap(map) {}
@@ -220,7 +222,22 @@ public:
     void setMaxLevel(int level) { mMaxLevel = level; }
     int maxLevel() const { return mMaxLevel; }
 
-    bool *mAbortDrawing;
+    /**
+     * When set, drawTileLayerGroup() doesn't call
+     * ZTileLayerGroup::prepareDrawing() because the caller has already
+     * prepared the layer groups for everything it draws.  This lets several
+     * threads draw the same layer groups at once.
+     */
+    void setLayerGroupsPrepared(bool prepared) { mLayerGroupsPrepared = prepared; }
+    bool layerGroupsPrepared() const { return mLayerGroupsPrepared; }
+
+    /**
+     * Drawing stops early once \a flag is non-zero.  Another thread may set
+     * it at any time.
+     */
+    void setAbortFlag(const QAtomicInt *flag) { mAbortDrawing = flag; }
+    bool isDrawingAborted() const
+    { return mAbortDrawing && mAbortDrawing->load(); }
 
 #else
     /**
@@ -259,11 +276,48 @@ protected:
 private:
     const Map *mMap;
 #ifdef ZOMBOID
+    const QAtomicInt *mAbortDrawing;
     int mMaxLevel;
     bool m2x;
+    bool mLayerGroupsPrepared;
 #endif
 };
 
+#ifdef ZOMBOID
+/**
+ * Draws tile images for the renderers' tile loops.
+ *
+ * Setting the painter's transform for every tile is a state change that
+ * dominates drawing when many small tiles are visible.  Tiles that are only
+ * translated and scaled are drawn straight to their target rectangle under
+ * the painter's original transform instead; only flipped tiles change the
+ * transform.  The opacity is likewise only set when it changes.  Tiles are
+ * drawn in the order they are given, and the painter is restored when the
+ * CellRenderer is destroyed.
+ */
+class TILEDSHARED_EXPORT CellRenderer
+{
+public:
+    explicit CellRenderer(QPainter *painter);
+    ~CellRenderer();
+
+    /**
+     * Draws \a image with \a transform applied on top of the painter's
+     * original transform, at \a opacity times the painter's original
+     * opacity.
+     */
+    void render(const QImage &image, const QTransform &transform,
+                qreal opacity = 1.0);
+
+private:
+    QPainter *mPainter;
+    const QTransform mBaseTransform;
+    const qreal mBaseOpacity;
+    qreal mOpacity;
+    bool mTransformChanged;
+};
+#endif // ZOMBOID
+
 } // namespace Tiled
 
 #endif // MAPRENDERER_H
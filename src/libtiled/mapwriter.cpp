@@ -45,7 +45,10 @@
 #include <QXmlStreamWriter>
 #ifdef ZOMBOID
 #include "qtlockedfile.h"
+#include "taskrunner.h"
 using namespace SharedTools;
+
+#include <QHash>
 #endif
 
 using namespace Tiled;
@@ -76,12 +79,16 @@ public:
     QString mError;
     MapWriter::LayerDataFormat mLayerDataFormat;
     bool mDtdEnabled;
+#ifdef ZOMBOID
+    bool mEncodeLayersInParallel;
+#endif
 
 private:
     void writeMap(QXmlStreamWriter &w, const Map *map);
     void writeTileset(QXmlStreamWriter &w, const Tileset *tileset,
                       uint firstGid);
     void writeTileLayer(QXmlStreamWriter &w, const TileLayer *tileLayer);
+    QByteArray encodeLayerData(const TileLayer *tileLayer) const;
     void writeLayerAttributes(QXmlStreamWriter &w, const Layer *layer);
     void writeObjectGroup(QXmlStreamWriter &w, const ObjectGroup *objectGroup);
     void writeObject(QXmlStreamWriter &w, const MapObject *mapObject);
@@ -93,11 +100,19 @@ private:
     void writeBmpSettings(QXmlStreamWriter &w, const BmpSettings *settings);
     void writeBmpImage(QXmlStreamWriter &w, int index, const MapBmp &bmp);
     void writeNoBlend(QXmlStreamWriter &w, MapNoBlend *noBlend);
+
+    void encodeLayers(const Map *map);
+
+    /**
+     * Base64 layer data encoded by encodeLayers() before the XML pass.
+     */
+    QHash<const TileLayer*,QByteArray> mEncodedLayers;
 #endif
 
     QDir mMapDir;     // The directory in which the map is being saved
     GidMapper mGidMapper;
     bool mUseAbsolutePaths;
+    CompressionMethod mCompressionMethod;
 };
 
 } // namespace Internal
@@ -107,7 +122,11 @@ private:
 MapWriterPrivate::MapWriterPrivate()
     : mLayerDataFormat(MapWriter::Base64Gzip)
     , mDtdEnabled(false)
+#ifdef ZOMBOID
+    , mEncodeLayersInParallel(false)
+#endif
     , mUseAbsolutePaths(false)
+    , mCompressionMethod(Zlib)
 {
 }
 
@@ -204,6 +223,18 @@ void MapWriterPrivate::writeMap(QXmlStreamWriter &w, const Map *map)
         firstGid += tileset->tileCount();
     }
 
+    mCompressionMethod = Zlib;
+    if (mLayerDataFormat == MapWriter::Base64Gzip)
+        mCompressionMethod = Gzip;
+#ifdef ZOMBOID
+    else if (map->property(QLatin1String("FastCompression"))
+             == QLatin1String("true"))
+        mCompressionMethod = ZlibFast;
+
+    if (mEncodeLayersInParallel)
+        encodeLayers(map);
+#endif
+
     foreach (const Layer *layer, map->layers()) {
         const Layer::Type type = layer->type();
         if (type == Layer::TileLayerType)
@@ -374,26 +405,16 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
         w.writeCharacters(QLatin1String("\n"));
         w.writeCharacters(tileData);
     } else {
-        QByteArray tileData;
-        tileData.reserve(tileLayer->height() * tileLayer->width() * 4);
-
-        for (int y = 0; y < tileLayer->height(); ++y) {
-            for (int x = 0; x < tileLayer->width(); ++x) {
-                const uint gid = mGidMapper.cellToGid(tileLayer->cellAt(x, y));
-                tileData.append((char) (gid));
-                tileData.append((char) (gid >> 8));
-                tileData.append((char) (gid >> 16));
-                tileData.append((char) (gid >> 24));
-            }
-        }
-
-        if (mLayerDataFormat == MapWriter::Base64Gzip)
-            tileData = compress(tileData, Gzip);
-        else if (mLayerDataFormat == MapWriter::Base64Zlib)
-            tileData = compress(tileData, Zlib);
+#ifdef ZOMBOID
+        QByteArray encoded = mEncodedLayers.take(tileLayer);
+        if (encoded.isNull())
+            encoded = encodeLayerData(tileLayer);
+#else
+        const QByteArray encoded = encodeLayerData(tileLayer);
+#endif
 
         w.writeCharacters(QLatin1String("\n   "));
-        w.writeCharacters(QString::fromLatin1(tileData.toBase64()));
+        w.writeCharacters(QString::fromLatin1(encoded));
         w.writeCharacters(QLatin1String("\n  "));
     }
 
@@ -401,6 +422,33 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
     w.writeEndElement(); // </layer>
 }
 
+/**
+ * Returns the base64 text for the binary formats.  This only reads the layer
+ * and the GidMapper, so it may be called from several threads at once.
+ */
+QByteArray MapWriterPrivate::encodeLayerData(const TileLayer *tileLayer) const
+{
+    QByteArray tileData;
+    tileData.resize(tileLayer->height() * tileLayer->width() * 4);
+    char *out = tileData.data();
+
+    for (int y = 0; y < tileLayer->height(); ++y) {
+        for (int x = 0; x < tileLayer->width(); ++x) {
+            const uint gid = mGidMapper.cellToGid(tileLayer->cellAt(x, y));
+            *out++ = (char) (gid);
+            *out++ = (char) (gid >> 8);
+            *out++ = (char) (gid >> 16);
+            *out++ = (char) (gid >> 24);
+        }
+    }
+
+    if (mLayerDataFormat == MapWriter::Base64Gzip
+            || mLayerDataFormat == MapWriter::Base64Zlib)
+        tileData = compress(tileData, mCompressionMethod);
+
+    return tileData.toBase64();
+}
+
 void MapWriterPrivate::writeLayerAttributes(QXmlStreamWriter &w,
                                             const Layer *layer)
 {
@@ -752,6 +800,31 @@ void MapWriterPrivate::writeNoBlend(QXmlStreamWriter &w, MapNoBlend *noBlend)
 
     w.writeEndElement(); // bmp-noblend
 }
+
+/**
+ * Serializes, compresses and base64-encodes the tile layers in parallel.
+ * The results are written in layer order by writeTileLayer().
+ */
+void MapWriterPrivate::encodeLayers(const Map *map)
+{
+    mEncodedLayers.clear();
+    if (mLayerDataFormat == MapWriter::XML || mLayerDataFormat == MapWriter::CSV)
+        return;
+
+    const QList<TileLayer*> tileLayers = map->tileLayers();
+    QVector<QByteArray> encoded(tileLayers.size());
+
+    QVector<TaskRunner::Task> tasks;
+    for (int i = 0; i < tileLayers.size(); ++i) {
+        const TileLayer *tileLayer = tileLayers[i];
+        QByteArray *result = &encoded[i];
+        tasks += [this, tileLayer, result]() { *result = encodeLayerData(tileLayer); };
+    }
+    TaskRunner::run(tasks);
+
+    for (int i = 0; i < tileLayers.size(); ++i)
+        mEncodedLayers[tileLayers[i]] = encoded[i];
+}
 #endif // ZOMBOID
 
 MapWriter::MapWriter()
@@ -841,3 +914,15 @@ bool MapWriter::isDtdEnabled() const
 {
     return d->mDtdEnabled;
 }
+
+#ifdef ZOMBOID
+void MapWriter::setEncodeLayersInParallel(bool parallel)
+{
+    d->mEncodeLayersInParallel = parallel;
+}
+
+bool MapWriter::encodeLayersInParallel() const
+{
+    return d->mEncodeLayersInParallel;
+}
+#endif
@@ -120,6 +120,19 @@ public:
     void setDtdEnabled(bool enabled);
     bool isDtdEnabled() const;
 
+#ifdef ZOMBOID
+    /**
+     * When enabled, the binary layer formats are encoded in parallel by
+     * TaskRunner before the XML is written. Off by default.
+     *
+     * Independently of this, a map with the property FastCompression=true
+     * is saved with the fastest zlib compression level when the format is
+     * Base64Zlib. The result is ordinary zlib data that any reader handles.
+     */
+    void setEncodeLayersInParallel(bool parallel);
+    bool encodeLayersInParallel() const;
+#endif
+
 private:
     Internal::MapWriterPrivate *d;
 };
@@ -0,0 +1,70 @@
+/*
+ * regionbitmap.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef REGIONBITMAP_H
+#define REGIONBITMAP_H
+
+#include "tiled_global.h"
+
+#include <QBitArray>
+#include <QRect>
+#include <QRegion>
+
+namespace Tiled {
+
+/**
+ * A QRegion rasterized to one bit per tile over its bounding rectangle, so
+ * asking whether a tile is in it doesn't search the region's rectangles.
+ * Meant for regions that are asked about far more often than they change,
+ * like the suppressed area MapComposite checks for every cell it draws.
+ */
+class TILEDSHARED_EXPORT RegionBitmap
+{
+public:
+    RegionBitmap() {}
+    explicit RegionBitmap(const QRegion &region) { setRegion(region); }
+
+    void setRegion(const QRegion &region);
+
+    const QRect &bounds() const { return mBounds; }
+
+    bool contains(const QPoint &pos) const
+    {
+        return mBounds.contains(pos)
+                && mBits.testBit((pos.y() - mBounds.top()) * mBounds.width()
+                                 + pos.x() - mBounds.left());
+    }
+
+private:
+    QRect mBounds;
+    QBitArray mBits;
+};
+
+} // namespace Tiled
+
+#endif // REGIONBITMAP_H
@@ -0,0 +1,115 @@
+/*
+ * taskrunner.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "taskrunner.h"
+
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+
+using namespace Tiled;
+
+namespace {
+
+// Takes tasks until there are none left.
+class TaskHelper : public QRunnable
+{
+public:
+    TaskHelper(const QVector<TaskRunner::Task> &tasks, QAtomicInt &next,
+               QSemaphore &finished) :
+        mTasks(tasks),
+        mNext(next),
+        mFinished(finished)
+    {
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        runTasks();
+        mFinished.release();
+    }
+
+    void runTasks()
+    {
+        int i;
+        while ((i = mNext.fetchAndAddOrdered(1)) < mTasks.size())
+            mTasks[i]();
+    }
+
+private:
+    const QVector<TaskRunner::Task> &mTasks;
+    QAtomicInt &mNext;
+    QSemaphore &mFinished;
+};
+
+} // anonymous namespace
+
+TaskRunner::Runner TaskRunner::mRunner;
+
+void TaskRunner::setRunner(const Runner &runner)
+{
+    mRunner = runner;
+}
+
+void TaskRunner::run(const QVector<Task> &tasks)
+{
+    if (tasks.size() <= 1) {
+        for (const Task &task : tasks)
+            task();
+        return;
+    }
+    if (mRunner) {
+        mRunner(tasks);
+        return;
+    }
+
+    // The calling thread takes tasks too, then takes back the helpers the
+    // pool hasn't started.  So it never waits on a thread the pool can't
+    // give it, even when it is one of the pool's threads itself.
+    QThreadPool *pool = QThreadPool::globalInstance();
+    QAtomicInt next(0);
+    QSemaphore finished;
+    QVector<TaskHelper*> helpers;
+    const int count = qMin(tasks.size() - 1, pool->maxThreadCount());
+    for (int i = 0; i < count; ++i) {
+        helpers += new TaskHelper(tasks, next, finished);
+        pool->start(helpers.last());
+    }
+
+    TaskHelper(tasks, next, finished).runTasks();
+
+    int started = helpers.size();
+    for (TaskHelper *helper : helpers) {
+        if (pool->tryTake(helper))
+            --started;
+    }
+    finished.acquire(started);
+    qDeleteAll(helpers);
+}
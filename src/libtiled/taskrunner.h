@@ -0,0 +1,69 @@
+/*
+ * taskrunner.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TASKRUNNER_H
+#define TASKRUNNER_H
+
+#include "tiled_global.h"
+
+#include <QVector>
+
+#include <functional>
+
+namespace Tiled {
+
+/**
+ * Runs the independent tasks MapReader and MapWriter split their layers
+ * into, and returns once they are all done.
+ *
+ * Without a runner of its own, the tasks are shared between the calling
+ * thread and QThreadPool::globalInstance().  An application that keeps its
+ * threads elsewhere installs a runner that spreads the tasks over those, so
+ * the maps its workers read don't each bring a pool's worth of threads.
+ */
+class TILEDSHARED_EXPORT TaskRunner
+{
+public:
+    typedef std::function<void()> Task;
+    typedef std::function<void(const QVector<Task> &tasks)> Runner;
+
+    /**
+     * Installs the runner.  Set it before any map is read or written, and
+     * reset it with an empty Runner before its threads go away.
+     */
+    static void setRunner(const Runner &runner);
+
+    static void run(const QVector<Task> &tasks);
+
+private:
+    static Runner mRunner;
+};
+
+} // namespace Tiled
+
+#endif // TASKRUNNER_H
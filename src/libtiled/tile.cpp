@@ -100,6 +100,13 @@ void Tile::setImage(const Tile *tile)
     mImageSize = tile->mImageSize;
 }
 
+void Tile::setImage(const QImage &image, const QPoint &offset, const QSize &size)
+{
+    mImage = image;
+    mImageOffset = image.isNull() ? QPoint(0, 0) : offset;
+    mImageSize = size;
+}
+
 bool Tile::isRowTransparent(const QImage &image, int row)
 {
     for (int x = 0; x < image.width(); x++) {
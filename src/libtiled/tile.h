@@ -91,6 +91,12 @@ public:
      */
     void setImage(const QImage &image);
     void setImage(const Tile *tile);
+
+    /**
+     * Sets an image that was already trimmed of transparent rows and columns.
+     * \a offset is where it goes in a tile of the given \a size.
+     */
+    void setImage(const QImage &image, const QPoint &offset, const QSize &size);
     void setEmptyImage(int width, int height);
 
     /**
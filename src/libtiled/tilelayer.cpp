@@ -186,10 +186,22 @@ void TileLayer::setCells(int x, int y, TileLayer *layer,
 void TileLayer::erase(const QRegion &area)
 {
     const Cell emptyCell;
+#ifdef ZOMBOID
+    // Only the non-empty cells need changing.
+    QVector<QPoint> points;
+    for (const QRect &rect : area) {
+        forEachNonEmptyCell(rect, [&points](int x, int y, const Cell &) {
+            points += QPoint(x, y);
+        });
+    }
+    for (const QPoint &p : qAsConst(points))
+        setCell(p.x(), p.y(), emptyCell);
+#else
     for (const QRect &rect : area)
         for (int x = rect.left(); x <= rect.right(); ++x)
             for (int y = rect.top(); y <= rect.bottom(); ++y)
                 setCell(x, y, emptyCell);
+#endif
 }
 
 #ifdef ZOMBOID
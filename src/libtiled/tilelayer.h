@@ -94,61 +94,73 @@ public:
 #define SPARSE_TILELAYER 1
 
 /**
-  * This is a QHash-based tile grid.  Project Zomboid maps can be 300x300 with over
-  * 100 tile layers, most of which are mostly empty.  Using a sparse array results in
-  * massive memory savings.
+  * This is a chunked tile grid.  Project Zomboid maps can be 300x300 with over
+  * 100 tile layers, most of which are mostly empty.  The grid is divided into
+  * CHUNK_SIZE x CHUNK_SIZE chunks, and only chunks containing at least one
+  * non-empty cell are allocated.  Lookups are a division plus an array index,
+  * and chunks are implicitly shared so copying a grid is cheap.
   */
 class SparseTileGrid
 {
 public:
+    enum { CHUNK_SIZE = 10 }; // Same as CHUNK_WIDTH in the .lotheader format.
+
     SparseTileGrid(int width, int height)
         : mWidth(width)
         , mHeight(height)
-        , mUseVector(false)
+        , mChunksWide((width + CHUNK_SIZE - 1) / CHUNK_SIZE)
+        , mChunksHigh((height + CHUNK_SIZE - 1) / CHUNK_SIZE)
+        , mChunks(mChunksWide * mChunksHigh)
+        , mCount(0)
     {
     }
 
+    int width() const
+    { return mWidth; }
+
+    int height() const
+    { return mHeight; }
+
     int size() const
     { return mWidth * mHeight; }
 
     const Cell &at(int index) const
     {
-        if (mUseVector)
-            return mCellsVector[index];
-        QHash<int,Cell>::const_iterator it = mCells.find(index);
-        if (it != mCells.end())
-            return *it;
-        return mEmptyCell;
+        return at(index % mWidth, index / mWidth);
     }
 
     const Cell &at(int x, int y) const
     {
-        return at(y * mWidth + x);
+        const Chunk &chunk = mChunks.at(chunkIndex(x, y));
+        if (chunk.mCount == 0)
+            return mEmptyCell;
+        return chunk.mCells.at(cellIndex(x, y));
     }
 
     void replace(int index, const Cell &cell)
     {
-        if (mUseVector) {
-            mCellsVector[index] = cell;
-            return;
-        }
-        QHash<int,Cell>::iterator it = mCells.find(index);
-        if (it == mCells.end()) {
-            if (cell.isEmpty())
-                return;
-            mCells.insert(index, cell);
-        } else if (!cell.isEmpty())
-            (*it) = cell;
-        else
-            mCells.erase(it);
-        if (mCells.size() > 300 * 300 / 3)
-            swapToVector();
+        replace(index % mWidth, index / mWidth, cell);
     }
 
     void replace(int x, int y, const Cell &cell)
     {
-        int index = y * mWidth + x;
-        replace(index, cell);
+        Chunk &chunk = mChunks[chunkIndex(x, y)];
+        if (chunk.mCount == 0) {
+            if (cell.isEmpty())
+                return;
+            chunk.mCells.resize(CHUNK_SIZE * CHUNK_SIZE);
+        }
+        Cell &dest = chunk.mCells[cellIndex(x, y)];
+        if (dest.isEmpty() && !cell.isEmpty()) {
+            ++chunk.mCount;
+            ++mCount;
+        } else if (!dest.isEmpty() && cell.isEmpty()) {
+            --chunk.mCount;
+            --mCount;
+        }
+        dest = cell;
+        if (chunk.mCount == 0)
+            chunk.mCells.clear(); // free the memory
     }
 
     void setTile(int index, Tile *tile)
@@ -159,34 +171,84 @@ public:
     }
 
     bool isEmpty() const
-    { return !mUseVector && mCells.isEmpty(); }
+    { return mCount == 0; }
+
+    /**
+      * Returns the number of non-empty cells.
+      */
+    int count() const
+    { return mCount; }
+
+    /**
+      * Returns the number of chunks that have storage allocated.
+      */
+    int allocatedChunkCount() const
+    {
+        int count = 0;
+        for (const Chunk &chunk : mChunks)
+            if (chunk.mCount > 0)
+                ++count;
+        return count;
+    }
 
     void clear()
     {
-        if (mUseVector)
-            mCellsVector.fill(mEmptyCell);
-        else
-            mCells.clear();
+        mChunks.fill(Chunk());
+        mCount = 0;
     }
 
-private:
-    void swapToVector()
+    /**
+      * Calls \a f(x, y, cell) for each non-empty cell inside \a rect.  Chunks
+      * without any tiles are skipped entirely.  Cells are visited one chunk at
+      * a time, in row order within each chunk.  \a f must not modify this
+      * grid.
+      */
+    template <typename Function>
+    void forEachNonEmpty(const QRect &rect, Function f) const
     {
-        Q_ASSERT(!mUseVector);
-        mCellsVector.resize(size());
-        QHash<int,Cell>::const_iterator it = mCells.begin();
-        while (it != mCells.end()) {
-            mCellsVector[it.key()] = (*it);
-            ++it;
+        const QRect r = rect & QRect(0, 0, mWidth, mHeight);
+        if (r.isEmpty() || mCount == 0)
+            return;
+        for (int cy = r.top() / CHUNK_SIZE; cy <= r.bottom() / CHUNK_SIZE; ++cy) {
+            for (int cx = r.left() / CHUNK_SIZE; cx <= r.right() / CHUNK_SIZE; ++cx) {
+                const Chunk &chunk = mChunks.at(cy * mChunksWide + cx);
+                if (chunk.mCount == 0)
+                    continue;
+                const int x0 = cx * CHUNK_SIZE, y0 = cy * CHUNK_SIZE;
+                const int left = qMax(r.left(), x0);
+                const int right = qMin(r.right(), x0 + CHUNK_SIZE - 1);
+                const int top = qMax(r.top(), y0);
+                const int bottom = qMin(r.bottom(), y0 + CHUNK_SIZE - 1);
+                const Cell *cells = chunk.mCells.constData();
+                for (int y = top; y <= bottom; ++y) {
+                    for (int x = left; x <= right; ++x) {
+                        const Cell &cell = cells[(y - y0) * CHUNK_SIZE + x - x0];
+                        if (!cell.isEmpty())
+                            f(x, y, cell);
+                    }
+                }
+            }
         }
-        mCells.clear();
-        mUseVector = true;
     }
 
+private:
+    struct Chunk
+    {
+        Chunk() : mCount(0) {}
+        QVector<Cell> mCells;
+        int mCount;
+    };
+
+    int chunkIndex(int x, int y) const
+    { return (y / CHUNK_SIZE) * mChunksWide + x / CHUNK_SIZE; }
+
+    int cellIndex(int x, int y) const
+    { return (y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE; }
+
     int mWidth, mHeight;
-    QHash<int,Cell> mCells;
-    QVector<Cell> mCellsVector;
-    bool mUseVector;
+    int mChunksWide, mChunksHigh;
+    QVector<Chunk> mChunks;
+    int mCount;
     Cell mEmptyCell;
 };
 #endif
@@ -256,11 +318,43 @@ public:
      * coordinates have to be within this layer.
      */
     const Cell &cellAt(int x, int y) const
+#if SPARSE_TILELAYER
+    { return mGrid.at(x, y); }
+#else
     { return mGrid.at(x + y * mWidth); }
+#endif
 
     const Cell &cellAt(const QPoint &point) const
     { return cellAt(point.x(), point.y()); }
 
+    /**
+     * Calls \a f(x, y, cell) for each non-empty cell inside \a rect, in
+     * local coordinates.  With the sparse grid, the cost depends on the
+     * number of tiles rather than the size of the layer.  The order of the
+     * cells is unspecified.  \a f must not modify this layer; collect the
+     * positions first when cells need to change.
+     */
+    template <typename Function>
+    void forEachNonEmptyCell(const QRect &rect, Function f) const
+    {
+#if SPARSE_TILELAYER
+        mGrid.forEachNonEmpty(rect, f);
+#else
+        const QRect r = rect & QRect(0, 0, mWidth, mHeight);
+        for (int y = r.top(); y <= r.bottom(); ++y) {
+            for (int x = r.left(); x <= r.right(); ++x) {
+                const Cell &cell = mGrid.at(x + y * mWidth);
+                if (!cell.isEmpty())
+                    f(x, y, cell);
+            }
+        }
+#endif
+    }
+
+    template <typename Function>
+    void forEachNonEmptyCell(Function f) const
+    { forEachNonEmptyCell(QRect(0, 0, mWidth, mHeight), f); }
+
     /**
      * Sets the cell at the given coordinates.
      */
@@ -31,9 +31,51 @@
 #include "tile.h"
 
 #include <QBitmap>
+#ifdef ZOMBOID
+#include <QVector>
+#endif
 
 using namespace Tiled;
 
+#ifdef ZOMBOID
+namespace {
+
+// Frees a tile image's reference to the pixels shared by its tileset.
+void releaseTilePixels(void *info)
+{
+    delete static_cast<QByteArray*>(info);
+}
+
+// The part of \a rect in \a image that isn't fully transparent, the same
+// as Tile::setImage() keeps.
+QRect opaqueRect(const QImage &image, const QRect &rect)
+{
+    int left = rect.right() + 1, right = rect.left() - 1;
+    int top = -1, bottom = -1;
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        int x = rect.left();
+        while (x <= rect.right() && !qAlpha(line[x]))
+            ++x;
+        if (x > rect.right())
+            continue;
+        if (top == -1)
+            top = y;
+        bottom = y;
+        left = qMin(left, x);
+        x = rect.right();
+        while (x > right && !qAlpha(line[x]))
+            --x;
+        right = qMax(right, x);
+    }
+    if (top == -1)
+        return QRect();
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+} // namespace
+#endif // ZOMBOID
+
 Tileset::~Tileset()
 {
     qDeleteAll(mTiles);
@@ -67,27 +109,67 @@ bool Tileset::loadFromImage(const QImage &image, const QString &fileName)
     int tileNum = 0;
 #ifdef ZOMBOID
     QImage image2 = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-#endif
+
+    // Clear the transparent color in one pass over the whole image.  It is
+    // opaque, so its premultiplied value is the same.
+    if (mTransparentColor.isValid()) {
+        const QRgb key = qPremultiply(mTransparentColor.rgba());
+        const int width = image2.width();
+        for (int y = 0; y < image2.height(); ++y) {
+            QRgb *line = reinterpret_cast<QRgb*>(image2.scanLine(y));
+            for (int x = 0; x < width; ++x)
+                line[x] = (line[x] == key) ? 0 : line[x];
+        }
+    }
+
+    // Find the opaque part of each tile in the image, then copy only that
+    // into one buffer shared by all the tiles.  Each tile image refers to its
+    // part of the buffer instead of owning a copy.
+    QVector<QRect> cells;
+    QVector<QRect> trimmed;
+    int byteCount = 0;
     for (int y = mMargin; y <= stopHeight; y += mTileHeight + mTileSpacing) {
         for (int x = mMargin; x <= stopWidth; x += mTileWidth + mTileSpacing) {
-#ifdef ZOMBOID
-            QImage tileImage = image2.copy(x, y, mTileWidth, mTileHeight);
+            const QRect cell(x, y, mTileWidth, mTileHeight);
+            const QRect rect = opaqueRect(image2, cell);
+            cells += cell;
+            trimmed += rect;
+            byteCount += rect.width() * rect.height() * 4;
+        }
+    }
 
-            if (mTransparentColor.isValid()) {
-                for (int x = 0; x < mTileWidth; x++) {
-                    for (int y = 0; y < mTileHeight; y++) {
-                        if (tileImage.pixel(x, y) == mTransparentColor.rgba())
-                            tileImage.setPixel(x, y, qRgba(0,0,0,0));
-                    }
-                }
-            }
+    QByteArray pixels(byteCount, Qt::Uninitialized);
+    uchar *dest = reinterpret_cast<uchar*>(pixels.data());
+    const QSize tileSize(mTileWidth, mTileHeight);
+    for (; tileNum < cells.size(); ++tileNum) {
+        const QRect &rect = trimmed.at(tileNum);
+        QImage tileImage;
+        if (!rect.isEmpty()) {
+            const int bytesPerLine = rect.width() * 4;
+            for (int y = 0; y < rect.height(); ++y)
+                memcpy(dest + y * bytesPerLine,
+                       image2.constScanLine(rect.top() + y) + rect.left() * 4,
+                       bytesPerLine);
+            // Read-only, so painting on a copy of it detaches.
+            const uchar *data = dest;
+            tileImage = QImage(data, rect.width(), rect.height(), bytesPerLine,
+                               QImage::Format_ARGB32_Premultiplied,
+                               releaseTilePixels, new QByteArray(pixels));
+            dest += bytesPerLine * rect.height();
+        }
+        const QPoint offset = rect.topLeft() - cells.at(tileNum).topLeft();
 
-            if (tileNum < oldTilesetSize) {
-                mTiles.at(tileNum)->setImage(tileImage);
-            } else {
-                mTiles.append(new Tile(tileImage, tileNum, this));
-            }
+        if (tileNum < oldTilesetSize) {
+            mTiles.at(tileNum)->setImage(tileImage, offset, tileSize);
+        } else {
+            Tile *tile = new Tile(mTileWidth, mTileHeight, tileNum, this);
+            tile->setImage(tileImage, offset, tileSize);
+            mTiles.append(tile);
+        }
+    }
 #else
+    for (int y = mMargin; y <= stopHeight; y += mTileHeight + mTileSpacing) {
+        for (int x = mMargin; x <= stopWidth; x += mTileWidth + mTileSpacing) {
             const QImage tileImage = image.copy(x, y, mTileWidth, mTileHeight);
             QPixmap tilePixmap = QPixmap::fromImage(tileImage);
 
@@ -102,10 +184,10 @@ bool Tileset::loadFromImage(const QImage &image, const QString &fileName)
             } else {
                 mTiles.append(new Tile(tilePixmap, tileNum, this));
             }
-#endif
             ++tileNum;
         }
     }
+#endif
 
     // Blank out any remaining tiles to avoid confusion
     while (tileNum < oldTilesetSize) {
@@ -209,6 +291,51 @@ bool Tileset::loadFromNothing(const QSize &imageSize, const QString &fileName)
     return true;
 }
 
+bool Tileset::loadFromTrimmedTiles(const QSize &imageSize,
+                                   const QVector<TrimmedTile> &tiles,
+                                   const QString &fileName)
+{
+    Q_ASSERT(mTileWidth > 0 && mTileHeight > 0);
+
+    if (imageSize.isEmpty())
+        return false;
+
+    int mTileWidth = this->mTileWidth;
+    int mTileHeight = this->mTileHeight;
+    if (!mImageSource2x.isEmpty()) {
+        mTileWidth *= 2;
+        mTileHeight *= 2;
+    }
+    const QSize tileSize(mTileWidth, mTileHeight);
+
+    int oldTilesetSize = mTiles.size();
+    int tileNum = 0;
+
+    for (; tileNum < tiles.size(); ++tileNum) {
+        const TrimmedTile &tile = tiles.at(tileNum);
+        if (tileNum < oldTilesetSize) {
+            mTiles.at(tileNum)->setImage(tile.image, tile.offset, tileSize);
+        } else {
+            Tile *newTile = new Tile(mTileWidth, mTileHeight, tileNum, this);
+            newTile->setImage(tile.image, tile.offset, tileSize);
+            mTiles.append(newTile);
+        }
+    }
+
+    // Blank out any remaining tiles to avoid confusion
+    while (tileNum < oldTilesetSize) {
+        mTiles.at(tileNum)->setEmptyImage(mTileWidth, mTileHeight);
+        ++tileNum;
+    }
+
+    mImageWidth = imageSize.width();
+    mImageHeight = imageSize.height();
+    mColumnCount = columnCountForWidth(mImageWidth);
+    mLoaded = true;
+    mImageSource = fileName;
+    return true;
+}
+
 #endif // ZOMBOID
 
 Tileset *Tileset::findSimilarTileset(const QList<Tileset*> &tilesets) const
@@ -36,9 +36,13 @@
 #include <QList>
 #include <QPoint>
 #ifdef ZOMBOID
+#include <QImage>
 #include <QSize>
 #endif
 #include <QString>
+#ifdef ZOMBOID
+#include <QVector>
+#endif
 
 class QImage;
 
@@ -220,6 +224,23 @@ public:
 
 #ifdef ZOMBOID
     bool loadFromNothing(const QSize &imageSize, const QString &fileName);
+
+    /**
+     * A tile image trimmed by Tile::setImage(), and where it goes in the tile.
+     */
+    struct TrimmedTile
+    {
+        QImage image;
+        QPoint offset;
+    };
+
+    /**
+     * Like loadFromImage(), but with the tiles already cut from an image of
+     * \a imageSize and trimmed, such as those in a TilesetBinaryCache.
+     */
+    bool loadFromTrimmedTiles(const QSize &imageSize,
+                              const QVector<TrimmedTile> &tiles,
+                              const QString &fileName);
 #endif
 
     /**
@@ -0,0 +1,265 @@
+/*
+ * tilesetbinarycache.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tilesetbinarycache.h"
+
+#include "tile.h"
+#include "tileset.h"
+
+#include <QAtomicInt>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QSaveFile>
+#include <QVector>
+#include <QtEndian>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+static const quint32 CACHE_MAGIC = 0x43495354; // "TSIC"
+static const quint32 CACHE_VERSION = 1;
+static const int HEADER_SIZE = 4 + 4 + 8 + 8 + 4 * 4 + 4 + 4 + 4 * 3 + 4;
+static const int TILE_ENTRY_SIZE = 4 * 5;
+
+namespace {
+
+/**
+  * What identifies the pixels in a cache: the image file and the way it is
+  * cut into tiles.
+  */
+struct CacheKey
+{
+    CacheKey(const QString &imagePath, const Tileset *tileset)
+    {
+        const QFileInfo info(imagePath);
+        imageModified = info.lastModified().toMSecsSinceEpoch();
+        imageSize = info.size();
+        // Tiles of a 2x image are twice the tileset's tile size.
+        const int scale = tileset->imageSource2x().isEmpty() ? 1 : 2;
+        tileWidth = tileset->tileWidth() * scale;
+        tileHeight = tileset->tileHeight() * scale;
+        tileSpacing = tileset->tileSpacing();
+        margin = tileset->margin();
+        const QColor color = tileset->transparentColor();
+        transparentColor = color.isValid() ? color.rgba() : 0;
+        hasTransparentColor = color.isValid();
+        path = info.absoluteFilePath().toUtf8();
+    }
+
+    qint64 imageModified;
+    qint64 imageSize;
+    qint32 tileWidth;
+    qint32 tileHeight;
+    qint32 tileSpacing;
+    qint32 margin;
+    quint32 transparentColor;
+    quint32 hasTransparentColor;
+    QByteArray path;
+};
+
+/**
+  * The mapped cache file, shared by the tile images that reference it.
+  */
+struct MappedCache
+{
+    MappedCache() : ref(1), data(0) {}
+
+    static void release(void *info)
+    {
+        MappedCache *mapped = static_cast<MappedCache*>(info);
+        if (!mapped->ref.deref())
+            delete mapped;
+    }
+
+    QAtomicInt ref;
+    QFile file; // unmaps the file when deleted
+    const uchar *data;
+};
+
+} // namespace
+
+static quint32 align4(quint32 n)
+{
+    return (n + 3) & ~3;
+}
+
+QString TilesetBinaryCache::cachePath(const QString &cacheDirectory,
+                                      const QString &imagePath,
+                                      const Tileset *tileset)
+{
+    const CacheKey key(imagePath, tileset);
+    QByteArray id = key.path;
+    id += QString::fromLatin1("|%1x%2|%3|%4|%5")
+            .arg(key.tileWidth).arg(key.tileHeight)
+            .arg(key.tileSpacing).arg(key.margin)
+            .arg(key.hasTransparentColor ? QString::number(key.transparentColor, 16)
+                                         : QString())
+            .toLatin1();
+    const QByteArray hash = QCryptographicHash::hash(id, QCryptographicHash::Md5).toHex();
+    return QDir(cacheDirectory).filePath(QString::fromLatin1(hash) + QLatin1String(".tilecache"));
+}
+
+bool TilesetBinaryCache::read(const QString &cachePath, const QString &imagePath,
+                              Tileset *tileset, const QString &fileName)
+{
+    MappedCache *mapped = new MappedCache;
+    mapped->file.setFileName(cachePath);
+    if (!mapped->file.open(QIODevice::ReadOnly)) {
+        MappedCache::release(mapped);
+        return false;
+    }
+
+    const qint64 fileSize = mapped->file.size();
+    if (fileSize < HEADER_SIZE || fileSize > 0x7FFFFFFF
+            || !(mapped->data = mapped->file.map(0, fileSize))) {
+        MappedCache::release(mapped);
+        return false;
+    }
+
+    const CacheKey key(imagePath, tileset);
+    const uchar *p = mapped->data;
+    const bool valid = qFromLittleEndian<quint32>(p) == CACHE_MAGIC
+            && qFromLittleEndian<quint32>(p + 4) == CACHE_VERSION
+            && qFromLittleEndian<qint64>(p + 8) == key.imageModified
+            && qFromLittleEndian<qint64>(p + 16) == key.imageSize
+            && qFromLittleEndian<qint32>(p + 24) == key.tileWidth
+            && qFromLittleEndian<qint32>(p + 28) == key.tileHeight
+            && qFromLittleEndian<qint32>(p + 32) == key.tileSpacing
+            && qFromLittleEndian<qint32>(p + 36) == key.margin
+            && qFromLittleEndian<quint32>(p + 40) == key.transparentColor
+            && qFromLittleEndian<quint32>(p + 44) == key.hasTransparentColor;
+    if (!valid) {
+        MappedCache::release(mapped);
+        return false;
+    }
+    const QSize imageSize(qFromLittleEndian<qint32>(p + 48),
+                          qFromLittleEndian<qint32>(p + 52));
+    const quint32 tileCount = qFromLittleEndian<quint32>(p + 56);
+    const quint32 pathSize = qFromLittleEndian<quint32>(p + 60);
+
+    const qint64 tableOffset = align4(HEADER_SIZE + pathSize);
+    if (qint64(HEADER_SIZE) + pathSize > fileSize
+            || tableOffset + qint64(tileCount) * TILE_ENTRY_SIZE > fileSize
+            || QByteArray::fromRawData(reinterpret_cast<const char*>(p + HEADER_SIZE),
+                                       int(pathSize)) != key.path) {
+        MappedCache::release(mapped);
+        return false;
+    }
+
+    QVector<Tileset::TrimmedTile> tiles(tileCount);
+    p = mapped->data + tableOffset;
+    for (quint32 i = 0; i < tileCount; ++i, p += TILE_ENTRY_SIZE) {
+        Tileset::TrimmedTile &tile = tiles[i];
+        tile.offset = QPoint(qFromLittleEndian<qint32>(p),
+                             qFromLittleEndian<qint32>(p + 4));
+        const int width = qFromLittleEndian<qint32>(p + 8);
+        const int height = qFromLittleEndian<qint32>(p + 12);
+        const quint32 offset = qFromLittleEndian<quint32>(p + 16);
+        if (width <= 0 || height <= 0)
+            continue;
+        if (width > key.tileWidth || height > key.tileHeight
+                || qint64(offset) + qint64(width) * height * 4 > fileSize) {
+            MappedCache::release(mapped);
+            return false;
+        }
+        mapped->ref.ref();
+        tile.image = QImage(mapped->data + offset, width, height, width * 4,
+                            QImage::Format_ARGB32_Premultiplied,
+                            MappedCache::release, mapped);
+    }
+
+    const bool loaded = tileset->loadFromTrimmedTiles(imageSize, tiles, fileName);
+    MappedCache::release(mapped);
+    return loaded;
+}
+
+bool TilesetBinaryCache::write(const QString &cachePath, const QString &imagePath,
+                               const Tileset *tileset)
+{
+    if (!QDir().mkpath(QFileInfo(cachePath).absolutePath()))
+        return false;
+
+    // Written to a temporary file and renamed, so other threads or processes
+    // never see a partial cache.
+    QSaveFile file(cachePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    const CacheKey key(imagePath, tileset);
+    out << CACHE_MAGIC;
+    out << CACHE_VERSION;
+    out << key.imageModified;
+    out << key.imageSize;
+    out << key.tileWidth << key.tileHeight << key.tileSpacing << key.margin;
+    out << key.transparentColor;
+    out << key.hasTransparentColor;
+    out << qint32(tileset->imageWidth()) << qint32(tileset->imageHeight());
+    out << quint32(tileset->tileCount());
+    out << quint32(key.path.size());
+
+    static const char padding[4] = { 0, 0, 0, 0 };
+    out.writeRawData(key.path.constData(), key.path.size());
+    quint32 pos = HEADER_SIZE + key.path.size();
+    out.writeRawData(padding, int(align4(pos) - pos));
+    pos = align4(pos);
+
+    QVector<QImage> images(tileset->tileCount());
+    quint32 offset = pos + tileset->tileCount() * TILE_ENTRY_SIZE;
+    for (int i = 0; i < tileset->tileCount(); ++i) {
+        const Tile *tile = tileset->tileAt(i);
+        QImage &image = images[i];
+        image = tile->image();
+        if (!image.isNull() && image.format() != QImage::Format_ARGB32_Premultiplied)
+            image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        out << qint32(tile->offset().x()) << qint32(tile->offset().y());
+        out << qint32(image.width()) << qint32(image.height());
+        out << offset;
+        offset += image.width() * image.height() * 4;
+    }
+
+    foreach (const QImage &image, images) {
+        for (int y = 0; y < image.height(); ++y)
+            out.writeRawData(reinterpret_cast<const char*>(image.constScanLine(y)),
+                             image.width() * 4);
+    }
+
+    if (out.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
+    }
+
+    return file.commit();
+}
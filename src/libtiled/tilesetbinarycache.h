@@ -0,0 +1,81 @@
+/*
+ * tilesetbinarycache.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TILESETBINARYCACHE_H
+#define TILESETBINARYCACHE_H
+
+#include "tiled_global.h"
+
+#include <QString>
+
+namespace Tiled {
+
+class Tileset;
+
+namespace Internal {
+
+/**
+  * A cache of a tileset image's decoded tiles.  It holds each tile's pixels
+  * already cut from the image, premultiplied and trimmed of transparent rows
+  * and columns, as Tileset::loadFromImage() leaves them.  The cache file is
+  * memory-mapped, and the tile images reference the mapping instead of
+  * copying it.  The mapping is released once no tile image uses it.
+  *
+  * A cache is valid for an image file with the same path, size and
+  * modification time, cut into tiles of the same size, spacing, margin and
+  * transparent color.  Each of those gets its own file.
+  */
+class TILEDSHARED_EXPORT TilesetBinaryCache
+{
+public:
+    /**
+      * The cache file in \a cacheDirectory for \a imagePath cut into tiles
+      * like \a tileset.
+      */
+    static QString cachePath(const QString &cacheDirectory,
+                             const QString &imagePath, const Tileset *tileset);
+
+    /**
+      * Loads \a tileset from the given cache file, as loadFromImage() would
+      * from \a imagePath.  \a fileName becomes the tileset's image source.
+      * Returns false if the cache is missing or out of date.
+      */
+    static bool read(const QString &cachePath, const QString &imagePath,
+                     Tileset *tileset, const QString &fileName);
+
+    /**
+      * Writes the tiles of \a tileset, just loaded from \a imagePath.
+      */
+    static bool write(const QString &cachePath, const QString &imagePath,
+                      const Tileset *tileset);
+};
+
+} // namespace Internal
+} // namespace Tiled
+
+#endif // TILESETBINARYCACHE_H
@@ -196,7 +196,20 @@ void ZLevelRenderer::drawGrid(QPainter *painter, const QRectF &rect,
     }
 }
 
-static Tile *g_missing_tile = 0;
+// The tile drawn in place of tiles without an image.  Several threads may
+// draw at once, so it is created by a thread-safe local static initializer.
+static Tile *missingTile()
+{
+    static Tile *tile = []() -> Tile* {
+        const QString fileName = QLatin1String(":/images/missing-tile.png");
+        Tileset *ts = new Tileset(QLatin1String("MISSING"), 64, 128);
+        if (ts->loadFromImage(QImage(fileName), fileName))
+            return ts->tileAt(0);
+        delete ts;
+        return 0;
+    }();
+    return tile;
+}
 
 void ZLevelRenderer::drawTileLayer(QPainter *painter,
                                       const TileLayer *layer,
@@ -258,6 +271,7 @@ void ZLevelRenderer::drawTileLayer(QPainter *painter,
     bool shifted = inUpperHalf ^ inLeftHalf;
 
     QTransform baseTransform = painter->transform();
+    CellRenderer cellRenderer(painter);
 
     for (int y = startPos.y(); y - tileHeight < rect.bottom();
          y += tileHeight / 2)
@@ -266,7 +280,7 @@ void ZLevelRenderer::drawTileLayer(QPainter *painter,
 
         for (int x = startPos.x(); x < rect.right(); x += tileWidth) {
             // Multi-threading
-            if (mAbortDrawing && *mAbortDrawing) {
+            if (isDrawingAborted()) {
                 painter->setTransform(baseTransform);
                 return;
             }
@@ -319,9 +333,7 @@ void ZLevelRenderer::drawTileLayer(QPainter *painter,
                     }
 
                     const QTransform transform(m11, m12, m21, m22, dx, dy);
-                    painter->setTransform(transform * baseTransform);
-
-                    painter->drawImage(0, 0, img);
+                    cellRenderer.render(img, transform);
                 }
             }
 
@@ -405,9 +417,10 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
     /*static*/ QVector<const Cell*> cells(40); // or QVarLengthArray
     /*static*/ QVector<qreal> opacities(40); // or QVarLengthArray
 
-    layerGroup->prepareDrawing(this, rect);
+    if (!layerGroupsPrepared())
+        layerGroup->prepareDrawing(this, rect);
 
-    qreal opacity = painter->opacity();
+    CellRenderer cellRenderer(painter);
 
     for (int y = startPos.y(); y - tileHeight < rect.bottom();
          y += tileHeight / 2)
@@ -419,7 +432,7 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
             if (layerGroup->orderedCellsAt(columnItr, cells, opacities)) {
                 for (int i = 0; i < cells.size(); i++) {
                     // Multi-threading
-                    if (mAbortDrawing && *mAbortDrawing) {
+                    if (isDrawingAborted()) {
                         painter->setTransform(baseTransform);
                         return;
                     }
@@ -427,14 +440,8 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
                     if (!cell->isEmpty()) {
                         Tile *tile = cell->tile;
                         if (tile->image().isNull()) {
-                            if (g_missing_tile == 0) {
-                                Tileset *ts = new Tileset(QLatin1String("MISSING"), 64, 128);
-                                if (ts->loadFromImage(QImage(QLatin1String(":/images/missing-tile.png")), QLatin1String(":/images/missing-tile.png"))) {
-                                    g_missing_tile = ts->tileAt(0);
-                                }
-                            }
-                            if (g_missing_tile)
-                                tile = g_missing_tile;
+                            if (Tile *missing = missingTile())
+                                tile = missing;
                         }
                         QImage img = tile->image();
                         const QPoint offset = tile->tileset()->tileOffset() + tile->offset();
@@ -485,11 +492,7 @@ void ZLevelRenderer::drawTileLayerGroup(QPainter *painter, ZTileLayerGroup *laye
                         }
 
                         const QTransform transform(m11, m12, m21, m22, dx, dy);
-                        painter->setTransform(transform * baseTransform);
-
-                        painter->setOpacity(opacities[i] * opacity);
-
-                        painter->drawImage(0, 0, img);
+                        cellRenderer.render(img, transform, opacities[i]);
                     }
                 }
             }
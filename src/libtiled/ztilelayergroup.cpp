@@ -121,3 +121,16 @@ QRectF ZTileLayerGroup::boundingRect(const MapRenderer *renderer) const
 
     return boundingRect;
 }
+
+quint8 ZTileLayerGroup::layerRoles(const QString &name, int level, int index,
+                                   const QString &noBlendLayer)
+{
+    quint8 roles = 0;
+    if (!level && !index && (name == QLatin1String("0_Floor")))
+        roles |= RoleFloor;
+    if (name.contains(QLatin1String("_AboveLot")))
+        roles |= RoleAboveLot;
+    if (name == noBlendLayer)
+        roles |= RoleNoBlend;
+    return roles;
+}
@@ -31,6 +31,7 @@
 #include <QVector>
 #include <QRect>
 #include <QMargins>
+#include <QString>
 
 namespace Tiled {
 
@@ -70,6 +71,19 @@ public:
     bool isVisible() const { return mVisible; }
     void setVisible(bool visible) { mVisible = visible; }
 
+    /**
+     * What orderedCellsAt() needs to know about a layer's name, worked out
+     * once per layer so it doesn't compare strings for every cell.
+     */
+    enum LayerRole {
+        RoleFloor = 0x01, // 0_Floor, the first layer in level 0
+        RoleAboveLot = 0x02, // *_AboveLot
+        RoleNoBlend = 0x04 // the layer BMP blends aren't drawn over
+    };
+
+    static quint8 layerRoles(const QString &name, int level, int index,
+                             const QString &noBlendLayer);
+
     Map *mMap;
     QVector<TileLayer*> mLayers;
     QVector<int> mIndices;
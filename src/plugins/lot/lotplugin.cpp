@@ -82,40 +82,12 @@ bool LotPlugin::write(const Map *map, const QString &fileName)
             handleTileLayer(file, tileLayer);
     }
 
-    QVector<QVector<QVector<Square> > > griddata;
-    griddata.resize(EndX - StartX);
-    for (int x = 0; x < EndX - StartX; x++) {
-        griddata[x].resize(EndY - StartY);
-        for (int y = 0; y < EndY - StartY; y++)
-            griddata[x][y].resize(MaxLevel);
-    }
-
     foreach (Layer *layer, map->layers()) {
         // Ignore layers without the proper naming convention
         int level = -1;
         if (!parseNameToLevel(layer->name(), &level))
             continue;
-        if (TileLayer *tileLayer = layer->asTileLayer()) {
-            for (int x = 0; x < tileLayer->width(); x++) {
-                for (int y = 0; y < tileLayer->height(); y++) {
-                    const Tiled::Cell& cell = tileLayer->cellAt(x, y);
-                    if (!cell.isEmpty()) {
-                        int lx = x, ly = y;
-                        if (map->orientation() == Map::Isometric) {
-                            lx = x + (level * 3);
-                            ly = y + (level * 3);
-                        }
-                        lx -= StartX;
-                        ly -= StartY;
-                        if (lx >= 0 && ly >= 0 && lx < tileLayer->width() && ly < tileLayer->height()) {
-                            Entry *e = new Entry(mGidMapper.cellToGid(cell));
-                            griddata[lx][ly][level].Entries.append(e);
-                            TileMap[e->gid]->used = true;
-                        }
-                    }
-                }
-            }
-        } else if (ObjectGroup *objectGroup = layer->asObjectGroup()) {
+        if (ObjectGroup *objectGroup = layer->asObjectGroup()) {
             foreach (const MapObject *mapObject, objectGroup->objects()) {
                 // try ... catch in original code caught cases of objects without name/type/width/height
                 if (mapObject->name().isEmpty() || mapObject->type().isEmpty())
@@ -139,6 +111,62 @@ bool LotPlugin::write(const Map *map, const QString &fileName)
         }
     }
 
+    // The file always has MaxLevel levels, but only the levels up to the
+    // highest one with tiles need to be stored, the rest are written as
+    // empty.
+    int levelCount = 0;
+    foreach (const TileLayer *tileLayer, map->tileLayers()) {
+        int level = -1;
+        if (!tileLayer->isEmpty() && parseNameToLevel(tileLayer->name(), &level))
+            levelCount = qMax(levelCount, level + 1);
+    }
+    levelCount = qMin(levelCount, MaxLevel);
+
+    // All the squares in one array, in the order they are written: level by
+    // level, x-major within a level.  The tiles of all squares share one
+    // array too, square i holds gids[first[i]] up to gids[first[i + 1]].
+    // The first pass counts the tiles of each square, the second stores
+    // them.
+    const int width = EndX - StartX;
+    const int height = EndY - StartY;
+    const int squareCount = width * height * levelCount;
+    QVector<int> first(squareCount + 2, 0);
+    QVector<uint> gids;
+    const bool isometric = map->orientation() == Map::Isometric;
+    for (int pass = 0; pass < 2; pass++) {
+        foreach (const TileLayer *tileLayer, map->tileLayers()) {
+            int level = -1;
+            if (!parseNameToLevel(tileLayer->name(), &level))
+                continue;
+            if (level < 0 || level >= levelCount)
+                continue;
+            tileLayer->forEachNonEmptyCell([&](int x, int y, const Tiled::Cell &cell) {
+                int lx = x, ly = y;
+                if (isometric) {
+                    lx = x + (level * 3);
+                    ly = y + (level * 3);
+                }
+                lx -= StartX;
+                ly -= StartY;
+                if (lx < 0 || ly < 0 || lx >= width || ly >= height)
+                    return;
+                const int index = (level * width + lx) * height + ly;
+                if (pass == 0) {
+                    first[index + 2]++;
+                } else {
+                    const uint gid = mGidMapper.cellToGid(cell);
+                    gids[first[index + 1]++] = gid;
+                    TileMap[gid]->used = true;
+                }
+            });
+        }
+        if (pass == 0) {
+            for (int i = 2; i < first.size(); i++)
+                first[i] += first[i - 1];
+            gids.resize(first.last());
+        }
+    }
+
     QDataStream out(&file);
     out.setByteOrder(QDataStream::LittleEndian);
 
@@ -153,14 +181,16 @@ bool LotPlugin::write(const Map *map, const QString &fileName)
     }
     out << qint32(tilecount);
 
+    QVector<qint32> gidToId(int(firstGid), -1);
+    for (QMap<int,Tile*>::const_iterator it = TileMap.constBegin(); it != TileMap.constEnd(); ++it)
+        gidToId[it.key()] = it.value()->id;
+
     foreach (Tile *tile, TileMap) {
         if (tile->used) {
             SaveString(out, tile->name);
         }
     }
 
-    int width = EndX - StartX;
-    int height = EndY - StartY;
     out << quint8(0);
     out << qint32(width);
     out << qint32(height);
@@ -178,26 +208,27 @@ bool LotPlugin::write(const Map *map, const QString &fileName)
     }
 
     int notdonecount = 0;
-    for (int z = 0; z < MaxLevel; z++)  {
-        for (int x = 0; x < EndX - StartX; x++) {
-            for (int y = 0; y < EndY - StartY; y++) {
-                const QList<Entry*> &entries = griddata[x][y][z].Entries;
-                if (entries.count() == 0)
+    for (int z = 0; z < levelCount; z++)  {
+        for (int x = 0; x < width; x++) {
+            for (int y = 0; y < height; y++) {
+                const int index = (z * width + x) * height + y;
+                const int count = first[index + 1] - first[index];
+                if (count == 0) {
                     notdonecount++;
-                else {
-                    if (notdonecount > 0) {
-                        out << qint32(-1);
-                        out << qint32(notdonecount);
-                    }
-                    notdonecount = 0;
-                    out << qint32(entries.count());
+                    continue;
                 }
-                foreach (Entry *entry, entries) {
-                    out << qint32(TileMap[entry->gid]->id);
+                if (notdonecount > 0) {
+                    out << qint32(-1);
+                    out << qint32(notdonecount);
                 }
+                notdonecount = 0;
+                out << qint32(count);
+                for (int i = first[index]; i < first[index + 1]; i++)
+                    out << gidToId[int(gids[i])];
             }
         }
     }
+    notdonecount += width * height * (MaxLevel - levelCount);
     if (notdonecount > 0) {
         out << qint32(-1);
         out << qint32(notdonecount);
@@ -205,15 +236,6 @@ bool LotPlugin::write(const Map *map, const QString &fileName)
 
     file.close();
 
-    for (int z = 0; z < MaxLevel; z++)  {
-        for (int x = 0; x < EndX - StartX; x++) {
-            for (int y = 0; y < EndY - StartY; y++) {
-                const QList<Entry*> &entries = griddata[x][y][z].Entries;
-                foreach (Entry *entry, entries)
-                    delete entry;
-            }
-        }
-    }
     foreach (Tile *tile, TileMap)
         delete tile;
     foreach (Zone *zone, ZoneList)
@@ -68,22 +68,6 @@ public:
     int h;
 };
 
-class Entry
-{
-public:
-    Entry(int gid)
-    {
-        this->gid = gid;
-    }
-    int gid;
-};
-
-class Square
-{
-public:
-    QList<Entry*> Entries;
-};
-
 class Zone
 {
 public:
@@ -24,6 +24,8 @@
 #include "mapdocument.h"
 #include "tilesetmanager.h"
 
+#include <QCoreApplication>
+
 using namespace Tiled;
 using namespace Tiled::Internal;
 
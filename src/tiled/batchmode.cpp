@@ -0,0 +1,498 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "batchmode.h"
+
+#include "createpackdialog.h"
+#include "luaworldrunner.h"
+#include "mainwindow.h"
+#include "mapimagemanager.h"
+#include "mapmanager.h"
+#include "mapwriterinterface.h"
+#include "pluginmanager.h"
+#include "texturepacker.h"
+#include "worldlotexporter.h"
+#include "zprogress.h"
+
+#include "worlded/world.h"
+#include "worlded/worldcell.h"
+#include "worlded/worldreader.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSet>
+#include <QTextStream>
+#include <QThread>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+BatchMode::BatchMode() :
+    mThreadCount(qMax(1, QThread::idealThreadCount())),
+    mDryRun(false),
+    mHelp(false)
+{
+}
+
+BatchMode::~BatchMode()
+{
+    QObject::disconnect(mProgressConnection);
+    qDeleteAll(mWorlds);
+}
+
+int BatchMode::run(const QStringList &arguments)
+{
+    if (!parseArguments(arguments))
+        return mHelp ? ExitSuccess : ExitUsage;
+
+    // Long steps like reading the tilesets report their progress here
+    // instead of in a dialog.
+    mProgressConnection = QObject::connect(ZProgressManager::instance(), &ZProgressManager::stepStarted,
+            [this](const QString &text) { print(text); });
+
+    typedef int (BatchMode::*Command)();
+    Command command = nullptr;
+    if (mCommand == QLatin1String("pzby"))
+        command = &BatchMode::exportPzby;
+    else if (mCommand == QLatin1String("lot"))
+        command = &BatchMode::exportLot;
+    else if (mCommand == QLatin1String("thumbnails"))
+        command = &BatchMode::thumbnails;
+    else if (mCommand == QLatin1String("tilepack"))
+        command = &BatchMode::tilePack;
+    else if (mCommand == QLatin1String("lua"))
+        command = &BatchMode::luaScript;
+    else {
+        error(tr("Unknown command: %1").arg(mCommand));
+        usage();
+        return ExitUsage;
+    }
+
+    QString configError;
+    if (!MainWindow::loadConfigFiles(configError)) {
+        error(configError);
+        return ExitConfig;
+    }
+
+    // .pack settings files are the inputs of tilepack, not maps.
+    if (command != &BatchMode::tilePack && !readInputs())
+        return ExitConfig;
+
+    QElapsedTimer timer;
+    timer.start();
+    int result = (this->*command)();
+    print(tr("Finished in %1 seconds.").arg(timer.elapsed() / 1000.0, 0, 'f', 1));
+    return result;
+}
+
+bool BatchMode::parseArguments(const QStringList &arguments)
+{
+    for (int i = 0; i < arguments.size(); i++) {
+        const QString &arg = arguments.at(i);
+        auto value = [&](QString &result) {
+            if (i + 1 >= arguments.size()) {
+                error(tr("%1 needs a value").arg(arg));
+                return false;
+            }
+            result = arguments.at(++i);
+            return true;
+        };
+        if (arg == QLatin1String("-h") || arg == QLatin1String("--help")) {
+            mHelp = true;
+            usage();
+            return false;
+        } else if (arg == QLatin1String("-o") || arg == QLatin1String("--output")) {
+            if (!value(mOutputDirectory))
+                return false;
+        } else if (arg == QLatin1String("-j")) {
+            QString count;
+            if (!value(count))
+                return false;
+            bool ok;
+            mThreadCount = count.toInt(&ok);
+            if (!ok || mThreadCount < 1) {
+                error(tr("-j needs a number greater than zero"));
+                return false;
+            }
+        } else if (arg == QLatin1String("--script")) {
+            if (!value(mScript))
+                return false;
+        } else if (arg == QLatin1String("--backups")) {
+            if (!value(mBackupDirectory))
+                return false;
+        } else if (arg == QLatin1String("--dry-run")) {
+            mDryRun = true;
+        } else if (arg == QLatin1String("--resume")) {
+            QString cell;
+            if (!value(cell))
+                return false;
+            QStringList xy = cell.split(QLatin1Char(','));
+            bool ok1 = false, ok2 = false;
+            if (xy.size() == 2)
+                mResumeCell = QPoint(xy[0].toInt(&ok1), xy[1].toInt(&ok2));
+            if (!ok1 || !ok2 || mResumeCell.x() < 0 || mResumeCell.y() < 0) {
+                error(tr("--resume needs a cell, like 3,10"));
+                return false;
+            }
+        } else if (arg.startsWith(QLatin1Char('-'))) {
+            error(tr("Unknown option: %1").arg(arg));
+            return false;
+        } else if (mCommand.isEmpty()) {
+            mCommand = arg;
+        } else {
+            mInputs += arg;
+        }
+    }
+
+    if (mCommand.isEmpty() || mInputs.isEmpty()) {
+        usage();
+        return false;
+    }
+
+    return true;
+}
+
+// Directories are searched for .tmx files, .pzw files are read as worlds.
+// Everything is sorted so the order of the work doesn't depend on the file
+// system.
+bool BatchMode::readInputs()
+{
+    for (const QString &input : mInputs) {
+        QFileInfo info(input);
+        if (info.isDir()) {
+            QStringList maps;
+            QDirIterator it(input, QStringList() << QLatin1String("*.tmx"),
+                            QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext())
+                maps += QFileInfo(it.next()).canonicalFilePath();
+            maps.sort();
+            mMaps += maps;
+        } else if (!info.exists()) {
+            error(tr("No such file: %1").arg(input));
+            return false;
+        } else if (info.suffix() == QLatin1String("pzw")) {
+            WorldReader reader;
+            World *world = reader.readWorld(info.canonicalFilePath());
+            if (!world) {
+                error(tr("Error reading %1\n%2").arg(input).arg(reader.errorString()));
+                return false;
+            }
+            mWorlds += world;
+        } else {
+            mMaps += info.canonicalFilePath();
+        }
+    }
+
+    return true;
+}
+
+// The maps given on the command line plus every map used by a cell of the
+// worlds.
+QStringList BatchMode::allMaps() const
+{
+    QStringList maps = mMaps;
+    for (World *world : mWorlds) {
+        for (int y = 0; y < world->height(); y++) {
+            for (int x = 0; x < world->width(); x++) {
+                WorldCell *cell = world->cellAt(x, y);
+                if (cell && !cell->mapFilePath().isEmpty())
+                    maps += cell->mapFilePath();
+            }
+        }
+    }
+    maps.removeDuplicates();
+    return maps;
+}
+
+bool BatchMode::makeOutputDirectory(const QString &directory)
+{
+    if (directory.isEmpty()) {
+        error(tr("%1 needs an output directory, use -o DIR").arg(mCommand));
+        return false;
+    }
+    if (!QDir().mkpath(directory)) {
+        error(tr("Couldn't create the directory %1").arg(directory));
+        return false;
+    }
+    return true;
+}
+
+int BatchMode::exportPzby()
+{
+    auto report = [this](const WorldLotExporter &exporter) {
+        for (const WorldLotExporter::CellResult &result : exporter.results()) {
+            if (result.error.isEmpty())
+                print(tr("%1 -> %2 (%3/%4 chunks reused)")
+                      .arg(QDir::toNativeSeparators(result.mapFilePath))
+                      .arg(QDir::toNativeSeparators(result.filePath))
+                      .arg(result.chunksReused).arg(result.chunkCount));
+            else
+                error(tr("%1: %2").arg(QDir::toNativeSeparators(result.mapFilePath))
+                      .arg(result.error));
+        }
+        return exporter.failureCount();
+    };
+
+    int failures = 0;
+
+    if (!mMaps.isEmpty()) {
+        if (!makeOutputDirectory(mOutputDirectory))
+            return ExitConfig;
+        WorldLotExporter exporter(nullptr);
+        exporter.setMaxThreadCount(mThreadCount);
+        exporter.exportMaps(mMaps, mOutputDirectory);
+        failures += report(exporter);
+    }
+
+    // Without -o each world goes to the directory in its lot settings.
+    for (World *world : mWorlds) {
+        QString directory = mOutputDirectory;
+        if (directory.isEmpty())
+            directory = world->getGenerateLotsSettings().exportDir;
+        if (!makeOutputDirectory(directory))
+            return ExitConfig;
+        WorldLotExporter exporter(world);
+        exporter.setMaxThreadCount(mThreadCount);
+        exporter.exportWorld(directory);
+        failures += report(exporter);
+    }
+
+    return failures ? ExitFailures : ExitSuccess;
+}
+
+// The lot plugin keeps the map it is writing in member variables, so the
+// maps are done one at a time.
+int BatchMode::exportLot()
+{
+    if (!makeOutputDirectory(mOutputDirectory))
+        return ExitConfig;
+
+    PluginManager::instance()->loadPlugins();
+    MapWriterInterface *writer = nullptr;
+    for (MapWriterInterface *mwi : PluginManager::instance()->interfaces<MapWriterInterface>()) {
+        if (mwi->nameFilter().contains(QLatin1String("(*.lot)"))) {
+            writer = mwi;
+            break;
+        }
+    }
+    if (!writer) {
+        error(tr("The lot plugin isn't installed."));
+        return ExitConfig;
+    }
+
+    const QDir dir(mOutputDirectory);
+    int failures = 0;
+    for (const QString &mapFilePath : allMaps()) {
+        QString fileName = dir.filePath(QFileInfo(mapFilePath).completeBaseName()
+                                        + QLatin1String(".lot"));
+        MapInfo *mapInfo = MapManager::instance()->loadMap(mapFilePath);
+        if (!mapInfo) {
+            error(tr("%1: %2").arg(QDir::toNativeSeparators(mapFilePath))
+                  .arg(MapManager::instance()->errorString()));
+            ++failures;
+            continue;
+        }
+        if (!writer->write(mapInfo->map(), fileName)) {
+            error(tr("%1: %2").arg(QDir::toNativeSeparators(mapFilePath))
+                  .arg(writer->errorString()));
+            ++failures;
+            continue;
+        }
+        print(tr("%1 -> %2").arg(QDir::toNativeSeparators(mapFilePath))
+              .arg(QDir::toNativeSeparators(fileName)));
+    }
+
+    return failures ? ExitFailures : ExitSuccess;
+}
+
+// Thumbnails go where the editor looks for them, so -o isn't used.  Up to
+// date thumbnails are left alone.
+int BatchMode::thumbnails()
+{
+    MapImageManager::setRenderThreadCount(mThreadCount);
+    MapImageManager *manager = MapImageManager::instance();
+
+    QSet<MapImage*> pending;
+    QSet<MapImage*> failed;
+    QObject::connect(manager, &MapImageManager::mapImageChanged, [&](MapImage *mapImage) {
+        if (pending.remove(mapImage))
+            print(QDir::toNativeSeparators(mapImage->mapInfo()->path()));
+    });
+    QObject::connect(manager, &MapImageManager::mapImageFailedToLoad, [&](MapImage *mapImage) {
+        if (pending.remove(mapImage))
+            failed += mapImage;
+    });
+
+    int failures = 0;
+    for (const QString &mapFilePath : allMaps()) {
+        MapImage *mapImage = manager->getMapImage(mapFilePath);
+        if (!mapImage) {
+            error(tr("%1: %2").arg(QDir::toNativeSeparators(mapFilePath))
+                  .arg(manager->errorString()));
+            ++failures;
+        } else if (mapImage->isLoaded()) {
+            print(QDir::toNativeSeparators(mapFilePath));
+        } else {
+            pending += mapImage;
+        }
+    }
+
+    while (!pending.isEmpty())
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+
+    for (MapImage *mapImage : failed)
+        error(tr("%1: failed to render").arg(QDir::toNativeSeparators(mapImage->mapInfo()->path())));
+    failures += failed.size();
+
+    MapImageManager::deleteInstance();
+
+    return failures ? ExitFailures : ExitSuccess;
+}
+
+// The inputs are settings files saved by the Create .pack File dialog.
+int BatchMode::tilePack()
+{
+    if (!mOutputDirectory.isEmpty() && !makeOutputDirectory(mOutputDirectory))
+        return ExitConfig;
+
+    int failures = 0;
+    for (const QString &input : mInputs) {
+        PackSettingsFile file;
+        if (!file.read(input)) {
+            error(tr("%1: %2").arg(input).arg(file.errorString()));
+            ++failures;
+            continue;
+        }
+        TexturePackSettings settings = file.settings();
+        // Same as CreatePackDialog.
+        settings.padding = 2;
+        if (!mOutputDirectory.isEmpty())
+            settings.mPackFileName = QDir(mOutputDirectory)
+                    .filePath(QFileInfo(settings.mPackFileName).fileName());
+
+        TexturePacker packer;
+        if (!packer.pack(settings)) {
+            error(tr("%1: %2").arg(input).arg(packer.errorString()));
+            ++failures;
+            continue;
+        }
+        print(tr("%1 -> %2").arg(QDir::toNativeSeparators(input))
+              .arg(QDir::toNativeSeparators(settings.mPackFileName)));
+    }
+
+    return failures ? ExitFailures : ExitSuccess;
+}
+
+// Like LuaWorldDialog, but a failed map doesn't stop the rest.  --resume
+// applies to the worlds, the maps given by themselves are always done.
+int BatchMode::luaScript()
+{
+    if (mScript.isEmpty() || !QFileInfo(mScript).exists()) {
+        error(tr("lua needs a script, use --script FILE"));
+        return ExitUsage;
+    }
+    if (!mBackupDirectory.isEmpty() && !makeOutputDirectory(mBackupDirectory))
+        return ExitConfig;
+
+    LuaWorldRunner runner;
+    runner.setScript(mScript);
+    runner.setBackupDirectory(mBackupDirectory);
+    runner.setDryRun(mDryRun);
+    runner.setMaxThreadCount(mThreadCount);
+
+    QList<LuaWorldRunner::MapResult> maps;
+    for (const QString &mapFilePath : qAsConst(mMaps)) {
+        LuaWorldRunner::MapResult map;
+        map.mapFilePath = mapFilePath;
+        maps += map;
+    }
+    for (World *world : qAsConst(mWorlds))
+        maps += LuaWorldRunner::worldMaps(world, mResumeCell);
+
+    QObject::connect(&runner, &LuaWorldRunner::mapFinished, [&](const LuaWorldRunner::MapResult &result) {
+        if (!result.output.isEmpty())
+            print(result.output);
+        QString name = QDir::toNativeSeparators(result.mapFilePath);
+        if (result.x != -1)
+            name += tr(" (cell %1,%2)").arg(result.x).arg(result.y);
+        if (result.result == LuaWorldRunner::Failed)
+            error(tr("%1: %2").arg(name).arg(result.error));
+        else if (result.result == LuaWorldRunner::Unchanged)
+            print(tr("%1 is unchanged.").arg(name));
+        else if (mDryRun)
+            print(tr("%1 would be changed.").arg(name));
+        else
+            print(tr("%1 was changed.").arg(name));
+    });
+
+    if (!runner.processMaps(maps)) {
+        if (runner.resumeIndex() < maps.size() && maps[runner.resumeIndex()].x != -1) {
+            const LuaWorldRunner::MapResult &resume = maps[runner.resumeIndex()];
+            error(tr("The cells before %1,%2 are done, use --resume %1,%2 to start there.")
+                  .arg(resume.x).arg(resume.y));
+        }
+        return ExitFailures;
+    }
+
+    return ExitSuccess;
+}
+
+void BatchMode::usage() const
+{
+    print(tr("Usage: %1 --batch <command> [options] <inputs...>\n"
+             "\n"
+             "Commands:\n"
+             "  pzby        Export .pzby files.  Maps are written to DIR/<map>.pzby,\n"
+             "              worlds to DIR/X_Y.pzby, or their lot export directory.\n"
+             "  lot         Export DIR/<map>.lot for every map.\n"
+             "  thumbnails  Bring the thumbnails WorldEd and TileZed use up to date.\n"
+             "  tilepack    Create .pack files.  The inputs are settings files saved\n"
+             "              by the Create .pack File dialog.\n"
+             "  lua         Run a Lua script on every map and save the changed ones.\n"
+             "\n"
+             "Inputs are .tmx files, directories searched for .tmx files, or .pzw\n"
+             "worlds.\n"
+             "\n"
+             "Options:\n"
+             "  -o, --output DIR  Where to write the files.\n"
+             "  -j N              How many maps to process at once (pzby, thumbnails,\n"
+             "                    lua).\n"
+             "  --script FILE     The Lua script to run.\n"
+             "  --backups DIR     Where lua moves the old maps, instead of <map>.tmx.bak.\n"
+             "  --dry-run         Report the maps lua would change, but don't save them.\n"
+             "  --resume X,Y      Start lua at cell X,Y of the worlds.\n"
+             "  -h, --help        Show this text.\n"
+             "\n"
+             "Exit codes: 0 success, 1 some inputs failed, 2 bad command line,\n"
+             "3 the config files or an input couldn't be read, or the output\n"
+             "directory couldn't be made.")
+          .arg(QFileInfo(QCoreApplication::applicationFilePath()).fileName()));
+}
+
+void BatchMode::print(const QString &text) const
+{
+    QTextStream out(stdout);
+    out << text << QLatin1Char('\n');
+}
+
+void BatchMode::error(const QString &text) const
+{
+    QTextStream err(stderr);
+    err << text << QLatin1Char('\n');
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BATCHMODE_H
+#define BATCHMODE_H
+
+#include <QCoreApplication>
+#include <QList>
+#include <QPoint>
+#include <QStringList>
+
+class World;
+
+/**
+ * Runs TileZed without a main window, for build machines:
+ *
+ *   TileZed --batch <command> [options] <inputs...>
+ *
+ * The commands are pzby, lot, thumbnails, tilepack and lua.  Inputs are .tmx
+ * files, directories searched for .tmx files, or .pzw worlds.  See usage()
+ * for the options.
+ *
+ * run() returns the process exit code, one of the ExitCode values.
+ */
+class BatchMode
+{
+    Q_DECLARE_TR_FUNCTIONS(BatchMode)
+
+public:
+    enum ExitCode {
+        ExitSuccess = 0,
+        ExitFailures = 1,   // some inputs failed, the rest were done
+        ExitUsage = 2,      // bad command line
+        ExitConfig = 3      // the config files or an input couldn't be read, or
+                            // the output directory couldn't be made
+    };
+
+    BatchMode();
+    ~BatchMode();
+
+    int run(const QStringList &arguments);
+
+private:
+    bool parseArguments(const QStringList &arguments);
+    bool readInputs();
+    QStringList allMaps() const;
+    bool makeOutputDirectory(const QString &directory);
+
+    int exportPzby();
+    int exportLot();
+    int thumbnails();
+    int tilePack();
+    int luaScript();
+
+    void usage() const;
+    void print(const QString &text) const;
+    void error(const QString &text) const;
+
+    QString mCommand;
+    QStringList mInputs;
+    QString mOutputDirectory;
+    QString mScript;
+    QString mBackupDirectory;
+    int mThreadCount;
+    bool mDryRun;
+    bool mHelp;
+    QMetaObject::Connection mProgressConnection;
+    QPoint mResumeCell;
+
+    QStringList mMaps;
+    QList<World*> mWorlds;
+};
+
+#endif // BATCHMODE_H
@@ -202,18 +202,16 @@ void BmpBlender::tilesToPixels(int x1, int y1, int x2, int y2)
         mInitTilesLater = false;
     }
 
-    for (int y = y1; y <= y2; y++) {
-        for (int x = x1; x <= x2; x++) {
-            QRgb col = mMap->rbmpMain().pixel(x, y);
-            if (col != qRgb(0, 0, 0))
-                continue;
-
-            if (Tile *tile = floorLayer->cellAt(x, y).tile) {
-                if (mFloorTileToRule.contains(tile))
-                    mMap->rbmp(0).setPixel(x, y, mFloorTileToRule[tile]->mRule->color);
-            }
-        }
-    }
+    const QRect r(x1, y1, x2 - x1 + 1, y2 - y1 + 1);
+    floorLayer->forEachNonEmptyCell(r, [&](int x, int y, const Cell &cell) {
+        QRgb col = mMap->rbmpMain().pixel(x, y);
+        if (col != qRgb(0, 0, 0))
+            return;
+
+        auto it = mFloorTileToRule.constFind(cell.tile);
+        if (it != mFloorTileToRule.constEnd())
+            mMap->rbmp(0).setPixel(x, y, it.value()->mRule->color);
+    });
 }
 
 // See if the given tile in the given layer should be there based on the rules
@@ -677,38 +675,34 @@ void BmpBlender::tileGridsToLayers(int x1, int y1, int x2, int y2)
     y1 = qBound(0, y1, mMap->height() - 1);
     y2 = qBound(0, y2, mMap->height() - 1);
 
-    const Cell emptyCell;
+    const QRect r(x1, y1, x2 - x1 + 1, y2 - y1 + 1);
 
     foreach (QString layerName, mTileLayers.keys()) {
         SparseTileGrid *grid = mTileGrids[layerName];
         TileLayer *tl = mTileLayers[layerName];
-        BlendGrid &blendGrid = mBlendGrids[layerName];
+        const BlendGrid &blendGrid = mBlendGrids[layerName];
         int n = mMap->indexOfLayer(layerName, Layer::TileLayerType);
         TileLayer *mapLayer = (n == -1) ? nullptr : mMap->layerAt(n)->asTileLayer();
-        for (int y = y1; y <= y2; y++) {
-            for (int x = x1; x <= x2; x++) {
-                Tile *tile = grid->at(x, y).tile;
-                if (tile == nullptr) {
-                    tl->setCell(x, y, emptyCell);
-                    continue;
-                }
-                // If the blend tile that is in the map is the expected one,
-                // don't override it.  This prevents a map tile which should
-                // be there from being overriden by this automatic one.
-                if (mapLayer != nullptr) {
-                    int index = x + y * mMap->width();
-                    if (blendGrid.contains(index)) {
-                        BlendWrapper *blendW = blendGrid[index];
-                        Tile *tile = mapLayer->cellAt(x, y).tile;
-                        if (blendW->mBlendTiles.contains(tile)) {
-                            tl->setCell(x, y, emptyCell);
-                            continue;
-                        }
-                    }
+
+        // Clear the area, then copy over the grid's tiles.  Both only visit
+        // non-empty cells.
+        tl->erase(r);
+        grid->forEachNonEmpty(r, [&](int x, int y, const Cell &cell) {
+            // If the blend tile that is in the map is the expected one,
+            // don't override it.  This prevents a map tile which should
+            // be there from being overriden by this automatic one.
+            if (mapLayer != nullptr) {
+                int index = x + y * mMap->width();
+                auto it = blendGrid.constFind(index);
+                if (it != blendGrid.constEnd()) {
+                    BlendWrapper *blendW = it.value();
+                    Tile *tile = mapLayer->cellAt(x, y).tile;
+                    if (blendW->mBlendTiles.contains(tile))
+                        return;
                 }
-                tl->setCell(x, y, Cell(tile));
             }
-        }
+            tl->setCell(x, y, Cell(cell.tile));
+        });
     }
 
     if (recreated) {
@@ -218,12 +218,16 @@ void CheckMapsWindow::check(MapDocument *doc)
     }
 
     QVector<const Cell*> cells;
+    QBitArray nonEmpty;
     int numLevels = mc->layerGroupCount();
     for (int level = numLevels - 1; level >= 0; --level) {
         CompositeLayerGroup *lg = mc->tileLayersForLevel(level);
         int oldGrass = 0;
+        lg->nonEmptyCells2(QRect(0, 0, map->width(), map->height()), nonEmpty);
         for (int y = 0; y < map->height(); y++) {
             for (int x = 0; x < map->width(); x++) {
+                if (!nonEmpty.testBit(y * map->width() + x))
+                    continue;
                 cells.clear();
                 if (!lg->orderedCellsAt2(QPoint(x, y), cells))
                     continue;
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "jobpipeline.h"
+
+#include <QEventLoop>
+#include <QThread>
+
+#include <limits>
+
+JobPipeline::JobPipeline(QObject *parent) :
+    QObject(parent),
+    mMaxRunning(qMax(1, QThread::idealThreadCount())),
+    mMemoryBudget(std::numeric_limits<qint64>::max()),
+    mJobsInFlight(0),
+    mJobsRunning(0),
+    mBytesInFlight(0),
+    mEventLoop(nullptr)
+{
+}
+
+// The continuations of jobs still running are dropped with this object.
+JobPipeline::~JobPipeline()
+{
+    mToken.cancel();
+    JobScheduler::instance()->wait(mToken);
+}
+
+void JobPipeline::setMaxRunning(int count)
+{
+    mMaxRunning = qMax(1, count);
+}
+
+void JobPipeline::start(const Function &work, const Function &done, qint64 bytes)
+{
+    while (!hasRoomFor(bytes))
+        waitForJob();
+
+    Job job;
+    job.work = work;
+    job.done = done;
+    job.bytes = bytes;
+    mQueued += job;
+    mJobsInFlight++;
+    mBytesInFlight += bytes;
+    scheduleJobs();
+}
+
+void JobPipeline::waitForAll()
+{
+    while (mJobsInFlight > 0)
+        waitForJob();
+}
+
+bool JobPipeline::hasRoomFor(qint64 bytes) const
+{
+    if (mJobsInFlight == 0)
+        return true;
+    return mJobsInFlight < mMaxRunning * 2 && mBytesInFlight + bytes <= mMemoryBudget;
+}
+
+// The rest wait here rather than in the scheduler's queues, so no more than
+// mMaxRunning of the scheduler's threads are ever busy with our jobs.
+void JobPipeline::scheduleJobs()
+{
+    while (mJobsRunning < mMaxRunning && !mQueued.isEmpty()) {
+        const Job job = mQueued.takeFirst();
+        mJobsRunning++;
+        JobScheduler::instance()->schedule(job.work, JobScheduler::PriorityNormal,
+                                           mToken, this, [this, job]() {
+            jobFinished(job);
+        });
+    }
+}
+
+void JobPipeline::jobFinished(const Job &job)
+{
+    mJobsRunning--;
+    mJobsInFlight--;
+    mBytesInFlight -= job.bytes;
+    scheduleJobs();
+
+    job.done();
+
+    if (mEventLoop)
+        mEventLoop->quit();
+}
+
+// Runs the event loop until the next job's done function was called.
+void JobPipeline::waitForJob()
+{
+    QEventLoop eventLoop;
+    QEventLoop *outer = mEventLoop;
+    mEventLoop = &eventLoop;
+    eventLoop.exec(QEventLoop::ExcludeUserInputEvents);
+    mEventLoop = outer;
+}
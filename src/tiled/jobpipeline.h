@@ -0,0 +1,107 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JOBPIPELINE_H
+#define JOBPIPELINE_H
+
+#include "jobscheduler.h"
+
+#include <QList>
+#include <QObject>
+
+class QEventLoop;
+
+/**
+ * Runs a stream of jobs on the JobScheduler while the GUI thread prepares the
+ * next ones, keeping only a few of them in flight.
+ *
+ * At most maxRunning() jobs run at once, and twice that many may be in
+ * flight.  With a memory budget, a job is also held back until the estimated
+ * size of the jobs in flight leaves room for it.  Each job's done function is
+ * called in the GUI thread once its work has finished.
+ *
+ * While start() and waitForAll() wait, the event loop keeps running.  That
+ * keeps the progress dialog painting, and answers the jobs that call into the
+ * GUI thread with a BlockingQueuedConnection right away.
+ */
+class JobPipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef JobScheduler::Function Function;
+
+    JobPipeline(QObject *parent = nullptr);
+    ~JobPipeline();
+
+    /**
+     * The number of jobs run at once.  Defaults to
+     * QThread::idealThreadCount().
+     */
+    void setMaxRunning(int count);
+    int maxRunning() const
+    { return mMaxRunning; }
+
+    /**
+     * The approximate number of bytes the jobs in flight may use.  At least
+     * one job is always in flight, however large it is.  There is no budget
+     * by default.
+     */
+    void setMemoryBudget(qint64 bytes)
+    { mMemoryBudget = bytes; }
+    qint64 memoryBudget() const
+    { return mMemoryBudget; }
+
+    /**
+     * Runs \a work in a worker thread, then \a done in the GUI thread.
+     * Blocks until there is room for the job.  \a bytes is the job's share
+     * of the memory budget.
+     */
+    void start(const Function &work, const Function &done, qint64 bytes = 0);
+
+    /**
+     * Blocks until every job has finished and its done function was called.
+     */
+    void waitForAll();
+
+    int jobsInFlight() const
+    { return mJobsInFlight; }
+
+private:
+    struct Job
+    {
+        Function work;
+        Function done;
+        qint64 bytes;
+    };
+
+    bool hasRoomFor(qint64 bytes) const;
+    void scheduleJobs();
+    void jobFinished(const Job &job);
+    void waitForJob();
+
+    int mMaxRunning;
+    qint64 mMemoryBudget;
+    int mJobsInFlight;
+    int mJobsRunning;
+    qint64 mBytesInFlight;
+    QList<Job> mQueued;
+    JobToken mToken;
+    QEventLoop *mEventLoop;
+};
+
+#endif // JOBPIPELINE_H
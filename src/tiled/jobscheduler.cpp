@@ -0,0 +1,365 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "jobscheduler.h"
+
+#include "taskrunner.h"
+
+#include <QCoreApplication>
+#include <QPointer>
+#include <QThread>
+
+class SchedulerTask
+{
+public:
+    enum State {
+        Queued,
+        Running,
+        Finished
+    };
+
+    SchedulerTask() :
+        priority(JobScheduler::PriorityNormal),
+        queue(0),
+        state(Queued)
+    {
+    }
+
+    JobScheduler::Function work;
+    JobScheduler::Function continuation;
+    QPointer<QObject> context;
+    JobToken token;
+    int priority;
+    int queue;
+    State state;
+};
+
+// The index of the worker running in this thread, or -1.
+static thread_local int sWorkerIndex = -1;
+
+class JobScheduler::Worker : public QThread
+{
+public:
+    Worker(JobScheduler *scheduler, int index) :
+        mScheduler(scheduler),
+        mIndex(index)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        sWorkerIndex = mIndex;
+        mScheduler->workerLoop(mIndex);
+    }
+
+private:
+    JobScheduler *mScheduler;
+    int mIndex;
+};
+
+/////
+
+bool JobHandle::isFinished() const
+{
+    return !d || JobScheduler::instance()->isFinished(d);
+}
+
+void JobHandle::raisePriority(int priority)
+{
+    if (d)
+        JobScheduler::instance()->raisePriority(d, priority);
+}
+
+void JobHandle::wait()
+{
+    JobScheduler::instance()->wait(*this);
+}
+
+/////
+
+JobScheduler *JobScheduler::mInstance = nullptr;
+
+JobScheduler *JobScheduler::instance()
+{
+    if (!mInstance)
+        mInstance = new JobScheduler;
+    return mInstance;
+}
+
+void JobScheduler::deleteInstance()
+{
+    delete mInstance;
+    mInstance = nullptr;
+}
+
+JobScheduler::JobScheduler() :
+    QObject(),
+    mQuit(false)
+{
+    // Continuations are posted to this object.
+    Q_ASSERT(QThread::currentThread() == qApp->thread());
+
+    const int count = qMax(2, QThread::idealThreadCount());
+    mQueues.resize(count);
+    mWorkers.resize(count);
+    for (int i = 0; i < count; i++) {
+        mQueues[i] = new WorkQueue;
+        mWorkers[i] = new Worker(this, i);
+    }
+    for (Worker *worker : mWorkers)
+        worker->start();
+
+    Tiled::TaskRunner::setRunner([this](const QVector<Function> &work) {
+        runAll(work);
+    });
+}
+
+JobScheduler::~JobScheduler()
+{
+    Tiled::TaskRunner::setRunner(Tiled::TaskRunner::Runner());
+
+    // Whoever scheduled the jobs still waiting has already cancelled them.
+    for (WorkQueue *queue : mQueues) {
+        QMutexLocker locker(&queue->mutex);
+        queue->tasks.clear();
+    }
+
+    {
+        QMutexLocker locker(&mIdleMutex);
+        mQuit = true;
+        mWorkAvailable.wakeAll();
+    }
+
+    for (Worker *worker : mWorkers) {
+        worker->wait();
+        delete worker;
+    }
+    qDeleteAll(mQueues);
+}
+
+JobHandle JobScheduler::schedule(const Function &work, int priority,
+                                 const JobToken &token)
+{
+    return schedule(work, priority, token, nullptr, Function());
+}
+
+JobHandle JobScheduler::schedule(const Function &work, int priority,
+                                 const JobToken &token,
+                                 QObject *context, const Function &continuation)
+{
+    TaskPtr task(new SchedulerTask);
+    task->work = work;
+    task->continuation = continuation;
+    task->context = context ? context : this;
+    task->token = token;
+    task->priority = priority;
+
+    {
+        QMutexLocker locker(&mStateMutex);
+        token.d->pending++;
+    }
+
+    int queue = sWorkerIndex;
+    if (queue == -1)
+        queue = (mNextQueue.fetchAndAddRelaxed(1) & 0x7fffffff) % mQueues.size();
+    enqueue(task, queue);
+
+    return JobHandle(task);
+}
+
+void JobScheduler::wait(const JobHandle &job)
+{
+    const TaskPtr &task = job.d;
+    if (!task)
+        return;
+
+    if (takeQueuedTask(task))
+        runTask(task);
+
+    QMutexLocker locker(&mStateMutex);
+    while (task->state != SchedulerTask::Finished)
+        mTaskFinished.wait(&mStateMutex);
+}
+
+void JobScheduler::wait(const JobToken &token)
+{
+    QList<TaskPtr> tasks;
+    for (WorkQueue *queue : mQueues) {
+        QMutexLocker locker(&queue->mutex);
+        for (int i = 0; i < queue->tasks.size(); ) {
+            if (queue->tasks[i]->token == token) {
+                tasks += queue->tasks.takeAt(i);
+                mQueuedCount.deref();
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    // runTask() skips the work of cancelled jobs.
+    for (const TaskPtr &task : tasks)
+        runTask(task);
+
+    QMutexLocker locker(&mStateMutex);
+    while (token.d->pending > 0)
+        mTaskFinished.wait(&mStateMutex);
+}
+
+// The caller is blocked until they are done, so they go ahead of everything
+// else.
+void JobScheduler::runAll(const QVector<Function> &work)
+{
+    QList<JobHandle> jobs;
+    for (const Function &function : work)
+        jobs += schedule(function, PriorityHigh);
+    for (const JobHandle &job : qAsConst(jobs))
+        wait(job);
+}
+
+void JobScheduler::enqueue(const TaskPtr &task, int queue)
+{
+    task->queue = queue;
+    {
+        QMutexLocker locker(&mQueues[queue]->mutex);
+        insertTask(mQueues[queue], task);
+    }
+
+    // Count the task only once it can be taken, so a worker that sees the
+    // count go up will find it.
+    mQueuedCount.ref();
+    QMutexLocker locker(&mIdleMutex);
+    mWorkAvailable.wakeOne();
+}
+
+// Higher priorities first, in the order they were scheduled.
+void JobScheduler::insertTask(WorkQueue *queue, const TaskPtr &task)
+{
+    int index = 0;
+    while (index < queue->tasks.size() && queue->tasks[index]->priority >= task->priority)
+        ++index;
+    queue->tasks.insert(index, task);
+}
+
+// Take the most urgent job at the front of any queue, preferring our own.
+JobScheduler::TaskPtr JobScheduler::takeTask(int index)
+{
+    while (mQueuedCount.load() > 0) {
+        int best = -1;
+        int bestPriority = 0;
+        for (int i = 0; i < mQueues.size(); i++) {
+            const int q = (index + i) % mQueues.size();
+            QMutexLocker locker(&mQueues[q]->mutex);
+            if (mQueues[q]->tasks.isEmpty())
+                continue;
+            const int priority = mQueues[q]->tasks.first()->priority;
+            if (best == -1 || priority > bestPriority) {
+                best = q;
+                bestPriority = priority;
+            }
+        }
+        if (best == -1)
+            break;
+
+        // Another worker may have taken it in the meantime.
+        QMutexLocker locker(&mQueues[best]->mutex);
+        if (!mQueues[best]->tasks.isEmpty()) {
+            TaskPtr task = mQueues[best]->tasks.takeFirst();
+            mQueuedCount.deref();
+            return task;
+        }
+    }
+    return TaskPtr();
+}
+
+bool JobScheduler::takeQueuedTask(const TaskPtr &task)
+{
+    WorkQueue *queue = mQueues[task->queue];
+    QMutexLocker locker(&queue->mutex);
+    if (!queue->tasks.removeOne(task))
+        return false;
+    mQueuedCount.deref();
+    return true;
+}
+
+void JobScheduler::raisePriority(const TaskPtr &task, int priority)
+{
+    WorkQueue *queue = mQueues[task->queue];
+    QMutexLocker locker(&queue->mutex);
+    if (task->priority >= priority || !queue->tasks.removeOne(task))
+        return;
+    task->priority = priority;
+    insertTask(queue, task);
+}
+
+bool JobScheduler::isFinished(const TaskPtr &task)
+{
+    QMutexLocker locker(&mStateMutex);
+    return task->state == SchedulerTask::Finished;
+}
+
+void JobScheduler::workerLoop(int index)
+{
+    forever {
+        if (TaskPtr task = takeTask(index)) {
+            runTask(task);
+            continue;
+        }
+
+        QMutexLocker locker(&mIdleMutex);
+        if (mQuit)
+            return;
+        if (mQueuedCount.load() == 0)
+            mWorkAvailable.wait(&mIdleMutex);
+    }
+}
+
+void JobScheduler::runTask(const TaskPtr &task)
+{
+    {
+        QMutexLocker locker(&mStateMutex);
+        task->state = SchedulerTask::Running;
+    }
+
+    if (!task->token.isCancelled())
+        task->work();
+
+    finishTask(task);
+}
+
+void JobScheduler::finishTask(const TaskPtr &task)
+{
+    // Post the continuation before waking anyone in wait(), so a caller that
+    // processes events afterwards sees it.
+    if (task->continuation) {
+        QPointer<QObject> context = task->context;
+        Function continuation = task->continuation;
+        QMetaObject::invokeMethod(this, [context, continuation]() {
+            if (context)
+                continuation();
+        }, Qt::QueuedConnection);
+    }
+
+    // Release whatever the job captured.
+    task->work = Function();
+    task->continuation = Function();
+
+    QMutexLocker locker(&mStateMutex);
+    task->state = SchedulerTask::Finished;
+    task->token.d->pending--;
+    mTaskFinished.wakeAll();
+}
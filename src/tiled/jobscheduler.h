@@ -0,0 +1,215 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSharedPointer>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <functional>
+
+class SchedulerTask;
+
+/**
+ * Tells running jobs to stop.  Any number of jobs may share a token, and
+ * cancelling it cancels all of them.  A job whose token is cancelled before
+ * it starts isn't run, but its continuation still is.
+ */
+class JobToken
+{
+public:
+    JobToken() : d(new Data) {}
+
+    void cancel()
+    { d->cancelled.store(1); }
+
+    /**
+     * Lets new jobs with this token run again.  Only call this once the
+     * cancelled jobs are finished, see JobScheduler::wait().
+     */
+    void reset()
+    { d->cancelled.store(0); }
+
+    bool isCancelled() const
+    { return d->cancelled.load() != 0; }
+
+    /**
+     * The flag cancel() sets, for MapRenderer::setAbortFlag().  It is valid
+     * as long as any copy of this token exists.
+     */
+    const QAtomicInt *abortFlag() const
+    { return &d->cancelled; }
+
+    bool operator==(const JobToken &other) const
+    { return d == other.d; }
+
+private:
+    struct Data
+    {
+        Data() : cancelled(0), pending(0) {}
+        QAtomicInt cancelled; // set from any thread
+        int pending; // unfinished jobs, guarded by the scheduler
+    };
+    QSharedPointer<Data> d;
+
+    friend class JobScheduler;
+};
+
+/**
+ * Refers to one scheduled job.  A default-constructed handle refers to none.
+ */
+class JobHandle
+{
+public:
+    JobHandle() {}
+
+    bool isValid() const
+    { return !d.isNull(); }
+
+    bool isFinished() const;
+
+    /**
+     * Moves the job ahead in the queue it is waiting in if \a priority is
+     * higher than its own.  Does nothing once the job has started.
+     */
+    void raisePriority(int priority);
+
+    /**
+     * See JobScheduler::wait().
+     */
+    void wait();
+
+private:
+    JobHandle(const QSharedPointer<SchedulerTask> &task) : d(task) {}
+
+    QSharedPointer<SchedulerTask> d;
+
+    friend class JobScheduler;
+};
+
+/**
+ * The application's background threads.  MapManager, MapImageManager,
+ * TilesetManager and the mini-maps all give their work to this class instead
+ * of keeping threads of their own.
+ *
+ * There is one worker thread per core.  Each worker has its own queue, kept
+ * in priority order.  A job scheduled from a worker goes on that worker's
+ * queue, other jobs are spread over the queues.  An idle worker takes the
+ * most urgent job at the front of any queue, so one slow job never leaves
+ * work waiting behind it while other threads sit idle.
+ *
+ * A job may have a continuation, which is called in the GUI thread once the
+ * job is done unless the context object was deleted first.
+ *
+ * While it exists, MapReader and MapWriter split their layers over the
+ * workers too, through Tiled::TaskRunner.
+ */
+class JobScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Priority {
+        PriorityLow,
+        PriorityNormal,
+        PriorityHigh
+    };
+
+    typedef std::function<void()> Function;
+
+    static JobScheduler *instance();
+    static void deleteInstance();
+
+    JobHandle schedule(const Function &work,
+                       int priority = PriorityNormal,
+                       const JobToken &token = JobToken());
+
+    JobHandle schedule(const Function &work, int priority,
+                       const JobToken &token,
+                       QObject *context, const Function &continuation);
+
+    /**
+     * Blocks until \a job has finished.  If no worker has started it yet, it
+     * is run in the calling thread.  The continuation is still called later,
+     * from the event loop.
+     */
+    void wait(const JobHandle &job);
+
+    /**
+     * Blocks until every job using \a token has finished.  The ones that
+     * haven't started are run in the calling thread, or dropped if the token
+     * was cancelled.
+     */
+    void wait(const JobToken &token);
+
+    /**
+     * Runs every function in \a work on the workers and blocks until they
+     * have all finished.  The calling thread runs the ones no worker got to.
+     */
+    void runAll(const QVector<Function> &work);
+
+    int threadCount() const
+    { return mWorkers.size(); }
+
+private:
+    class Worker;
+    typedef QSharedPointer<SchedulerTask> TaskPtr;
+
+    struct WorkQueue
+    {
+        QMutex mutex;
+        QList<TaskPtr> tasks;
+    };
+
+    Q_DISABLE_COPY(JobScheduler)
+    JobScheduler();
+    ~JobScheduler();
+
+    void enqueue(const TaskPtr &task, int queue);
+    void insertTask(WorkQueue *queue, const TaskPtr &task);
+    TaskPtr takeTask(int index);
+    bool takeQueuedTask(const TaskPtr &task);
+    void raisePriority(const TaskPtr &task, int priority);
+    bool isFinished(const TaskPtr &task);
+    void workerLoop(int index);
+    void runTask(const TaskPtr &task);
+    void finishTask(const TaskPtr &task);
+
+    QVector<Worker*> mWorkers;
+    QVector<WorkQueue*> mQueues;
+    QAtomicInt mQueuedCount;
+    QAtomicInt mNextQueue;
+
+    QMutex mIdleMutex;
+    QWaitCondition mWorkAvailable;
+    bool mQuit;
+
+    QMutex mStateMutex;
+    QWaitCondition mTaskFinished;
+
+    static JobScheduler *mInstance;
+
+    friend class JobHandle;
+};
+
+#endif // JOBSCHEDULER_H
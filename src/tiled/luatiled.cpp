@@ -35,11 +35,14 @@
 
 #include "tolua.h"
 
+#include <QCoreApplication>
 #include <QElapsedTimer>
 #include <QFileInfo>
 #include <QHash>
+#include <QMutex>
 #include <QString>
 #include <QTextStream>
+#include <QThread>
 
 extern "C" {
 #include "lualib.h"
@@ -52,9 +55,23 @@ using namespace Tiled::Lua;
 
 TOLUA_API int tolua_tiled_open(lua_State *L);
 
+// LuaWorldRunner runs scripts outside the GUI thread, but the tileset managers
+// may only be used in it.  The runner's JobPipeline runs the event loop while
+// it waits for the scripts, so these calls are answered right away.
+template<typename Function>
+static void inGuiThread(Function function)
+{
+    if (QThread::currentThread() == qApp->thread())
+        function();
+    else
+        QMetaObject::invokeMethod(qApp, function, Qt::BlockingQueuedConnection);
+}
+
 const char *Lua::cstring(const QString &qstring)
 {
     static QHash<QString,const char*> StringHash;
+    static QMutex mutex;
+    QMutexLocker locker(&mutex);
     if (!StringHash.contains(qstring)) {
         QByteArray b = qstring.toLatin1();
         char *s = new char[b.size() + 1];
@@ -149,13 +166,15 @@ tolua_lerror:
 
 LuaScript::LuaScript(Map *map, int cellX, int cellY) :
     L(0),
-    mMap(map, cellX, cellY)
+    mMap(map, cellX, cellY),
+    mCaptureOutput(false)
 {
 }
 
 LuaScript::LuaScript(Map *map) :
     L(0),
-    mMap(map)
+    mMap(map),
+    mCaptureOutput(false)
 {
 }
 
@@ -185,18 +204,27 @@ lua_State *LuaScript::init()
     return L;
 }
 
+// The output of a script that may be running outside the GUI thread.
+static thread_local QString *sCapturedOutput = nullptr;
+
 extern "C" {
 
 // see luaconf.h
 // these are where print() calls go
 void luai_writestring(const char *s, int len)
 {
-    LuaConsole::instance()->writestring(s, len);
+    if (sCapturedOutput)
+        sCapturedOutput->append(QString::fromLatin1(s, len));
+    else
+        LuaConsole::instance()->writestring(s, len);
 }
 
 void luai_writeline()
 {
-    LuaConsole::instance()->writeline();
+    if (sCapturedOutput)
+        sCapturedOutput->append(QLatin1Char('\n'));
+    else
+        LuaConsole::instance()->writeline();
 }
 
 int traceback(lua_State *L) {
@@ -218,6 +246,11 @@ bool LuaScript::dofile(const QString &f, QString &output)
     QElapsedTimer elapsed;
     elapsed.start();
 
+    if (mCaptureOutput) {
+        output.clear();
+        sCapturedOutput = &output;
+    }
+
     tolua_pushusertype(L, &mMap, "LuaMap");
     lua_setglobal(L, "map");
 
@@ -232,6 +265,14 @@ bool LuaScript::dofile(const QString &f, QString &output)
         status = lua_pcall(L, 0, 0, base);
         lua_remove(L, base);
     }
+    if (mCaptureOutput) {
+        sCapturedOutput = nullptr;
+        if (status != LUA_OK)
+            output += QString::fromLatin1(lua_tostring(L, -1)) + QLatin1Char('\n');
+        output += QCoreApplication::translate("LuaScript", "---------- script completed in %1s ----------")
+                .arg(elapsed.elapsed() / 1000.0);
+        return status == LUA_OK;
+    }
     if (status != LUA_OK) {
         output = QString::fromLatin1(lua_tostring(L, -1));
         if (Tiled::Internal::Preferences::instance()->enableDarkTheme())
@@ -424,7 +465,7 @@ bool LuaTileLayer::replaceTile(Tile *oldTile, Tile *newTile)
     if (newTile == LuaMap::noneTile()) newTile = 0;
     initClone();
     bool replaced = false; 
-    if (oldTile == LuaMap::noneTile())
+    if (oldTile == LuaMap::noneTile() || oldTile == 0)
     {
         for (int y = 0; y < mClone->width(); y++) {
             for (int x = 0; x < mClone->width(); x++) {
@@ -437,15 +478,16 @@ bool LuaTileLayer::replaceTile(Tile *oldTile, Tile *newTile)
         }
     }
     else {
-        for (int y = 0; y < mClone->width(); y++) {
-            for (int x = 0; x < mClone->width(); x++) {
-                if (mCloneTileLayer->cellAt(x, y).tile == oldTile) {
-                    mCloneTileLayer->setCell(x, y, Cell(newTile));
-                    mAltered += QRect(x, y, 1, 1);
-                    replaced = true;
-                }
-            }
+        QVector<QPoint> points;
+        mCloneTileLayer->forEachNonEmptyCell([&](int x, int y, const Cell &cell) {
+            if (cell.tile == oldTile)
+                points += QPoint(x, y);
+        });
+        for (const QPoint &p : qAsConst(points)) {
+            mCloneTileLayer->setCell(p.x(), p.y(), Cell(newTile));
+            mAltered += QRect(p, QSize(1, 1));
         }
+        replaced = !points.isEmpty();
     }
     return replaced;
 }
@@ -455,24 +497,31 @@ bool LuaTileLayer::replaceTiles(QList<Tile *> &tiles)
     if (tiles.size() % 2)
         return false;
     initClone();
-    bool replaced = false;
-    for (int y = 0; y < mClone->width(); y++) {
-        for (int x = 0; x < mClone->width(); x++) {
-            for (int i = 0; i < tiles.size(); i += 2) {
-                Tile *oldTile = tiles[i];
-                Tile *newTile = tiles[i + 1];
-                if (newTile == LuaMap::noneTile())
-                    newTile = 0;
-                if (mCloneTileLayer->cellAt(x, y).tile == oldTile) {
-                    mCloneTileLayer->setCell(x, y, Cell(newTile));
-                    mAltered += QRect(x, y, 1, 1);
-                    replaced = true;
-                    break;
-                }
-            }
+
+    // Only non-empty cells can match, so visit just those.
+    QHash<Tile*,Tile*> replacements;
+    for (int i = 0; i < tiles.size(); i += 2) {
+        Tile *newTile = tiles[i + 1];
+        if (newTile == LuaMap::noneTile())
+            newTile = 0;
+        if (!replacements.contains(tiles[i])) // the first pair wins
+            replacements.insert(tiles[i], newTile);
+    }
+
+    QVector<QPoint> points;
+    QVector<Tile*> newTiles;
+    mCloneTileLayer->forEachNonEmptyCell([&](int x, int y, const Cell &cell) {
+        auto it = replacements.constFind(cell.tile);
+        if (it != replacements.constEnd()) {
+            points += QPoint(x, y);
+            newTiles += it.value();
         }
+    });
+    for (int i = 0; i < points.size(); i++) {
+        mCloneTileLayer->setCell(points[i].x(), points[i].y(), Cell(newTiles[i]));
+        mAltered += QRect(points[i], QSize(1, 1));
     }
-    return replaced;
+    return !points.isEmpty();
 }
 
 /////
@@ -552,7 +601,10 @@ LuaMap::~LuaMap()
     qDeleteAll(mRemovedLayers);
     delete mClone;
 
-    Tiled::Internal::TilesetManager::instance()->removeReferences(mNewTilesets);
+    QList<Tileset*> tilesets = mNewTilesets;
+    inGuiThread([tilesets] {
+        Tiled::Internal::TilesetManager::instance()->removeReferences(tilesets);
+    });
 }
 
 LuaMap::Orientation LuaMap::orientation()
@@ -733,6 +785,20 @@ Tileset *LuaMap::tilesetAt(int index)
     return 0;
 }
 
+// Loads a tileset from Tilesets.txt and returns a copy of it.
+static Tileset *cloneMetaTileset(const QString &tilesetName)
+{
+    Tileset *result = nullptr;
+    inGuiThread([&] {
+        Tiled::Internal::TileMetaInfoMgr *mgr = Tiled::Internal::TileMetaInfoMgr::instance();
+        if (Tileset *ts = mgr->tileset(tilesetName)) {
+            mgr->loadTilesets(QList<Tileset*>() << ts);
+            result = ts->clone();
+        }
+    });
+    return result;
+}
+
 void LuaMap::replaceTilesByName(const char *names)
 {
     QString ss = QString::fromLatin1(names);
@@ -757,10 +823,7 @@ void LuaMap::replaceTilesByName(const char *names)
             }
         }
         if (tsFrom == 0) {
-            if (Tileset *ts = Tiled::Internal::TileMetaInfoMgr::instance()->tileset(from.tileset())) {
-                Tiled::Internal::TileMetaInfoMgr::instance()->loadTilesets(QList<Tileset*>() << ts);
-                tsFrom = ts->clone();
-            }
+            tsFrom = cloneMetaTileset(from.tileset());
             if (tsFrom == 0) {
                 goto errorExit;
             }
@@ -776,10 +839,7 @@ void LuaMap::replaceTilesByName(const char *names)
             }
         }
         if (tsTo == 0) {
-            if (Tileset *ts = Tiled::Internal::TileMetaInfoMgr::instance()->tileset(to.tileset())) {
-                Tiled::Internal::TileMetaInfoMgr::instance()->loadTilesets(QList<Tileset*>() << ts);
-                tsTo = ts->clone();
-            }
+            tsTo = cloneMetaTileset(to.tileset());
             if (tsTo == 0)
                 goto errorExit;
             addTilesets += tsTo;
@@ -807,7 +867,9 @@ void LuaMap::replaceTilesByName(const char *names)
     foreach (Tileset *ts, addTilesets) {
         if (replaced) {
             addTileset(ts);
-            Tiled::Internal::TilesetManager::instance()->addReference(ts);
+            inGuiThread([ts] {
+                Tiled::Internal::TilesetManager::instance()->addReference(ts);
+            });
             mNewTilesets += ts;
         } else {
             delete ts;
@@ -426,8 +426,17 @@ public:
     lua_State *init();
     bool dofile(const QString &f, QString &output);
 
+    /**
+     * When set, dofile() puts everything the script prints into its output
+     * argument instead of the LuaConsole and doesn't process events, so the
+     * script can run in any thread.
+     */
+    void setCaptureOutput(bool capture)
+    { mCaptureOutput = capture; }
+
     lua_State *L;
     LuaMap mMap;
+    bool mCaptureOutput;
 };
 
 class LuaPerlin
@@ -19,13 +19,7 @@
 #include "ui_luaworlddialog.h"
 
 #include "luaconsole.h"
-#include "mainwindow.h"
-#include "mapdocument.h"
-#include "mapmanager.h"
-#include "preferences.h"
-#include "tilesetmanager.h"
-#include "tmxmapreader.h"
-#include "tmxmapwriter.h"
+#include "luaworldrunner.h"
 #include "zprogress.h"
 
 #include "worlded/world.h"
@@ -35,10 +29,7 @@
 #include <QFile>
 #include <QFileDialog>
 #include <QMessageBox>
-#include <QScopedPointer>
 #include <QSettings>
-#include <QTemporaryFile>
-#include <QUndoStack>
 
 using namespace Tiled;
 using namespace Internal;
@@ -77,6 +68,15 @@ LuaWorldDialog::LuaWorldDialog(QWidget *parent) :
     if (!f.isEmpty() && QFileInfo(f).exists())
         ui->scriptEdit->setText(QDir::toNativeSeparators(f));
 
+    // An earlier run on the selected world didn't finish.
+    if (row != -1 && settings.value(QLatin1String("LuaWorldDialog/ResumeWorld")).toString()
+            == ui->listPZW->item(row)->text()) {
+        QPoint cell = settings.value(QLatin1String("LuaWorldDialog/ResumeCell")).toPoint();
+        ui->resumeCheckBox->setChecked(true);
+        ui->resumeX->setValue(cell.x());
+        ui->resumeY->setValue(cell.y());
+    }
+
     ui->listPZW->setFocus();
 }
 
@@ -94,85 +94,6 @@ void LuaWorldDialog::setList()
     }
 }
 
-bool LuaWorldDialog::processMap(const QString &mapFilePath)
-{
-    TmxMapReader reader;
-    Map *map = reader.read(mapFilePath);
-    if (!map) {
-        QMessageBox::critical(this, tr("Error Loading Map"),
-                              reader.errorString());
-        return false;
-    }
-
-    bool showAdjacentMaps = Preferences::instance()->showAdjacentMaps();
-    Preferences::instance()->setShowAdjacentMaps(false);
-    QScopedPointer<MapDocument> doc(new MapDocument(map, mapFilePath));
-    Preferences::instance()->setShowAdjacentMaps(showAdjacentMaps);
-
-    if (!MainWindow::instance()->LuaScript(doc.data(), ui->scriptEdit->text())) {
-        QMessageBox::critical(this, tr("LUA Error"),
-                              tr("The LUA script returned an error.\nCheck the console."));
-        return false;
-    }
-
-    // MainWindow::LuaScript() creates a macro containing zero or more undo commands.
-    // If the LUA script had no effect, don't write the map again.
-    if (doc.data()->undoStack()->isClean() ||
-            (doc.data()->undoStack()->count() == 1 &&
-            doc.data()->undoStack()->command(0)->childCount() == 0)) {
-        LuaConsole::instance()->write(mapFilePath + tr(" is unchanged."), Qt::blue);
-        return true;
-    }
-
-    QFileInfo info(mapFilePath);
-
-    QTemporaryFile tempFile;
-    if (!tempFile.open()) {
-        QMessageBox::critical(this, tr("Error Writing Map"),
-                              tempFile.errorString());
-        return false;
-    }
-    TmxMapWriter w;
-    if (!w.write(map, tempFile, info.absolutePath())) {
-        QMessageBox::critical(this, tr("Error Writing Map"),
-                              w.errorString());
-        return false;
-    }
-
-    // foo.tmx -> backupDir/foo.tmx(.bak)
-    QFile backup(mapFilePath);
-    QDir backupDir(info.absoluteDir());
-    if (ui->backupsGroupBox->isChecked())
-        backupDir.setPath(ui->backupsEdit->text());
-    QString backupPath = backupDir.filePath(info.fileName());
-    if (backupDir == info.absoluteDir())
-        backupPath += QLatin1String(".bak");
-    QFile::remove(backupPath);
-    if (!backup.rename(backupPath)) {
-        QString msg = QString(QLatin1String("Error renaming file!\nFrom: %1\nTo: %2"))
-                .arg(info.fileName())
-                .arg(QFileInfo(backupPath).fileName());
-        QMessageBox::critical(this, tr("Error Writing Map"), msg);
-        return false;
-    }
-
-    // /tmp/tempXYZ -> foo.tmx
-    if (!tempFile.rename(mapFilePath)) {
-        backup.rename(mapFilePath);
-        QString msg = QString(QLatin1String("Error renaming file!\nFrom: %1\nTo: %2"))
-                .arg(QFileInfo(tempFile).fileName())
-                .arg(info.fileName());
-        QMessageBox::critical(this, tr("Error Writing Map"), msg);
-        return false;
-    }
-
-    // If anything above failed, the temp file should auto-remove, but not after
-    // a successful save.
-    tempFile.setAutoRemove(false);
-
-    return true;
-}
-
 void LuaWorldDialog::accept()
 {
     int row = ui->listPZW->currentRow();
@@ -206,19 +127,56 @@ void LuaWorldDialog::accept()
 
     PROGRESS progress(QLatin1String("Running LUA Script"), this);
 
+    LuaWorldRunner runner;
+    runner.setScript(ui->scriptEdit->text());
+    if (ui->backupsGroupBox->isChecked())
+        runner.setBackupDirectory(ui->backupsEdit->text());
+    runner.setDryRun(ui->dryRunCheckBox->isChecked());
+    runner.setStopOnFailure(true);
+
     World *world = WorldEd::WorldEdMgr::instance()->worldAt(row);
-    for (int y = 0; y < world->height(); y++) {
-        for (int x = 0; x < world->width(); x++) {
-            WorldCell *cell = world->cellAt(x, y);
-            QString filePath = cell->mapFilePath();
-            if (filePath.isEmpty() ||
-                    !QFileInfo(filePath).exists())
-                continue;
-            progress.update(QString(QLatin1String("Cell %1,%2")).arg(x).arg(y));
-            LuaConsole::instance()->write(filePath, Qt::blue);
-            if (!processMap(filePath))
-                break;
+    QPoint startCell;
+    if (ui->resumeCheckBox->isChecked())
+        startCell = QPoint(ui->resumeX->value(), ui->resumeY->value());
+    const QList<LuaWorldRunner::MapResult> maps = LuaWorldRunner::worldMaps(world, startCell);
+
+    int done = 0;
+    connect(&runner, &LuaWorldRunner::mapFinished, [&](const LuaWorldRunner::MapResult &result) {
+        progress.update(tr("Running LUA Script (%1 of %2 done, last was cell %3,%4)")
+                        .arg(++done).arg(maps.size()).arg(result.x).arg(result.y));
+        LuaConsole::instance()->write(result.mapFilePath, Qt::blue);
+        if (!result.output.isEmpty())
+            LuaConsole::instance()->write(result.output);
+        if (result.result == LuaWorldRunner::Failed)
+            LuaConsole::instance()->write(result.error, Qt::red);
+        else if (result.result == LuaWorldRunner::Unchanged)
+            LuaConsole::instance()->write(result.mapFilePath + tr(" is unchanged."), Qt::blue);
+        else if (runner.isDryRun())
+            LuaConsole::instance()->write(result.mapFilePath + tr(" would be changed."), Qt::blue);
+
+        // Remember where to start again if the run is interrupted.
+        if (runner.isDryRun())
+            return;
+        int index = runner.resumeIndex();
+        if (index < maps.size()) {
+            settings.setValue(QLatin1String("LuaWorldDialog/ResumeWorld"), f);
+            settings.setValue(QLatin1String("LuaWorldDialog/ResumeCell"),
+                              QPoint(maps[index].x, maps[index].y));
+        } else {
+            settings.remove(QLatin1String("LuaWorldDialog/ResumeWorld"));
+            settings.remove(QLatin1String("LuaWorldDialog/ResumeCell"));
+        }
+    });
+
+    if (!runner.processMaps(maps)) {
+        QString msg = tr("The LUA script failed on %1 map(s).\nCheck the console.")
+                .arg(runner.failureCount());
+        if (runner.resumeIndex() < maps.size()) {
+            const LuaWorldRunner::MapResult &resume = maps[runner.resumeIndex()];
+            msg += tr("\nThe maps before cell %1,%2 are done, start there next time.")
+                    .arg(resume.x).arg(resume.y);
         }
+        QMessageBox::critical(this, tr("LUA Error"), msg);
     }
 
     QDialog::accept();
@@ -34,7 +34,6 @@ public:
     
 private:
     void accept();
-    bool processMap(const QString &mapFilePath);
 
 private slots:
     void setList();
@@ -0,0 +1,256 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "luaworldrunner.h"
+
+#include "jobpipeline.h"
+#include "luatiled.h"
+#include "mainwindow.h"
+#include "mapdocument.h"
+#include "preferences.h"
+#include "tmxmapreader.h"
+#include "tmxmapwriter.h"
+
+#include "worlded/world.h"
+#include "worlded/worldcell.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QUndoStack>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+class LuaWorldRunner::Job
+{
+public:
+    Job() :
+        index(0),
+        doc(nullptr),
+        scripter(nullptr),
+        ok(false)
+    {
+    }
+
+    int index;
+    MapDocument *doc;
+    Lua::LuaScript *scripter;
+    bool ok;
+    MapResult result;
+};
+
+/////
+
+LuaWorldRunner::LuaWorldRunner(QObject *parent) :
+    QObject(parent),
+    mDryRun(false),
+    mMaxThreadCount(qMax(1, QThread::idealThreadCount())),
+    mStopOnFailure(false),
+    mStopped(false),
+    mResumeIndex(0)
+{
+}
+
+LuaWorldRunner::~LuaWorldRunner()
+{
+}
+
+void LuaWorldRunner::setMaxThreadCount(int count)
+{
+    mMaxThreadCount = qMax(1, count);
+}
+
+QList<LuaWorldRunner::MapResult> LuaWorldRunner::worldMaps(World *world, const QPoint &startCell)
+{
+    const QPoint origin = world->getGenerateLotsSettings().worldOrigin;
+    QList<MapResult> maps;
+    for (int y = startCell.y(); y < world->height(); y++) {
+        for (int x = (y == startCell.y()) ? startCell.x() : 0; x < world->width(); x++) {
+            WorldCell *cell = world->cellAt(x, y);
+            if (!cell || cell->mapFilePath().isEmpty() ||
+                    !QFileInfo(cell->mapFilePath()).exists())
+                continue;
+            MapResult map;
+            map.mapFilePath = cell->mapFilePath();
+            map.x = x;
+            map.y = y;
+            map.cellX = origin.x() + x;
+            map.cellY = origin.y() + y;
+            maps += map;
+        }
+    }
+    return maps;
+}
+
+bool LuaWorldRunner::processMaps(const QList<MapResult> &maps)
+{
+    mResults.clear();
+    mDone.fill(false, maps.size());
+    mResumeIndex = 0;
+    mStopped = false;
+
+    // Every job holds a MapDocument, so the pipeline only keeps a few of
+    // them waiting.
+    JobPipeline pipeline;
+    pipeline.setMaxRunning(mMaxThreadCount);
+
+    const QString script = mScript;
+    for (int i = 0; i < maps.size() && !mStopped; i++) {
+        Job *job = loadMap(i, maps[i]);
+        if (!job->scripter) {
+            finishJob(job);
+            continue;
+        }
+
+        pipeline.start([job, script]() {
+            job->ok = job->scripter->dofile(script, job->result.output);
+        }, [this, job]() {
+            finishJob(job);
+        });
+    }
+
+    pipeline.waitForAll();
+
+    return failureCount() == 0;
+}
+
+int LuaWorldRunner::failureCount() const
+{
+    int count = 0;
+    for (const MapResult &result : mResults) {
+        if (result.result == Failed)
+            ++count;
+    }
+    return count;
+}
+
+// TmxMapReader, MapDocument and everything LuaScript's constructor copies
+// belong to the GUI thread, so only LuaScript::dofile() runs in a worker
+// thread.
+LuaWorldRunner::Job *LuaWorldRunner::loadMap(int index, const MapResult &map)
+{
+    Job *job = new Job;
+    job->index = index;
+    job->result = map;
+
+    TmxMapReader reader;
+    Map *tmx = reader.read(map.mapFilePath);
+    if (!tmx) {
+        job->result.error = reader.errorString();
+        return job;
+    }
+
+    bool showAdjacentMaps = Preferences::instance()->showAdjacentMaps();
+    Preferences::instance()->setShowAdjacentMaps(false);
+    job->doc = new MapDocument(tmx, map.mapFilePath);
+    Preferences::instance()->setShowAdjacentMaps(showAdjacentMaps);
+
+    job->scripter = new Lua::LuaScript(job->doc->map(), map.cellX, map.cellY);
+    job->scripter->mMap.mSelection = job->doc->tileSelection();
+    job->scripter->setCaptureOutput(true);
+
+    return job;
+}
+
+void LuaWorldRunner::finishJob(Job *job)
+{
+    MapResult &result = job->result;
+
+    if (job->scripter) {
+        if (job->ok) {
+            MainWindow::ApplyScriptChanges(job->doc, tr("Lua Script"), &job->scripter->mMap);
+
+            // ApplyScriptChanges() creates a macro containing zero or more undo
+            // commands.  If the LUA script had no effect, don't write the map again.
+            QUndoStack *undoStack = job->doc->undoStack();
+            if (undoStack->isClean() ||
+                    (undoStack->count() == 1 && undoStack->command(0)->childCount() == 0))
+                result.result = Unchanged;
+            else if (mDryRun || saveMap(job))
+                result.result = Changed;
+        } else {
+            result.error = tr("The LUA script returned an error.");
+        }
+    }
+
+    // The script's copy of the map refers to the document's layers.
+    delete job->scripter;
+    delete job->doc;
+
+    if (result.result == Failed) {
+        if (mStopOnFailure)
+            mStopped = true;
+    } else {
+        mDone[job->index] = true;
+        while (mResumeIndex < mDone.size() && mDone[mResumeIndex])
+            ++mResumeIndex;
+    }
+
+    mResults += result;
+    emit mapFinished(result);
+    delete job;
+}
+
+bool LuaWorldRunner::saveMap(Job *job)
+{
+    const QString &mapFilePath = job->result.mapFilePath;
+    QFileInfo info(mapFilePath);
+
+    QTemporaryFile tempFile;
+    if (!tempFile.open()) {
+        job->result.error = tempFile.errorString();
+        return false;
+    }
+    TmxMapWriter w;
+    if (!w.write(job->doc->map(), tempFile, info.absolutePath())) {
+        job->result.error = w.errorString();
+        return false;
+    }
+
+    // foo.tmx -> backupDir/foo.tmx(.bak)
+    QFile backup(mapFilePath);
+    QDir backupDir(info.absoluteDir());
+    if (!mBackupDirectory.isEmpty())
+        backupDir.setPath(mBackupDirectory);
+    QString backupPath = backupDir.filePath(info.fileName());
+    if (backupDir == info.absoluteDir())
+        backupPath += QLatin1String(".bak");
+    QFile::remove(backupPath);
+    if (!backup.rename(backupPath)) {
+        job->result.error = tr("Error renaming file!\nFrom: %1\nTo: %2")
+                .arg(info.fileName())
+                .arg(QFileInfo(backupPath).fileName());
+        return false;
+    }
+
+    // /tmp/tempXYZ -> foo.tmx
+    if (!tempFile.rename(mapFilePath)) {
+        backup.rename(mapFilePath);
+        job->result.error = tr("Error renaming file!\nFrom: %1\nTo: %2")
+                .arg(QFileInfo(tempFile).fileName())
+                .arg(info.fileName());
+        return false;
+    }
+
+    // If anything above failed, the temp file should auto-remove, but not after
+    // a successful save.
+    tempFile.setAutoRemove(false);
+
+    return true;
+}
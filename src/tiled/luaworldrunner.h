@@ -0,0 +1,148 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LUAWORLDRUNNER_H
+#define LUAWORLDRUNNER_H
+
+#include <QList>
+#include <QObject>
+#include <QPoint>
+#include <QVector>
+
+class World;
+
+/**
+ * Runs a Lua script on .tmx files and saves each file again if the script
+ * changed anything.  The old file is kept as a backup.
+ *
+ * Reading a map, creating its MapDocument and applying the script's changes
+ * to it happen in the GUI thread.  The scripts themselves run in the
+ * JobScheduler's threads through a JobPipeline, each in its own lua_State,
+ * so several maps are scripted at once.  What a script prints is kept in
+ * its result instead of going to the LuaConsole.
+ */
+class LuaWorldRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Result {
+        Failed,
+        Unchanged,
+        Changed
+    };
+
+    struct MapResult
+    {
+        MapResult() : x(-1), y(-1), cellX(-1), cellY(-1), result(Failed) {}
+
+        QString mapFilePath;
+        int x, y;           // The cell in the world, or -1.
+        int cellX, cellY;   // What the script sees, including the world origin.
+        Result result;
+        QString output;
+        QString error;
+    };
+
+    LuaWorldRunner(QObject *parent = nullptr);
+    ~LuaWorldRunner();
+
+    void setScript(const QString &fileName)
+    { mScript = fileName; }
+
+    /**
+     * The directory the old map files are moved into.  When empty, or the
+     * same as the map's directory, foo.tmx is renamed foo.tmx.bak.
+     */
+    void setBackupDirectory(const QString &directory)
+    { mBackupDirectory = directory; }
+
+    /**
+     * Run the script and report which maps it would change, but don't save
+     * them.
+     */
+    void setDryRun(bool dryRun)
+    { mDryRun = dryRun; }
+    bool isDryRun() const
+    { return mDryRun; }
+
+    /**
+     * The number of scripts run at once.  Defaults to
+     * QThread::idealThreadCount().
+     */
+    void setMaxThreadCount(int count);
+    int maxThreadCount() const
+    { return mMaxThreadCount; }
+
+    /**
+     * Don't start any more maps after one fails.  The ones already running
+     * are finished.
+     */
+    void setStopOnFailure(bool stop)
+    { mStopOnFailure = stop; }
+
+    /**
+     * The maps of every cell in \a world, row by row, starting at
+     * \a startCell.  Use it with resumeIndex() to pick up an interrupted run.
+     */
+    static QList<MapResult> worldMaps(World *world, const QPoint &startCell = QPoint());
+
+    /**
+     * Runs the script on each of \a maps.  Only the map file path and cell
+     * of each are used.  Blocks until they are all done, and returns false if
+     * any of them failed.
+     */
+    bool processMaps(const QList<MapResult> &maps);
+
+    /**
+     * One entry per map that was attempted, in the order they finished.
+     */
+    const QList<MapResult> &results() const
+    { return mResults; }
+
+    int failureCount() const;
+
+    /**
+     * The index in the list given to processMaps() of the first map that
+     * didn't finish, or failed.  Every map before it is done.  This is valid
+     * while the maps are being processed too.
+     */
+    int resumeIndex() const
+    { return mResumeIndex; }
+
+signals:
+    void mapFinished(const LuaWorldRunner::MapResult &result);
+
+private:
+    class Job;
+
+    Job *loadMap(int index, const MapResult &map);
+    void finishJob(Job *job);
+    bool saveMap(Job *job);
+
+    QString mScript;
+    QString mBackupDirectory;
+    bool mDryRun;
+    int mMaxThreadCount;
+    bool mStopOnFailure;
+    bool mStopped;
+    QList<MapResult> mResults;
+    QVector<bool> mDone;
+    int mResumeIndex;
+};
+
+#endif // LUAWORLDRUNNER_H
@@ -26,8 +26,17 @@
 #include "preferences.h"
 #include "tiledapplication.h"
 #ifdef ZOMBOID
+#include "batchmode.h"
+#include "jobscheduler.h"
+#include "mapimagemanager.h"
+#include "mapmanager.h"
+#include "tilemetainfomgr.h"
+#include "tilesetmanager.h"
 #include "worlded/worldedmgr.h"
 #include "zprogress.h"
+#include "BuildingEditor/buildingtemplates.h"
+#include "BuildingEditor/buildingtiles.h"
+#include "BuildingEditor/buildingtmx.h"
 #include <QFileInfo>
 #endif
 
@@ -136,6 +145,17 @@ static void __cdecl invalid_parameter_handler(
 
 #endif
 
+static void setApplicationInfo(QCoreApplication &a)
+{
+    a.setOrganizationName(QLatin1String("TheIndieStone"));
+    a.setApplicationName(QLatin1String("TileZed"));
+#ifdef BUILD_INFO_VERSION
+    a.setApplicationVersion(QLatin1String(AS_STRING(BUILD_INFO_VERSION)));
+#else
+    a.setApplicationVersion(QLatin1String("0.8.1"));
+#endif
+}
+
 int main(int argc, char* argv[])
 {
 #if !defined(QT_NO_DEBUG) && defined(ZOMBOID) && defined(_MSC_VER)
@@ -151,19 +171,40 @@ int main(int argc, char* argv[])
     QApplication::setGraphicsSystem(QLatin1String("raster"));
 #endif
 
+#ifdef ZOMBOID
+    // TileZed --batch <command> ... runs without a window.  Tilesets are
+    // still QPixmaps, so it needs a QApplication, but not a display.
+    if (argc > 1 && qstrcmp(argv[1], "--batch") == 0) {
+        if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        QApplication a(argc, argv);
+        Q_INIT_RESOURCE(buildingeditor);
+        setApplicationInfo(a);
+        const int result = BatchMode().run(QCoreApplication::arguments().mid(2));
+
+        // Same order as MainWindow::~MainWindow(), so the managers' jobs are
+        // cancelled before the JobScheduler goes and every tileset reference
+        // is released before the TilesetManager.
+        BuildingEditor::BuildingTemplates::deleteInstance();
+        BuildingEditor::BuildingTilesMgr::deleteInstance();
+        BuildingEditor::BuildingTMX::deleteInstance();
+        MapImageManager::deleteInstance();
+        MapManager::deleteInstance();
+        TileMetaInfoMgr::deleteInstance();
+        TilesetManager::deleteInstance();
+        JobScheduler::deleteInstance();
+        Preferences::deleteInstance();
+        return result;
+    }
+#endif
+
     TiledApplication a(argc, argv);
 
 #ifdef ZOMBOID
     Q_INIT_RESOURCE(buildingeditor);
 #endif
 
-    a.setOrganizationName(QLatin1String("TheIndieStone"));
-    a.setApplicationName(QLatin1String("TileZed"));
-#ifdef BUILD_INFO_VERSION
-    a.setApplicationVersion(QLatin1String(AS_STRING(BUILD_INFO_VERSION)));
-#else
-    a.setApplicationVersion(QLatin1String("0.8.1"));
-#endif
+    setApplicationInfo(a);
 
 #ifdef Q_WS_MAC
     a.setAttribute(Qt::AA_DontShowIconsInMenus);
@@ -39,6 +39,7 @@
 #include "erasetiles.h"
 #include "bucketfilltool.h"
 #include "filltiles.h"
+#include "jobscheduler.h"
 #include "languagemanager.h"
 #include "layer.h"
 #include "layerdock.h"
@@ -391,6 +392,7 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags flags)
     connect(mUi->actionExport, &QAction::triggered, this, &MainWindow::exportAs);
 #ifdef ZOMBOID
     connect(mUi->actionExportNewBinary, &QAction::triggered, this, &MainWindow::exportNewBinary);
+    connect(mUi->actionExportWorldLots, &QAction::triggered, this, &MainWindow::exportWorldLots);
 #endif
     connect(mUi->actionClose, &QAction::triggered, this, &MainWindow::closeFile);
     connect(mUi->actionCloseAll, &QAction::triggered, this, &MainWindow::closeAllFiles);
@@ -719,6 +721,7 @@ MainWindow::~MainWindow()
 #endif
     TilesetManager::deleteInstance();
     DocumentManager::deleteInstance();
+    JobScheduler::deleteInstance();
     Preferences::deleteInstance();
     LanguageManager::deleteInstance();
     PluginManager::deleteInstance();
@@ -980,14 +983,24 @@ bool MainWindow::InitConfigFiles()
     // Refresh the ui before blocking while loading tilesets etc
     qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
 
+    QString error;
+    if (!loadConfigFiles(error)) {
+        QMessageBox::critical(this, tr("It's no good, Jim!"), error);
+        return false;
+    }
+
+    return true;
+}
+
+bool MainWindow::loadConfigFiles(QString &error)
+{
     // Create ~/.TileZed if needed.
     QString configPath = Preferences::instance()->configPath();
     QDir dir(configPath);
     if (!dir.exists()) {
         if (!dir.mkpath(configPath)) {
-            QMessageBox::critical(this, tr("It's no good, Jim!"),
-                                  tr("Failed to create config directory:\n%1")
-                                  .arg(QDir::toNativeSeparators(configPath)));
+            error = tr("Failed to create config directory:\n%1")
+                    .arg(QDir::toNativeSeparators(configPath));
             return false;
         }
     }
@@ -1007,9 +1020,8 @@ bool MainWindow::InitConfigFiles()
             QString source = Preferences::instance()->appConfigPath(configFile);
             if (QFileInfo(source).exists()) {
                 if (!QFile::copy(source, fileName)) {
-                    QMessageBox::critical(this, tr("It's no good, Jim!"),
-                                          tr("Failed to copy file:\nFrom: %1\nTo: %2")
-                                          .arg(source).arg(fileName));
+                    error = tr("Failed to copy file:\nFrom: %1\nTo: %2")
+                            .arg(source).arg(fileName);
                     return false;
                 }
             }
@@ -1019,48 +1031,43 @@ bool MainWindow::InitConfigFiles()
     // Read Tilesets.txt before TMXConfig.txt in case we are upgrading
     // TMXConfig.txt from VERSION0 to VERSION1.
     if (!TileMetaInfoMgr::instance()->readTxt()) {
-        QMessageBox::critical(this, tr("It's no good, Jim!"),
-                              tr("%1\n(while reading %2)")
-                              .arg(TileMetaInfoMgr::instance()->errorString())
-                              .arg(TileMetaInfoMgr::instance()->txtName()));
+        error = tr("%1\n(while reading %2)")
+                .arg(TileMetaInfoMgr::instance()->errorString())
+                .arg(TileMetaInfoMgr::instance()->txtName());
         return false;
     }
 
     if (!TileMetaInfoMgr::instance()->addNewTilesets()) {
-        QMessageBox::critical(this, tr("It's no good, Jim!"),
-                              tr("%1\n(while adding new tilesets)"));
+        error = tr("%1\n(while adding new tilesets)")
+                .arg(TileMetaInfoMgr::instance()->errorString());
         return false;
     }
 
     if (!BuildingTMX::instance()->readTxt()) {
-        QMessageBox::critical(this, tr("It's no good, Jim!"),
-                              tr("Error while reading %1\n%2")
-                              .arg(BuildingTMX::instance()->txtName())
-                              .arg(BuildingTMX::instance()->errorString()));
+        error = tr("Error while reading %1\n%2")
+                .arg(BuildingTMX::instance()->txtName())
+                .arg(BuildingTMX::instance()->errorString());
         return false;
     }
 
     if (!BuildingTilesMgr::instance()->readTxt()) {
-        QMessageBox::critical(this, tr("It's no good, Jim!"),
-                              tr("Error while reading %1\n%2")
-                              .arg(BuildingTilesMgr::instance()->txtName())
-                              .arg(BuildingTilesMgr::instance()->errorString()));
+        error = tr("Error while reading %1\n%2")
+                .arg(BuildingTilesMgr::instance()->txtName())
+                .arg(BuildingTilesMgr::instance()->errorString());
         return false;
     }
 
     if (!FurnitureGroups::instance()->readTxt()) {
-        QMessageBox::critical(this, tr("It's no good, Jim!"),
-                              tr("Error while reading %1\n%2")
-                              .arg(FurnitureGroups::instance()->txtName())
-                              .arg(FurnitureGroups::instance()->errorString()));
+        error = tr("Error while reading %1\n%2")
+                .arg(FurnitureGroups::instance()->txtName())
+                .arg(FurnitureGroups::instance()->errorString());
         return false;
     }
 
     if (!BuildingTemplates::instance()->readTxt()) {
-        QMessageBox::critical(this, tr("It's no good, Jim!"),
-                              tr("Error while reading %1\n%2")
-                              .arg(BuildingTemplates::instance()->txtName())
-                              .arg(BuildingTemplates::instance()->errorString()));
+        error = tr("Error while reading %1\n%2")
+                .arg(BuildingTemplates::instance()->txtName())
+                .arg(BuildingTemplates::instance()->errorString());
         return false;
     }
 
@@ -1299,6 +1306,9 @@ void MainWindow::exportAs()
 
 #ifdef ZOMBOID
 #include "newmapbinaryfile.h"
+#include "worldlotexporter.h"
+#include <QElapsedTimer>
+#include <QInputDialog>
 void MainWindow::exportNewBinary()
 {
     if (!mMapDocument)
@@ -1313,7 +1323,79 @@ void MainWindow::exportNewBinary()
         return;
     NewMapBinaryFile file;
     MapComposite* mapComposite = mMapDocument->mapComposite();
-    file.write(mapComposite, fileName);
+    // The map may have unsaved edits, so chunks are only reused when the
+    // document knows what changed since it was last exported here.
+    QRegion dirtyRegion(QRect(QPoint(), mMapDocument->map()->size()));
+    mMapDocument->lotExportDirtyRegion(fileName, dirtyRegion);
+    file.setIncremental(true);
+    file.setDirtyRegion(dirtyRegion);
+    if (file.write(mapComposite, fileName))
+        mMapDocument->setLotExported(fileName);
+    else
+        QMessageBox::critical(this, tr("Error Exporting Map"), file.errorString());
+}
+
+void MainWindow::exportWorldLots()
+{
+    WorldEd::WorldEdMgr *mgr = WorldEd::WorldEdMgr::instance();
+    if (mgr->worldCount() == 0) {
+        QMessageBox::information(this, tr("Export World Lots"),
+                                 tr("No WorldEd project has been loaded."));
+        return;
+    }
+
+    QStringList worldNames;
+    for (int i = 0; i < mgr->worldCount(); i++)
+        worldNames += QDir::toNativeSeparators(mgr->worldFileName(i));
+    bool ok = false;
+    QString worldName = QInputDialog::getItem(this, tr("Export World Lots"),
+                                              tr("World:"), worldNames, 0,
+                                              false, &ok);
+    if (!ok)
+        return;
+    World *world = mgr->worldAt(worldNames.indexOf(worldName));
+
+    QString directory = world->getGenerateLotsSettings().exportDir;
+    directory = QFileDialog::getExistingDirectory(this, tr("Export World Lots"),
+                                                  directory);
+    if (directory.isEmpty())
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    WorldLotExporter exporter(world);
+    {
+        PROGRESS progress(tr("Exporting lots"), this);
+        int done = 0;
+        connect(&exporter, &WorldLotExporter::cellFinished, [&](WorldCell *cell) {
+            progress.update(tr("Exporting lots (%1 done, last was %2,%3)")
+                            .arg(++done).arg(cell->x()).arg(cell->y()));
+        });
+        exporter.exportWorld(directory);
+    }
+
+    QStringList details;
+    for (const WorldLotExporter::CellResult &result : exporter.results()) {
+        QString line = tr("%1,%2: load %3 ms, export %4 ms, grid %5 KB, %6/%7 chunks reused")
+                .arg(result.cell->x()).arg(result.cell->y())
+                .arg(result.loadMS).arg(result.exportMS)
+                .arg(result.gridBytes / 1024)
+                .arg(result.chunksReused).arg(result.chunkCount);
+        if (!result.error.isEmpty())
+            line += tr(" FAILED: %1").arg(result.error);
+        details += line;
+    }
+
+    QMessageBox mb(this);
+    mb.setWindowTitle(tr("Export World Lots"));
+    mb.setIcon(exporter.failureCount() ? QMessageBox::Warning : QMessageBox::Information);
+    mb.setText(tr("Exported %1 cells in %2 seconds, %3 failed.")
+               .arg(exporter.results().size())
+               .arg(timer.elapsed() / 1000.0, 0, 'f', 1)
+               .arg(exporter.failureCount()));
+    mb.setDetailedText(details.join(QLatin1Char('\n')));
+    mb.exec();
 }
 #endif
 
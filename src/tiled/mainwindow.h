@@ -128,7 +128,13 @@ public:
 #ifdef ZOMBOID
     bool InitConfigFiles();
 
-    void ApplyScriptChanges(MapDocument *doc, const QString &undoText, Lua::LuaMap *map);
+    /**
+     * Copies the default config files to the config directory if they aren't
+     * there yet, then reads them.  Needs no window, batch mode calls this too.
+     */
+    static bool loadConfigFiles(QString &error);
+
+    static void ApplyScriptChanges(MapDocument *doc, const QString &undoText, Lua::LuaMap *map);
     void LuaScript(const QString &filePath);
     bool LuaScript(MapDocument *doc, const QString &filePath);
 
@@ -160,6 +166,7 @@ public slots:
     void exportAs();
 #ifdef ZOMBOID
     void exportNewBinary();
+    void exportWorldLots();
 #endif
     void closeFile();
     void closeAllFiles();
@@ -134,6 +134,7 @@ void CompositeLayerGroup::addTileLayer(TileLayer *layer, int index)
 
     mBmpBlendLayers.insert(index, nullptr);
     mNoBlends.insert(index, nullptr);
+    mLayerRoles.insert(index, 0);
 #ifdef BUILDINGED
     mBlendOverLayers.insert(index, nullptr);
     mToolLayers.insert(index, ToolLayer());
@@ -150,6 +151,7 @@ void CompositeLayerGroup::removeTileLayer(TileLayer *layer)
     mEmptyLayers.remove(index);
     mBmpBlendLayers.remove(index);
     mNoBlends.remove(index);
+    mLayerRoles.remove(index);
 #ifdef BUILDINGED
     mBlendOverLayers.remove(index);
     mToolLayers.remove(index);
@@ -174,6 +176,7 @@ void CompositeLayerGroup::removeTileLayer(TileLayer *layer)
 void CompositeLayerGroup::prepareDrawing(const MapRenderer *renderer, const QRect &rect)
 {
     mPreparedSubMapLayers.resize(0);
+    updateLayerRoles();
     if (mAnyVisibleLayers == false)
         return;
     for (const SubMapLayers &subMapLayer : qAsConst(mVisibleSubMapLayers)) {
@@ -190,21 +193,41 @@ void CompositeLayerGroup::prepareDrawing(const MapRenderer *renderer, const QRec
         mOwner->bmpBlender()->flush(renderer, rect, mOwner->originRecursive());
 }
 
-static QLatin1String sFloor("0_Floor"); // FIXME: thread safe?
-static QLatin1String sAboveLot("_AboveLot");
+void CompositeLayerGroup::updateLayerRoles()
+{
+    for (int index = 0; index < mLayers.size(); index++)
+        mLayerRoles[index] = layerRoles(mLayers[index]->name(), mLevel, index,
+                                        mOwner->mNoBlendLayer);
+}
 
 bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
                                          QVector<const Cell *> &cells,
                                          QVector<qreal> &opacities) const
+{
+    int keepFloorLayerCount = 0;
+    return orderedCellsAt(pos, cells, opacities, keepFloorLayerCount);
+}
+
+// The number of cells to keep is local to each call so that several threads
+// can draw the same MapComposite at once.  The root map and each adjacent map
+// have their own count, the lots of a map use the count of the root or
+// adjacent map they belong to.
+bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
+                                         QVector<const Cell *> &cells,
+                                         QVector<qreal> &opacities,
+                                         int &keepFloorLayerCount) const
 {
     MapComposite *root = mOwner->rootOrAdjacent();
-    if (root == mOwner)
-        root->mKeepFloorLayerCount = 0;
 
-    QRegion suppressRgn;
-    if (mOwner->levelRecursive() + level() == mOwner->root()->suppressLevel())
-        suppressRgn = mOwner->root()->suppressRegion();
     const QPoint rootPos = pos + mOwner->originRecursive();
+    const bool suppressed =
+            (mOwner->levelRecursive() + level() == mOwner->root()->suppressLevel())
+            && mOwner->root()->isSuppressed(rootPos);
+
+    const bool hideMapTiles = !mOwner->parent() && !mOwner->showMapTiles();
+    const bool lotFloorsOnly = mOwner->parent() != nullptr && mOwner->parent()->showLotFloorsOnly();
+    const bool showBmpTiles = mOwner->parent() || mOwner->showBMPTiles();
+    const bool isRoot = root == mOwner;
 
     QVector<const Cell*> aboveLotCells;
     QVector<qreal> aboveLotOpacities;
@@ -230,17 +253,17 @@ bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
             nbPos = nbTool.mPos;
         }
 #endif // BUILDINGED
+        const quint8 roles = mLayerRoles[index];
         const Cell *cell = &tl->cellAt(subPos);
-        if (!mOwner->parent() && !mOwner->showMapTiles())
+        if (hideMapTiles)
             cell = &emptyCell;
-        if (mOwner->parent() != nullptr && mOwner->parent()->showLotFloorsOnly()) {
-            bool isFloor = !mLevel && !index && (tl->name() == sFloor);
-            if (!isFloor && !tl->name().contains(sAboveLot)) {
+        if (lotFloorsOnly) {
+            if (!(roles & (RoleFloor | RoleAboveLot))) {
                 cell = &emptyCell;
             }
         }
         if (tlBmpBlend && tlBmpBlend->contains(subPos) && !tlBmpBlend->cellAt(subPos).isEmpty())
-            if (mOwner->parent() || mOwner->showBMPTiles()) {
+            if (showBmpTiles) {
                 if (!noBlend || !noBlend->get(subPos - nbPos))
                     cell = &tlBmpBlend->cellAt(subPos);
             }
@@ -252,19 +275,18 @@ bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
         else if (cell->isEmpty() && tlBlendOver && tlBlendOver->contains(subPos))
             cell = &tlBlendOver->cellAt(subPos);
 #endif // BUILDINGED
-        if (index && suppressRgn.contains(rootPos))
+        if (index && suppressed)
             cell = &emptyCell;
-        if (!cell->isEmpty() && (root == mOwner) && tl->name().contains(sAboveLot)) {
+        if (!cell->isEmpty() && isRoot && (roles & RoleAboveLot)) {
             aboveLotCells += cell;
             aboveLotOpacities += mLayerOpacity[index];
             cell = &emptyCell;
         }
         if (!cell->isEmpty()) {
             if (!cleared) {
-                bool isFloor = !mLevel && !index && (tl->name() == sFloor);
-                if (isFloor) root->mKeepFloorLayerCount = 0;
-                cells.resize(root->mKeepFloorLayerCount);
-                opacities.resize(root->mKeepFloorLayerCount);
+                if (roles & RoleFloor) keepFloorLayerCount = 0;
+                cells.resize(keepFloorLayerCount);
+                opacities.resize(keepFloorLayerCount);
                 cleared = true;
             }
             cells.append(cell);
@@ -276,23 +298,22 @@ bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
             else
                 opacities.append(0.25);
 #endif
-            if (mMaxFloorLayer >= index)
-                mOwner->mKeepFloorLayerCount = cells.size();
+            if (isRoot && mMaxFloorLayer >= index)
+                keepFloorLayerCount = cells.size();
         }
 
         // Draw the no-blend tile.
-        if (noBlend && tl->name() == mOwner->mNoBlendLayer && noBlend->get(subPos - nbPos)) {
+        if (noBlend && (roles & RoleNoBlend) && noBlend->get(subPos - nbPos)) {
             if (!cleared) {
-                bool isFloor = !mLevel && !index && (tl->name() == sFloor);
-                if (isFloor) root->mKeepFloorLayerCount = 0;
-                cells.resize(root->mKeepFloorLayerCount);
-                opacities.resize(root->mKeepFloorLayerCount);
+                if (roles & RoleFloor) keepFloorLayerCount = 0;
+                cells.resize(keepFloorLayerCount);
+                opacities.resize(keepFloorLayerCount);
                 cleared = true;
             }
             cells.append(&mNoBlendCell);
             opacities.append(0.25);
-            if (mMaxFloorLayer >= index)
-                mOwner->mKeepFloorLayerCount = cells.size();
+            if (isRoot && mMaxFloorLayer >= index)
+                keepFloorLayerCount = cells.size();
         }
     }
 
@@ -305,8 +326,16 @@ bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
             continue;
         if (!subMapLayer.mBounds.contains(pos))
             continue;
-        subMapLayer.mLayerGroup->orderedCellsAt(pos - subMapLayer.mSubMap->origin(),
-                                                cells, opacities);
+        if (subMapLayer.mSubMap->isAdjacentMap()) {
+            int adjacentKeepFloorLayerCount = 0;
+            subMapLayer.mLayerGroup->orderedCellsAt(pos - subMapLayer.mSubMap->origin(),
+                                                    cells, opacities,
+                                                    adjacentKeepFloorLayerCount);
+        } else {
+            subMapLayer.mLayerGroup->orderedCellsAt(pos - subMapLayer.mSubMap->origin(),
+                                                    cells, opacities,
+                                                    keepFloorLayerCount);
+        }
     }
 
     cells += aboveLotCells;
@@ -318,6 +347,7 @@ bool CompositeLayerGroup::orderedCellsAt(const QPoint &pos,
 void CompositeLayerGroup::prepareDrawing2()
 {
     mPreparedSubMapLayers.resize(0);
+    updateLayerRoles();
     for (MapComposite *subMap : mOwner->subMaps()) {
         int levelOffset = subMap->levelOffset();
         CompositeLayerGroup *layerGroup = subMap->tileLayersForLevel(mLevel - levelOffset);
@@ -332,18 +362,29 @@ void CompositeLayerGroup::prepareDrawing2()
 
 // This is for the benefit of LotFilesManager.  It ignores the visibility of
 // layers (so NoRender layers are included) and visibility of sub-maps.
+// Once prepareDrawing2() was called it only reads the layer group, so any
+// number of threads can call it at once.
 bool CompositeLayerGroup::orderedCellsAt2(const QPoint &pos, QVector<const Cell *> &cells) const
+{
+    int keepFloorLayerCount = 0;
+    return orderedCellsAt2(pos, cells, keepFloorLayerCount);
+}
+
+// Like orderedCellsAt(), the lots of the root map use the count of cells to
+// keep of the root map.
+bool CompositeLayerGroup::orderedCellsAt2(const QPoint &pos, QVector<const Cell *> &cells,
+                                          int &keepFloorLayerCount) const
 {
     MapComposite *root = mOwner->root();
-    if (root == mOwner)
-        root->mKeepFloorLayerCount = 0;
 
     QVector<const Cell*> aboveLotCells;
 
+    const bool isRoot = root == mOwner;
+
     bool cleared = false;
-    int index = -1;
-    foreach (TileLayer *tl, mLayers) {
-        ++index;
+    for (int index = 0; index < mLayers.size(); index++) {
+        TileLayer *tl = mLayers[index];
+        const quint8 roles = mLayerRoles[index];
         TileLayer *tlBmpBlend = mBmpBlendLayers[index];
         MapNoBlend *noBlend = mNoBlends[index];
 #ifdef BUILDINGED
@@ -358,14 +399,13 @@ bool CompositeLayerGroup::orderedCellsAt2(const QPoint &pos, QVector<const Cell
                         : &mOwner->roadLayer1()->cellAt(subPos);
                 if (!cell->isEmpty()) {
                     if (!cleared) {
-                        bool isFloor = !mLevel && !index && (tl->name() == sFloor);
-                        if (isFloor) root->mKeepFloorLayerCount = 0;
-                        cells.resize(root->mKeepFloorLayerCount);
+                        if (roles & RoleFloor) keepFloorLayerCount = 0;
+                        cells.resize(keepFloorLayerCount);
                         cleared = true;
                     }
                     cells.append(cell);
-                    if (mMaxFloorLayer >= index)
-                        mOwner->mKeepFloorLayerCount = cells.size();
+                    if (isRoot && mMaxFloorLayer >= index)
+                        keepFloorLayerCount = cells.size();
                     continue;
                 }
             }
@@ -381,20 +421,19 @@ bool CompositeLayerGroup::orderedCellsAt2(const QPoint &pos, QVector<const Cell
                 cell = &tlBlendOver->cellAt(subPos);
             }
 #endif // BUILDINGED
-            if (!cell->isEmpty() && (root == mOwner) && tl->name().contains(sAboveLot)) {
+            if (!cell->isEmpty() && isRoot && (roles & RoleAboveLot)) {
                 aboveLotCells += cell;
                 continue;
             }
             if (!cell->isEmpty()) {
                 if (!cleared) {
-                    bool isFloor = !mLevel && !index && (tl->name() == sFloor);
-                    if (isFloor) root->mKeepFloorLayerCount = 0;
-                    cells.resize(root->mKeepFloorLayerCount);
+                    if (roles & RoleFloor) keepFloorLayerCount = 0;
+                    cells.resize(keepFloorLayerCount);
                     cleared = true;
                 }
                 cells.append(cell);
-                if (mMaxFloorLayer >= index)
-                    mOwner->mKeepFloorLayerCount = cells.size();
+                if (isRoot && mMaxFloorLayer >= index)
+                    keepFloorLayerCount = cells.size();
             }
         }
     }
@@ -403,7 +442,8 @@ bool CompositeLayerGroup::orderedCellsAt2(const QPoint &pos, QVector<const Cell
     for (const SubMapLayers& subMapLayer : mPreparedSubMapLayers) {
         if (!subMapLayer.mBounds.contains(pos))
             continue;
-        subMapLayer.mLayerGroup->orderedCellsAt2(pos - subMapLayer.mSubMap->origin(), cells);
+        subMapLayer.mLayerGroup->orderedCellsAt2(pos - subMapLayer.mSubMap->origin(), cells,
+                                                 keepFloorLayerCount);
     }
 
     cells += aboveLotCells;
@@ -411,6 +451,51 @@ bool CompositeLayerGroup::orderedCellsAt2(const QPoint &pos, QVector<const Cell
     return !cells.isEmpty();
 }
 
+/**
+ * Sets the bit in \a mask for each position in \a bounds where
+ * orderedCellsAt2() may return cells.  The bits are in row order.  Callers
+ * scanning a whole map can skip every other position, which is most of them.
+ * Call prepareDrawing2() first.
+ */
+void CompositeLayerGroup::nonEmptyCells2(const QRect &bounds, QBitArray &mask) const
+{
+    mask.fill(false, bounds.width() * bounds.height());
+    markNonEmptyCells2(bounds, QPoint(), mask);
+}
+
+void CompositeLayerGroup::markNonEmptyCells2(const QRect &bounds, const QPoint &offset,
+                                             QBitArray &mask) const
+{
+    // orderedCellsAt2() looks up pos - offset - orientAdjustTiles() * mLevel.
+    const QPoint delta = offset + mOwner->orientAdjustTiles() * mLevel;
+    const QRect localBounds = bounds.translated(-delta);
+    auto mark = [&](int x, int y, const Cell &) {
+        const QPoint pos = QPoint(x, y) + delta - bounds.topLeft();
+        mask.setBit(pos.y() * bounds.width() + pos.x());
+    };
+
+    for (int index = 0; index < mLayers.size(); index++) {
+        mLayers[index]->forEachNonEmptyCell(localBounds, mark);
+        if (const TileLayer *tlBmpBlend = mBmpBlendLayers[index])
+            tlBmpBlend->forEachNonEmptyCell(localBounds, mark);
+#ifdef BUILDINGED
+        if (const TileLayer *tlBlendOver = mBlendOverLayers[index])
+            tlBlendOver->forEachNonEmptyCell(localBounds, mark);
+#endif // BUILDINGED
+#if WORLDED // ROAD_CRUD
+        if (mLayers[index] == mRoadLayer0)
+            mOwner->roadLayer0()->forEachNonEmptyCell(localBounds, mark);
+        else if (mLayers[index] == mRoadLayer1)
+            mOwner->roadLayer1()->forEachNonEmptyCell(localBounds, mark);
+#endif // ROAD_CRUD
+    }
+
+    for (const SubMapLayers& subMapLayer : mPreparedSubMapLayers) {
+        subMapLayer.mLayerGroup->markNonEmptyCells2(bounds, offset + subMapLayer.mSubMap->origin(),
+                                                    mask);
+    }
+}
+
 bool CompositeLayerGroup::isLayerEmpty(int index) const
 {
     if (!mVisibleLayers[index])
@@ -577,6 +662,8 @@ void CompositeLayerGroup::synch()
     mSubMapTileBounds = r;
     mDrawMargins = m;
 
+    updateLayerRoles();
+
     mNeedsSynch = false;
 }
 
@@ -1462,6 +1549,22 @@ bool MapComposite::waitingForMapsToLoad() const
     return false;
 }
 
+QList<MapInfo*> MapComposite::mapsLoading() const
+{
+    QList<MapInfo*> mapInfos;
+    foreach (const SubMapLoading &sml, mSubMapsLoading) {
+        if (!mapInfos.contains(sml.mapInfo))
+            mapInfos += sml.mapInfo;
+    }
+    foreach (MapComposite *mc, mSubMaps) {
+        foreach (MapInfo *mapInfo, mc->mapsLoading()) {
+            if (!mapInfos.contains(mapInfo))
+                mapInfos += mapInfo;
+        }
+    }
+    return mapInfos;
+}
+
 void MapComposite::recreate()
 {
     qDeleteAll(mSubMaps);
@@ -1657,5 +1760,6 @@ void MapComposite::setSuppressRegion(const QRegion &rgn, int level)
 {
     mSuppressRgn = rgn;
     mSuppressLevel = level;
+    mSuppressBits.setRegion(rgn);
 }
 
@@ -23,6 +23,7 @@
 #ifdef BUILDINGED
 #include "tilelayer.h" // for Cell
 #endif
+#include "regionbitmap.h"
 #include "ztilelayergroup.h"
 
 #include <QObject>
@@ -61,6 +62,7 @@ public:
 
     void prepareDrawing2();
     bool orderedCellsAt2(const QPoint &pos, QVector<const Tiled::Cell*>& cells) const;
+    void nonEmptyCells2(const QRect &bounds, QBitArray &mask) const;
 
     bool setLayerVisibility(const QString &layerName, bool visible);
     bool setLayerVisibility(Tiled::TileLayer *tl, bool visible);
@@ -79,6 +81,17 @@ public:
     bool needsSynch() const { return mNeedsSynch; }
     bool isLayerEmpty(int index) const;
     void synch();
+    void updateLayerRoles();
+
+private:
+    bool orderedCellsAt(const QPoint &pos, QVector<const Tiled::Cell*>& cells,
+                        QVector<qreal> &opacities, int &keepFloorLayerCount) const;
+    bool orderedCellsAt2(const QPoint &pos, QVector<const Tiled::Cell*>& cells,
+                         int &keepFloorLayerCount) const;
+    void markNonEmptyCells2(const QRect &bounds, const QPoint &offset,
+                            QBitArray &mask) const;
+
+public:
 
     void saveVisibility();
     void restoreVisibility();
@@ -134,6 +147,9 @@ private:
     QVector<bool> mEmptyLayers;
     QVector<qreal> mLayerOpacity;
     int mMaxFloorLayer;
+
+    QVector<quint8> mLayerRoles; // ZTileLayerGroup::LayerRole bits
+
     QMap<QString,QVector<Tiled::Layer*> > mLayersByName;
     QVector<bool> mSavedVisibleLayers;
     QVector<qreal> mSavedOpacity;
@@ -325,11 +341,19 @@ public:
 
     bool waitingForMapsToLoad() const;
 
+    /**
+     * The maps of lots that are still being read in the background, in this
+     * map and its sub-maps.
+     */
+    QList<MapInfo*> mapsLoading() const;
+
     void setSuppressRegion(const QRegion &rgn, int level);
     QRegion suppressRegion() const
     { return mSuppressRgn; }
     int suppressLevel() const
     { return mSuppressLevel; }
+    bool isSuppressed(const QPoint &rootPos) const
+    { return mSuppressBits.contains(rootPos); }
 signals:
     void layerGroupAdded(int level);
     void layerAddedToGroup(int index);
@@ -396,6 +420,7 @@ private:
 
     QRegion mSuppressRgn;
     int mSuppressLevel;
+    Tiled::RegionBitmap mSuppressBits;
 
 #if 1 // ROAD_CRUD
     Tiled::TileLayer *mRoadLayer1;
@@ -405,7 +430,6 @@ private:
 public:
     MapComposite *root();
     MapComposite *rootOrAdjacent();
-    int mKeepFloorLayerCount;
 
     QString mNoBlendLayer;
 };
@@ -58,6 +58,7 @@
 #include "tileset.h"
 #include "tmxmapwriter.h"
 
+#include <QCoreApplication>
 #include <QFileInfo>
 #include <QRect>
 #include <QUndoStack>
@@ -149,6 +150,19 @@ MapDocument::MapDocument(Map *map, const QString &fileName):
             this, &MapDocument::layerRemovedFromGroup);
     connect(mMapComposite, &MapComposite::layerLevelChanged,
             this, &MapDocument::layerLevelChanged);
+
+    connect(this, &MapDocument::regionAltered, this, &MapDocument::lotExportRegionAltered);
+    connect(this, &MapDocument::bmpPainted, this, &MapDocument::lotExportBmpPainted);
+    connect(this, &MapDocument::mapChanged, this, &MapDocument::lotExportInvalidate);
+    connect(this, &MapDocument::layerAdded, this, &MapDocument::lotExportInvalidate);
+    connect(this, &MapDocument::layerRemoved, this, &MapDocument::lotExportInvalidate);
+    connect(this, &MapDocument::layerRenamed, this, &MapDocument::lotExportInvalidate);
+    connect(this, &MapDocument::layerLevelChanged, this, &MapDocument::lotExportInvalidate);
+    connect(this, &MapDocument::bmpAliasesChanged, this, &MapDocument::lotExportInvalidate);
+    connect(this, &MapDocument::bmpRulesChanged, this, &MapDocument::lotExportInvalidate);
+    connect(this, &MapDocument::bmpBlendsChanged, this, &MapDocument::lotExportInvalidate);
+    connect(this, &MapDocument::bmpBlendEdgesEverywhereChanged, this, &MapDocument::lotExportInvalidate);
+    connect(this, &MapDocument::noBlendPainted, this, &MapDocument::lotExportInvalidate);
 #endif
 
 #ifdef ZOMBOID
@@ -800,6 +814,54 @@ void MapDocument::emitRegionAltered(const QRegion &region, Layer *layer)
     emit regionAltered(region, layer);
 }
 
+bool MapDocument::lotExportDirtyRegion(const QString &fileName, QRegion &region) const
+{
+    if (mLotExportFileName.isEmpty() || mLotExportFileName != fileName)
+        return false;
+    region = mLotExportDirtyRegion;
+    return true;
+}
+
+void MapDocument::setLotExported(const QString &fileName)
+{
+    mLotExportFileName = fileName;
+    mLotExportDirtyRegion = QRegion();
+}
+
+// Blend tiles depend on their neighbours, so grow each edit a little.
+static QRegion lotExportRegion(const QRegion &region, const QPoint &offset)
+{
+    QRegion result;
+    for (const QRect &r : region)
+        result += r.translated(offset).adjusted(-2, -2, 2, 2);
+    return result;
+}
+
+void MapDocument::lotExportRegionAltered(const QRegion &region, Layer *layer)
+{
+    if (mLotExportFileName.isEmpty())
+        return;
+    // NewMapBinaryFile shifts isometric levels 3 squares per level.
+    int level = 0;
+    if (mMap->orientation() == Map::Isometric)
+        MapComposite::levelForLayer(layer, &level);
+    mLotExportDirtyRegion += lotExportRegion(region, QPoint(level * 3, level * 3));
+}
+
+void MapDocument::lotExportBmpPainted(int bmpIndex, const QRegion &region)
+{
+    Q_UNUSED(bmpIndex)
+    if (mLotExportFileName.isEmpty())
+        return;
+    mLotExportDirtyRegion += lotExportRegion(region, QPoint());
+}
+
+void MapDocument::lotExportInvalidate()
+{
+    mLotExportFileName.clear();
+    mLotExportDirtyRegion = QRegion();
+}
+
 void MapDocument::setTileLayerName(Tile *tile, const QString &name)
 {
     TilesetManager::instance()->setLayerName(tile, name);
@@ -297,6 +297,15 @@ public:
     void setTileLayerName(Tile *tile, const QString &name);
 
     void setBlendEdgesEverywhere(bool enabled);
+
+    /**
+     * Returns in \a region the part of the map edited since it was last
+     * exported to \a fileName by NewMapBinaryFile, in .pzby coordinates.
+     * Returns false if that isn't known, for example because layers were
+     * added or removed since.
+     */
+    bool lotExportDirtyRegion(const QString &fileName, QRegion &region) const;
+    void setLotExported(const QString &fileName);
 #endif
 
     /**
@@ -435,6 +444,10 @@ private slots:
     void afterWorldChanged(const QString &fileName);
 
     void initAdjacentMaps();
+
+    void lotExportRegionAltered(const QRegion &region, Tiled::Layer *layer);
+    void lotExportBmpPainted(int bmpIndex, const QRegion &region);
+    void lotExportInvalidate();
 #endif
 
 private:
@@ -478,6 +491,9 @@ private:
     QMultiMap<MapInfo*,LoadingSubMap> mAdjacentSubMapsLoading;
 
     QList<MapInfo*> mMapsLoaded;
+
+    QString mLotExportFileName;
+    QRegion mLotExportDirtyRegion;
 #endif // ZOMBOID
     QUndoStack *mUndoStack;
 };
@@ -17,6 +17,7 @@
 
 #include "mapimagemanager.h"
 
+#include "alphaflatten.h"
 #include "bmpblender.h"
 #include "imagelayer.h"
 #include "isometricrenderer.h"
@@ -37,10 +38,12 @@
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QImageReader>
 #include <QMessageBox>
 #include <QPainterPath>
+#include <QThread>
 
 #ifdef QT_NO_DEBUG
 inline QNoDebug noise() { return QNoDebug(); }
@@ -54,40 +57,19 @@ using namespace Tiled::Internal;
 const int IMAGE_WIDTH = 512;
 
 MapImageManager *MapImageManager::mInstance = NULL;
+int MapImageManager::mRenderThreadCount = 0;
 
 MapImageManager::MapImageManager() :
     QObject(),
-    mExpectMapImage(0),
-    mRenderMapComposite(0),
     mDeferralDepth(0),
     mDeferralQueued(false)
 {
-    mImageReaderThreads.resize(4);
-    mImageReaderWorkers.resize(mImageReaderThreads.size());
-    mNextThreadForJob = 0;
-    for (int i = 0; i < mImageReaderWorkers.size(); i++) {
-        mImageReaderThreads[i] = new InterruptibleThread;
-        mImageReaderWorkers[i] = new MapImageReaderWorker(mImageReaderThreads[i]);
-        mImageReaderWorkers[i]->moveToThread(mImageReaderThreads[i]);
-        connect(mImageReaderWorkers[i], &MapImageReaderWorker::imageLoaded,
-                this, &MapImageManager::imageLoadedByThread);
-        mImageReaderThreads[i]->start();
-    }
-
-    mImageRenderThread = new InterruptibleThread;
-    mImageRenderWorker = new MapImageRenderWorker(mImageRenderThread);
-    mImageRenderWorker->moveToThread(mImageRenderThread);
-    connect(mImageRenderWorker, &MapImageRenderWorker::mapNeeded,
-            this, &MapImageManager::renderThreadNeedsMap);
-    qRegisterMetaType<MapImageData>("MapImageData");
-    qRegisterMetaType<MapImage*>("MapImage*");
-    qRegisterMetaType<MapComposite*>("MapComposite*");
-    connect(mImageRenderWorker,
-            &MapImageRenderWorker::imageRendered,
-            this, &MapImageManager::imageRenderedByThread);
-    connect(mImageRenderWorker, &MapImageRenderWorker::jobDone,
-            this, &MapImageManager::renderJobDone);
-    mImageRenderThread->start();
+    // Each render slot renders one map at a time, and splits each image
+    // into bands that are drawn in parallel.
+    if (mRenderThreadCount > 0)
+        mRenderSlots.resize(mRenderThreadCount);
+    else
+        mRenderSlots.resize(qBound(1, QThread::idealThreadCount() / 2, 4));
 
     connect(MapManager::instance(), &MapManager::mapAboutToChange,
             this, &MapImageManager::mapAboutToChange);
@@ -103,19 +85,14 @@ MapImageManager::MapImageManager() :
 
 MapImageManager::~MapImageManager()
 {
-    for (int i = 0; i < mImageReaderThreads.size(); i++) {
-        mImageReaderThreads[i]->interrupt();
-        mImageReaderThreads[i]->quit();
-        mImageReaderThreads[i]->wait();
-        delete mImageReaderWorkers[i];
-        delete mImageReaderThreads[i];
-    }
+    mImageReaderToken.cancel();
+    JobScheduler::instance()->wait(mImageReaderToken);
 
-    mImageRenderThread->interrupt();
-    mImageRenderThread->quit();
-    mImageRenderThread->wait();
-    delete mImageRenderWorker;
-    delete mImageRenderThread;
+    for (RenderSlot &slot : mRenderSlots) {
+        slot.token.cancel();
+        slot.job.wait();
+        delete slot.mapComposite;
+    }
 }
 
 MapImageManager *MapImageManager::instance()
@@ -131,6 +108,12 @@ void MapImageManager::deleteInstance()
     mInstance = 0;
 }
 
+void MapImageManager::setRenderThreadCount(int count)
+{
+    Q_ASSERT(!mInstance);
+    mRenderThreadCount = count;
+}
+
 MapImage *MapImageManager::getMapImage(const QString &mapName, const QString &relativeTo)
 {
     // Do not emit mapImageChanged as a result of worker threads finishing
@@ -184,17 +167,10 @@ MapImage *MapImageManager::getMapImage(const QString &mapName, const QString &re
     if (data.threadLoad || data.threadRender) {
         if (data.threadLoad) {
             QString imageFileName = imageFileInfo(mapFilePath).canonicalFilePath();
-            QMetaObject::invokeMethod(mImageReaderWorkers[mNextThreadForJob],
-                                      "addJob", Qt::QueuedConnection,
-                                      Q_ARG(QString,imageFileName),
-                                      Q_ARG(MapImage*,mapImage));
-            mNextThreadForJob = (mNextThreadForJob + 1) % mImageReaderWorkers.size();
-        }
-        if (data.threadRender) {
-            QMetaObject::invokeMethod(mImageRenderWorker,
-                                      "addJob", Qt::QueuedConnection,
-                                      Q_ARG(MapImage*,mapImage));
+            readImageInBackground(imageFileName, mapImage);
         }
+        if (data.threadRender)
+            addRenderJob(mapImage);
     }
 
     // Set up file modification tracking on each TMX that makes
@@ -228,8 +204,7 @@ MapImageManager::ImageData MapImageManager::generateMapImage(const QString &mapF
     if (!force && imageInfo.exists() && imageDataInfo.exists() && (fileInfo.lastModified() < imageInfo.lastModified())) {
         QImageReader reader(imageInfo.absoluteFilePath());
         if (!reader.size().isValid())
-            QMessageBox::warning(MainWindow::instance(), tr("Error Loading Image"),
-                                 tr("An error occurred trying to read a map thumbnail image.\n") + imageInfo.absoluteFilePath());
+            imageReadError(tr("An error occurred trying to read a map thumbnail image.\n") + imageInfo.absoluteFilePath());
         if (reader.size().width() == IMAGE_WIDTH) {
             ImageData data = readImageData(imageDataInfo);
             // If the image was originally created with some tilesets missing,
@@ -348,9 +323,8 @@ MapImageManager::ImageData MapImageManager::generateBMPImage(const QString &bmpF
             (fileInfo.lastModified() < imageInfo.lastModified())) {
         QImage image(imageInfo.absoluteFilePath());
         if (image.isNull())
-            QMessageBox::warning(MainWindow::instance(), tr("Error Loading Image"),
-                                 tr("An error occurred trying to read a BMP thumbnail image.\n")
-                                 + imageInfo.absoluteFilePath());
+            imageReadError(tr("An error occurred trying to read a BMP thumbnail image.\n")
+                           + imageInfo.absoluteFilePath());
         if (image.size() == skewedImageBounds.size()) {
             ImageData data = readImageData(imageDataInfo);
             if (data.valid) {
@@ -481,34 +455,33 @@ void MapImageManager::writeImageData(const QFileInfo &imageDataFileInfo, const M
 
 void MapImageManager::mapAboutToChange(MapInfo *mapInfo)
 {
-    if (!mRenderMapComposite)
-        return;
-    // Caution: mRenderMapComposite is being used right now by the render thread.
-    foreach (MapComposite *mc, mRenderMapComposite->maps()) {
-        if (mc->mapInfo() == mapInfo) {
-            mImageRenderThread->interrupt(true);
-            MapImage *mapImage = mMapImages[mRenderMapComposite->mapInfo()->path()];
-            Q_ASSERT(mapImage);
-            mapImage->mLoaded = false;
-            break;
+    for (RenderSlot &slot : mRenderSlots) {
+        if (!slot.mapComposite)
+            continue;
+        // Caution: slot.mapComposite may be being drawn right now.
+        foreach (MapComposite *mc, slot.mapComposite->maps()) {
+            if (mc->mapInfo() == mapInfo) {
+                slot.token.cancel();
+                slot.job.wait();
+                slot.mapImage->mLoaded = false;
+                break;
+            }
         }
     }
 }
 
 void MapImageManager::mapChanged(MapInfo *mapInfo)
 {
-    if (!mRenderMapComposite)
-        return;
-    // Caution: mRenderMapComposite is being used right now by the render thread.
-    foreach (MapComposite *mc, mRenderMapComposite->maps()) {
-        if (mc->mapInfo() == mapInfo) {
-            MapImage *mapImage = mMapImages[mRenderMapComposite->mapInfo()->path()];
-            Q_ASSERT(mapImage);
-            mImageRenderThread->resume();
-            QMetaObject::invokeMethod(mImageRenderWorker,
-                                      "resume", Qt::QueuedConnection,
-                                      Q_ARG(MapImage*,mapImage));
-            break;
+    for (RenderSlot &slot : mRenderSlots) {
+        if (!slot.mapComposite)
+            continue;
+        foreach (MapComposite *mc, slot.mapComposite->maps()) {
+            if (mc->mapInfo() == mapInfo) {
+                // The cancelled job is done with the composite, render the
+                // image again once it has been cleaned up.
+                mRenderQueue.prepend(slot.mapImage);
+                break;
+            }
         }
     }
 }
@@ -534,20 +507,34 @@ void MapImageManager::mapFileChanged(MapInfo *mapInfo)
                 mapImage->mSources.clear();
                 mapImage->mSources += mapImage->mapInfo();
                 mapImage->mLoaded = false;
-                QMetaObject::invokeMethod(mImageRenderWorker,
-                                          "addJob", Qt::QueuedConnection,
-                                          Q_ARG(MapImage*,mapImage));
+                addRenderJob(mapImage);
                 emit mapImageChanged(mapImage);
             }
         }
     }
 }
 
-void MapImageManager::imageLoadedByThread(QImage *image, MapImage *mapImage)
+void MapImageManager::readImageInBackground(const QString &imageFileName, MapImage *mapImage)
+{
+    QSharedPointer<QImage> image(new QImage);
+    auto work = [imageFileName, image]() {
+        image->load(imageFileName);
+#ifdef WORLDED
+        if (!image->isNull())
+            *image = image->convertToFormat(QImage::Format_ARGB4444_Premultiplied);
+#endif // WORLDED
+    };
+    auto done = [this, image, mapImage]() {
+        imageLoadedByThread(*image, mapImage);
+    };
+    JobScheduler::instance()->schedule(work, JobScheduler::PriorityLow,
+                                       mImageReaderToken, this, done);
+}
+
+void MapImageManager::imageLoadedByThread(const QImage &image, MapImage *mapImage)
 {
-    mapImage->setImage(*image);
+    mapImage->setImage(image);
     mapImage->mLoaded = true;
-    delete image;
 
     if (mDeferralDepth > 0)
         mDeferredMapImages += mapImage;
@@ -555,31 +542,30 @@ void MapImageManager::imageLoadedByThread(QImage *image, MapImage *mapImage)
         emit mapImageChanged(mapImage);
 }
 
-void MapImageManager::renderThreadNeedsMap(MapImage *mapImage)
+void MapImageManager::renderSlotNeedsMap(int index, MapImage *mapImage)
 {
+    RenderSlot &slot = mRenderSlots[index];
     bool asynch = true;
-    Q_ASSERT(mExpectMapImage == 0);
+    Q_ASSERT(slot.isIdle());
     MapInfo *mapInfo = MapManager::instance()->loadMap(mapImage->mapInfo()->path(),
                                                        QString(), asynch,
                                                        MapManager::PriorityLow);
     if (!mapInfo) {
         // The map file went away since MapImage's MapInfo was created.
-        QMetaObject::invokeMethod(mImageRenderWorker,
-                                  "mapFailedToLoad", Qt::QueuedConnection);
         emit mapImageFailedToLoad(mapImage);
         return;
     }
-    mExpectMapImage = mapImage;
-    mExpectSubMaps.clear();
+    slot.expectMapImage = mapImage;
+    slot.expectSubMaps.clear();
 #ifdef WORLDED
-    mReferencedMaps.clear();
+    slot.referencedMaps.clear();
 #endif
     Q_ASSERT(mapInfo == mapImage->mapInfo());
     if (!mapInfo->isLoading())
-        mapLoaded(mapInfo);
+        renderSlotMapLoaded(index, mapInfo);
 }
 
-void MapImageManager::imageRenderedByThread(MapImageData imgData, MapImage *mapImage)
+void MapImageManager::imageRenderedByThread(const MapImageData &imgData, MapImage *mapImage)
 {
     noise() << "imageRenderedByThread" << mapImage->mapInfo()->path();
 
@@ -613,11 +599,34 @@ void MapImageManager::imageRenderedByThread(MapImageData imgData, MapImage *mapI
         emit mapImageChanged(mapImage);
 }
 
-void MapImageManager::renderJobDone(MapComposite *mapComposite)
+void MapImageManager::renderJobDone(int index, const MapImageData &data)
+{
+    RenderSlot &slot = mRenderSlots[index];
+    MapImage *mapImage = slot.mapImage;
+    delete slot.mapComposite;
+    slot.mapComposite = 0;
+    slot.mapImage = 0;
+    slot.job = JobHandle();
+
+    if (data.valid())
+        imageRenderedByThread(data, mapImage);
+
+    startRenderJobs();
+}
+
+void MapImageManager::addRenderJob(MapImage *mapImage)
 {
-    Q_ASSERT(mapComposite == mRenderMapComposite);
-    mRenderMapComposite = 0;
-    delete mapComposite;
+    mRenderQueue += mapImage;
+    startRenderJobs();
+}
+
+void MapImageManager::startRenderJobs()
+{
+    for (int i = 0; i < mRenderSlots.size(); i++) {
+        // The slot stays idle if the map can't be loaded.
+        while (mRenderSlots[i].isIdle() && !mRenderQueue.isEmpty())
+            renderSlotNeedsMap(i, mRenderQueue.takeFirst());
+    }
 }
 
 #include "mapobject.h"
@@ -639,112 +648,165 @@ QStringList getSubMapFileNames(const MapInfo *mapInfo)
 
 void MapImageManager::mapLoaded(MapInfo *mapInfo)
 {
-    if (!mExpectMapImage)
+    for (int i = 0; i < mRenderSlots.size(); i++)
+        renderSlotMapLoaded(i, mapInfo);
+}
+
+void MapImageManager::renderSlotMapLoaded(int index, MapInfo *mapInfo)
+{
+    RenderSlot &rt = mRenderSlots[index];
+    if (!rt.expectMapImage)
         return;
 
-    if (mExpectMapImage->mapInfo() == mapInfo) {
+    if (rt.expectMapImage->mapInfo() == mapInfo) {
 #ifdef WORLDED
-        MapManager::instance()->addReferenceToMap(mapInfo), mReferencedMaps += mapInfo;
+        MapManager::instance()->addReferenceToMap(mapInfo), rt.referencedMaps += mapInfo;
 #endif
         foreach (const QString &path, getSubMapFileNames(mapInfo)) {
             bool async = true;
             if (MapInfo *subMapInfo = MapManager::instance()->loadMap(path, QString(), async,
                                                                       MapManager::PriorityLow)) {
-                if (!mExpectSubMaps.contains(subMapInfo)) {
+                if (!rt.expectSubMaps.contains(subMapInfo)) {
                     if (subMapInfo->isLoading())
-                        mExpectSubMaps += subMapInfo;
+                        rt.expectSubMaps += subMapInfo;
 #ifdef WORLDED
                     else
-                        MapManager::instance()->addReferenceToMap(subMapInfo), mReferencedMaps += subMapInfo;
+                        MapManager::instance()->addReferenceToMap(subMapInfo), rt.referencedMaps += subMapInfo;
 #endif
                 }
             }
         }
-    } else if (mExpectSubMaps.contains(mapInfo)) {
+    } else if (rt.expectSubMaps.contains(mapInfo)) {
 #ifdef WORLDED
-        MapManager::instance()->addReferenceToMap(mapInfo), mReferencedMaps += mapInfo;
+        MapManager::instance()->addReferenceToMap(mapInfo), rt.referencedMaps += mapInfo;
 #endif
-        mExpectSubMaps.removeAll(mapInfo);
+        rt.expectSubMaps.removeAll(mapInfo);
         foreach (const QString &path, getSubMapFileNames(mapInfo)) {
             bool async = true;
             if (MapInfo *subMapInfo = MapManager::instance()->loadMap(
                         path, QString(), async, MapManager::PriorityLow)) {
-                if (!mExpectSubMaps.contains(subMapInfo)) {
+                if (!rt.expectSubMaps.contains(subMapInfo)) {
                     if (subMapInfo->isLoading())
-                        mExpectSubMaps += subMapInfo;
+                        rt.expectSubMaps += subMapInfo;
 #ifdef WORLDED
                     else
-                        MapManager::instance()->addReferenceToMap(subMapInfo), mReferencedMaps += subMapInfo;
+                        MapManager::instance()->addReferenceToMap(subMapInfo), rt.referencedMaps += subMapInfo;
 #endif
                 }
             }
         }
-        mapInfo = mExpectMapImage->mapInfo();
+        mapInfo = rt.expectMapImage->mapInfo();
     } else {
         return;
     }
 
-    if (mExpectSubMaps.size())
+    if (rt.expectSubMaps.size())
         return;
 
-    mExpectMapImage = 0;
+    rt.mapImage = rt.expectMapImage;
+    rt.expectMapImage = 0;
 
-    mRenderMapComposite = new MapComposite(mapInfo);
-    Q_ASSERT(mRenderMapComposite->waitingForMapsToLoad() == false);
+    // mapAboutToChange() cancels this render through the slot's token, even
+    // before the job is scheduled.
+    rt.token = JobToken();
+    rt.mapComposite = new MapComposite(mapInfo);
+    Q_ASSERT(rt.mapComposite->waitingForMapsToLoad() == false);
 #ifdef WORLDED
     // Now that mapComposite is referencing the maps...
-    foreach (MapInfo *mapInfo, mReferencedMaps)
+    foreach (MapInfo *mapInfo, rt.referencedMaps)
         MapManager::instance()->removeReferenceToMap(mapInfo);
 #endif
-    // Wait for TilesetManager's threads to finish loading the tilesets.
+    // Wait for TilesetManager's jobs to finish loading the tilesets.
     // FIXME: this shouldn't block the gui.
-#if 1
-    QList<Tileset*> usedTilesets = mRenderMapComposite->usedTilesets();
+    QList<Tileset*> usedTilesets = rt.mapComposite->usedTilesets();
     usedTilesets.removeAll(TilesetManager::instance()->missingTileset());
     TilesetManager::instance()->waitForTilesets(usedTilesets);
-#else
-    QSet<Tileset*> usedTilesets;
-    foreach (MapComposite *mc, mRenderMapComposite->maps())
-        usedTilesets += mc->map()->usedTilesets();
-    usedTilesets.remove(TilesetManager::instance()->missingTileset());
-    TilesetManager::instance()->waitForTilesets(usedTilesets.toList());
-#endif
 
-    // BmpBlender sends a signal to the MapComposite when it has finished
-    // blending.  That needs to happen in the render thread.
-    Q_ASSERT(mRenderMapComposite->bmpBlender()->parent() == mRenderMapComposite);
-    mRenderMapComposite->moveToThread(mImageRenderThread);
+    // Everything that changes the MapComposite or its BmpBlenders, which
+    // emit signals, is done here.  The render job only reads them.
+    foreach (CompositeLayerGroup *layerGroup, rt.mapComposite->sortedLayerGroups()) {
+        foreach (TileLayer *tl, layerGroup->layers()) {
+            bool isVisible = true;
+            if (tl->name().contains(QLatin1String("NoRender")))
+                isVisible = false;
+            layerGroup->setLayerVisibility(tl, isVisible);
+            layerGroup->setLayerOpacity(tl, 1.0f);
+        }
+        layerGroup->synch();
+    }
+    foreach (MapComposite *mc, rt.mapComposite->maps())
+        if (mc->bmpBlender())
+            mc->bmpBlender()->flush(QRect(0, 0, mc->map()->width() - 1, mc->map()->height() - 1));
 
-    QMetaObject::invokeMethod(mImageRenderWorker,
-                              "mapLoaded", Qt::QueuedConnection,
-                              Q_ARG(MapComposite*,mRenderMapComposite));
+    startRender(index);
+}
+
+void MapImageManager::startRender(int index)
+{
+    RenderSlot &slot = mRenderSlots[index];
+    if (slot.token.isCancelled()) {
+        renderJobDone(index, MapImageData());
+        return;
+    }
+
+    MapComposite *mapComposite = slot.mapComposite;
+    JobToken token = slot.token;
+    QSharedPointer<MapImageData> data(new MapImageData);
+    auto work = [mapComposite, token, data]() {
+        noise() << "MapImageManager render started" << mapComposite->mapInfo()->path();
+        QElapsedTimer timer;
+        timer.start();
+        *data = renderMapImage(mapComposite, token);
+        noise() << "MapImageManager render" << (token.isCancelled() ? "aborted" : "finished")
+                << mapComposite->mapInfo()->path() << "in" << timer.elapsed() << "ms";
+    };
+    auto done = [this, index, data]() {
+        renderJobDone(index, *data);
+    };
+    slot.job = JobScheduler::instance()->schedule(work, JobScheduler::PriorityLow,
+                                                  token, this, done);
 }
 
 void MapImageManager::mapFailedToLoad(MapInfo *mapInfo)
 {
+    for (int i = 0; i < mRenderSlots.size(); i++)
+        renderSlotMapFailedToLoad(i, mapInfo);
+}
+
+void MapImageManager::renderSlotMapFailedToLoad(int index, MapInfo *mapInfo)
+{
+    RenderSlot &rt = mRenderSlots[index];
     // Failing to load a submap of the one we want to paint doesn't stop us
     // creating the map image.
-    if (mExpectSubMaps.contains(mapInfo))
-        mExpectSubMaps.removeAll(mapInfo);
+    if (rt.expectSubMaps.contains(mapInfo))
+        rt.expectSubMaps.removeAll(mapInfo);
 
-    // The render thread was waiting for a map to load, but that failed.
-    // Tell the render thread to continue on with the next job.
-    if (mExpectMapImage && (mapInfo == mExpectMapImage->mapInfo())) {
+    // The render slot was waiting for a map to load, but that failed.
+    // Continue on with the next job.
+    if (rt.expectMapImage && (mapInfo == rt.expectMapImage->mapInfo())) {
 #ifdef WORLDED
-        foreach (MapInfo *mapInfo, mReferencedMaps)
+        foreach (MapInfo *mapInfo, rt.referencedMaps)
             MapManager::instance()->removeReferenceToMap(mapInfo);
-        mReferencedMaps.clear();
+        rt.referencedMaps.clear();
 #endif
-        MapImage *mapImage = mExpectMapImage;
+        MapImage *mapImage = rt.expectMapImage;
         mapImage->mImage.fill(Qt::transparent);
         mapImage->mLoaded = true; // FIXME: delete bogus MapImage???
-        mExpectMapImage = 0;
-        QMetaObject::invokeMethod(mImageRenderWorker,
-                                  "mapFailedToLoad", Qt::QueuedConnection);
+        rt.expectMapImage = 0;
         emit mapImageFailedToLoad(mapImage);
+        startRenderJobs();
     }
 }
 
+// A broken thumbnail is regenerated, so in batch mode a warning will do.
+void MapImageManager::imageReadError(const QString &message)
+{
+    if (MainWindow::instance())
+        QMessageBox::warning(MainWindow::instance(), tr("Error Loading Image"), message);
+    else
+        qWarning().noquote() << message;
+}
+
 QFileInfo MapImageManager::imageFileInfo(const QString &mapFilePath)
 {
     QString thumbnailsDirectory = Preferences::instance()->thumbnailsDirectory();
@@ -923,139 +985,55 @@ void MapImage::chopIntoPieces()
 
 /////
 
-MapImageReaderWorker::MapImageReaderWorker(InterruptibleThread *thread) :
-    BaseWorker(thread)
-{
-}
-
-MapImageReaderWorker::~MapImageReaderWorker()
-{
-}
-
-void MapImageReaderWorker::work()
-{
-    IN_WORKER_THREAD
-
-    while (mJobs.size()) {
-
-        if (aborted()) {
-            mJobs.clear();
-            return;
-        }
-
-        Job job = mJobs.takeAt(0);
-
-        QImage *image = new QImage(job.imageFileName);
-#ifdef WORLDED
-        if (!image->isNull())
-            *image = image->convertToFormat(QImage::Format_ARGB4444_Premultiplied);
-#endif // WORLDED
-
-#ifndef QT_NO_DEBUG
-        Sleep::msleep(250);
-#endif
-        emit imageLoaded(image, job.mapImage);
-    }
-}
-
-void MapImageReaderWorker::addJob(const QString &imageFileName, MapImage *mapImage)
-{
-    IN_WORKER_THREAD
-
-    mJobs += Job(imageFileName, mapImage);
-    scheduleWork();
-}
-
-/////
-
-MapImageRenderWorker::MapImageRenderWorker(InterruptibleThread *thread) :
-    BaseWorker(thread)
-{
-}
-
-MapImageRenderWorker::~MapImageRenderWorker()
-{
-}
-
-void MapImageRenderWorker::work()
-{
-    IN_WORKER_THREAD
-
-    while (mJobs.size()) {
-        if (aborted()) {
-            return;
-        }
-
-        if (!mJobs.at(0).mapComposite) {
-            preventWork(); // until mapLoaded() or mapFailedToLoad()
-            emit mapNeeded(mJobs.at(0).mapImage);
-            return;
-        }
-
-        Job job = mJobs.takeFirst();
-
-        noise() << "MapImageRenderWorker started" << job.mapImage->mapInfo()->path();
-#ifndef QT_NO_DEBUG
-//        Sleep::msleep(1000);
-#endif
-        MapImageData data = generateMapImage(job.mapComposite);
-        noise() << "MapImageRenderWorker" << (aborted() ? "aborted" : "finished") << job.mapImage->mapInfo()->path();
-
-        emit jobDone(job.mapComposite); // main thread needs to delete this
-
-        if (data.valid())
-            emit imageRendered(data, job.mapImage);
-    }
-}
-
-void MapImageRenderWorker::addJob(MapImage *mapImage)
-{
-    IN_WORKER_THREAD
-
-    mJobs += Job(mapImage);
-    scheduleWork();
-}
-
-void MapImageRenderWorker::mapLoaded(MapComposite *mapComposite)
+/**
+ * Draws one horizontal band of a map image.  The bands of an image share the
+ * renderer and the MapComposite, which were prepared for drawing beforehand
+ * and are only read while drawing.  Each band paints into its own rows of
+ * the image.
+ */
+class MapImageBandTask
 {
-    IN_WORKER_THREAD
-
-    foreach (CompositeLayerGroup *layerGroup, mapComposite->sortedLayerGroups()) {
-        foreach (TileLayer *tl, layerGroup->layers()) {
-            bool isVisible = true;
-            if (tl->name().contains(QLatin1String("NoRender")))
-                isVisible = false;
-            layerGroup->setLayerVisibility(tl, isVisible);
-            layerGroup->setLayerOpacity(tl, 1.0f);
+public:
+    MapImageBandTask(const MapRenderer *renderer, const MapComposite::ZOrderList &zOrder,
+                     const QTransform &transform, QImage &image, int top, int height) :
+        mRenderer(renderer),
+        mZOrder(zOrder),
+        mTransform(transform * QTransform::fromTranslate(0, -top)),
+        mBand(image.bits() + top * image.bytesPerLine(), image.width(), height,
+              image.bytesPerLine(), image.format())
+    {}
+
+    void run()
+    {
+        mBand.fill(Qt::transparent);
+        QPainter painter(&mBand);
+
+        painter.setRenderHints(QPainter::SmoothPixmapTransform |
+                               QPainter::Antialiasing);
+        painter.setTransform(mTransform);
+        const QRectF exposed = mTransform.inverted().mapRect(QRectF(mBand.rect()));
+
+        for (const MapComposite::ZOrderItem &zo : mZOrder) {
+            if (zo.group) {
+                mRenderer->drawTileLayerGroup(&painter, zo.group, exposed);
+            } else if (TileLayer *tl = zo.layer->asTileLayer()) {
+                if (tl->name().contains(QLatin1String("NoRender")))
+                    continue;
+                mRenderer->drawTileLayer(&painter, tl, exposed);
+            }
+            if (mRenderer->isDrawingAborted())
+                break;
         }
-        layerGroup->synch();
     }
 
-    Q_ASSERT(mJobs.size());
-    Q_ASSERT(mJobs[0].mapComposite == 0);
-    mJobs[0].mapComposite = mapComposite;
-    allowWork();
-    scheduleWork();
-}
-
-void MapImageRenderWorker::mapFailedToLoad()
-{
-    IN_WORKER_THREAD
-
-    mJobs.takeFirst();
-    allowWork();
-    scheduleWork();
-}
-
-void MapImageRenderWorker::resume(MapImage *mapImage)
-{
-    IN_WORKER_THREAD
-
-    mJobs.prepend(Job(mapImage));
-    scheduleWork();
-}
+private:
+    const MapRenderer *mRenderer;
+    const MapComposite::ZOrderList &mZOrder;
+    QTransform mTransform;
+    QImage mBand;
+};
 
-MapImageData MapImageRenderWorker::generateMapImage(MapComposite *mapComposite)
+MapImageData MapImageManager::renderMapImage(MapComposite *mapComposite, const JobToken &token)
 {
     Map *map = mapComposite->map();
 
@@ -1078,7 +1056,7 @@ MapImageData MapImageRenderWorker::generateMapImage(MapComposite *mapComposite)
         return MapImageData();
     }
 
-    renderer->mAbortDrawing = workerThread()->var();
+    renderer->setAbortFlag(token.abortFlag());
 
     // Don't draw empty levels
     int maxLevel = 0;
@@ -1088,10 +1066,6 @@ MapImageData MapImageRenderWorker::generateMapImage(MapComposite *mapComposite)
     }
     renderer->setMaxLevel(maxLevel);
 
-    foreach (MapComposite *mc, mapComposite->maps())
-        if (mc->bmpBlender())
-            mc->bmpBlender()->flush(QRect(0, 0, mc->map()->width() - 1, mc->map()->height() - 1));
-
     QRectF sceneRect = mapComposite->boundingRect(renderer);
     QSize mapSize = sceneRect.size().toSize();
     if (mapSize.isEmpty())
@@ -1101,44 +1075,42 @@ MapImageData MapImageRenderWorker::generateMapImage(MapComposite *mapComposite)
     mapSize *= scale;
 
     QImage image(mapSize, QImage::Format_ARGB32);
-    image.fill(Qt::transparent);
-    QPainter painter(&image);
-
-    painter.setRenderHints(QPainter::SmoothPixmapTransform |
-                           QPainter::Antialiasing);
-    painter.setTransform(QTransform::fromScale(scale, scale).translate(-sceneRect.left(), -sceneRect.top()));
-
-    foreach (MapComposite::ZOrderItem zo, mapComposite->zOrder()) {
-        if (zo.group) {
-            renderer->drawTileLayerGroup(&painter, zo.group);
-        } else if (TileLayer *tl = zo.layer->asTileLayer()) {
-            if (tl->name().contains(QLatin1String("NoRender")))
-                continue;
-            renderer->drawTileLayer(&painter, tl);
-        }
-        if (aborted()) {
-            painter.end();
-            delete renderer;
-            return MapImageData();
-        }
+    const QTransform transform = QTransform::fromScale(scale, scale).translate(-sceneRect.left(), -sceneRect.top());
+
+    // Prepare the layer groups for the whole image once, so the bands can
+    // share them without calling prepareDrawing() at the same time.
+    const MapComposite::ZOrderList zOrder = mapComposite->zOrder();
+    for (const MapComposite::ZOrderItem &zo : zOrder) {
+        if (zo.group)
+            zo.group->prepareDrawing(renderer, sceneRect.toAlignedRect());
     }
+    renderer->setLayerGroupsPrepared(true);
+
+    // Draw horizontal bands of the image in parallel.
+    const int bandCount = qBound(1, image.height() / 64, QThread::idealThreadCount());
+    const int bandHeight = (image.height() + bandCount - 1) / bandCount;
+    QList<JobHandle> bands;
+    for (int top = 0; top < image.height(); top += bandHeight) {
+        QSharedPointer<MapImageBandTask> band(
+                    new MapImageBandTask(renderer, zOrder, transform, image, top,
+                                         qMin(bandHeight, image.height() - top)));
+        bands += JobScheduler::instance()->schedule([band]() { band->run(); },
+                                                    JobScheduler::PriorityLow, token);
+    }
+    // Bands no other worker has started are drawn by this one.
+    for (const JobHandle &band : bands)
+        JobScheduler::instance()->wait(band);
 
-    painter.end();
-
-    for (int y = 0; y < image.height(); y++) {
-        QRgb *pixels = reinterpret_cast<QRgb*>(image.scanLine(y));
-        for (int x = 0; x < image.width(); x++) {
-            QRgb pixel = pixels[x];
-            if (qAlpha(pixel) > 0.01f) {
-                pixels[x] = qRgba(qRed(pixel), qGreen(pixel), qBlue(pixel), 255);
-            }
-        }
+    if (token.isCancelled()) {
+        delete renderer;
+        return MapImageData();
     }
 
     MapImageData data;
 #ifdef WORLDED
-    data.image = image.convertToFormat(QImage::Format_ARGB4444_Premultiplied);
+    data.image = flattenAlphaToARGB4444(image);
 #else
+    flattenAlpha(image);
     data.image = image;
 #endif
     data.scale = scale;
@@ -1161,9 +1133,3 @@ MapImageData MapImageRenderWorker::generateMapImage(MapComposite *mapComposite)
 
     return data;
 }
-
-MapImageRenderWorker::Job::Job(MapImage *mapImage) :
-    mapComposite(0),
-    mapImage(mapImage)
-{
-}
@@ -23,6 +23,7 @@
 #include <QMap>
 #include <QObject>
 #include <QStringList>
+#include <QVector>
 
 class MapComposite;
 class MapInfo;
@@ -31,37 +32,9 @@ namespace Tiled {
 class Map;
 }
 
-#include "threads.h"
-class MapImage;
-class MapImageReaderWorker : public BaseWorker
-{
-    Q_OBJECT
-public:
-    MapImageReaderWorker(InterruptibleThread *thread);
-
-    ~MapImageReaderWorker();
-
-signals:
-    void imageLoaded(QImage *image, MapImage *mapImage);
-
-public slots:
-    void work();
-    void addJob(const QString &imageFileName, MapImage *mapImage);
+#include "jobscheduler.h"
 
-private:
-    class Job {
-    public:
-        Job(const QString &imageFileName, MapImage *mapImage) :
-            imageFileName(imageFileName),
-            mapImage(mapImage)
-        {
-        }
-
-        QString imageFileName;
-        MapImage *mapImage;
-    };
-    QList<Job> mJobs;
-};
+class MapImage;
 
 class MapImageData
 {
@@ -84,42 +57,6 @@ public:
     QSize tileSize;
 };
 
-#include <QMetaType>
-Q_DECLARE_METATYPE(MapImageData) // for QueuedConnection
-
-class MapImageRenderWorker : public BaseWorker
-{
-    Q_OBJECT
-public:
-    MapImageRenderWorker(InterruptibleThread *thread);
-
-    ~MapImageRenderWorker();
-
-signals:
-    void mapNeeded(MapImage *mapImage);
-    void imageRendered(MapImageData data, MapImage *mapImage);
-    void jobDone(MapComposite *mapComposite);
-
-public slots:
-    void work();
-    void addJob(MapImage *mapImage);
-    void mapLoaded(MapComposite *mapComposite);
-    void mapFailedToLoad();
-    void resume(MapImage *mapImage);
-
-private:
-    MapImageData generateMapImage(MapComposite *mapComposite);
-
-    class Job {
-    public:
-        Job(MapImage *mapImage);
-
-        MapComposite *mapComposite;
-        MapImage *mapImage;
-    };
-    QList<Job> mJobs;
-};
-
 class MapImage
 {
 public:
@@ -214,6 +151,12 @@ public:
     static MapImageManager *instance();
     static void deleteInstance();
 
+    /**
+     * The number of maps rendered at once.  Must be called before the first
+     * call to instance().  By default it depends on the number of cores.
+     */
+    static void setRenderThreadCount(int count);
+
     MapImage *getMapImage(const QString &mapName, const QString &relativeTo = QString());
 
     QString errorString() const
@@ -266,40 +209,64 @@ private slots:
     void mapFileChanged(MapInfo *mapInfo);
 
 private slots:
-    void imageLoadedByThread(QImage *image, MapImage *mapImage);
-
-    void renderThreadNeedsMap(MapImage *mapImage);
-    void imageRenderedByThread(MapImageData imgData, MapImage *mapImage);
-    void renderJobDone(MapComposite *mapComposite);
-
     void mapLoaded(MapInfo *mapInfo);
     void mapFailedToLoad(MapInfo *mapInfo);
 
     void processDeferrals();
 
 private:
+    // Each render slot works on one map at a time.  The map and its lots are
+    // loaded in the GUI thread, then the image is drawn by a JobScheduler job.
+    struct RenderSlot
+    {
+        RenderSlot() :
+            expectMapImage(0),
+            mapImage(0),
+            mapComposite(0)
+        {}
+
+        bool isIdle() const
+        { return !expectMapImage && !mapComposite; }
+
+        MapImage *expectMapImage;
+        QList<MapInfo*> expectSubMaps;
+#ifdef WORLDED
+        QList<MapInfo*> referencedMaps;
+#endif
+        MapImage *mapImage;
+        MapComposite *mapComposite;
+        JobToken token;
+        JobHandle job;
+    };
+
+    void readImageInBackground(const QString &imageFileName, MapImage *mapImage);
+    void imageLoadedByThread(const QImage &image, MapImage *mapImage);
+
+    void addRenderJob(MapImage *mapImage);
+    void startRenderJobs();
+    void renderSlotNeedsMap(int index, MapImage *mapImage);
+    void renderSlotMapLoaded(int index, MapInfo *mapInfo);
+    void renderSlotMapFailedToLoad(int index, MapInfo *mapInfo);
+    void startRender(int index);
+    void renderJobDone(int index, const MapImageData &data);
+    void imageRenderedByThread(const MapImageData &imgData, MapImage *mapImage);
+    static MapImageData renderMapImage(MapComposite *mapComposite, const JobToken &token);
+
     Q_DISABLE_COPY(MapImageManager)
     MapImageManager();
     ~MapImageManager();
 
     QFileInfo imageFileInfo(const QString &mapFilePath);
     QFileInfo imageDataFileInfo(const QFileInfo &imageFileInfo);
+    void imageReadError(const QString &message);
 
     QMap<QString,MapImage*> mMapImages;
     QString mError;
 
-    QVector<InterruptibleThread*> mImageReaderThreads;
-    QVector<MapImageReaderWorker*> mImageReaderWorkers;
-    int mNextThreadForJob;
+    JobToken mImageReaderToken;
 
-    InterruptibleThread *mImageRenderThread;
-    MapImageRenderWorker *mImageRenderWorker;
-    MapImage *mExpectMapImage;
-    QList<MapInfo*> mExpectSubMaps;
-#ifdef WORLDED
-    QList<MapInfo*> mReferencedMaps;
-#endif
-    MapComposite *mRenderMapComposite;
+    QVector<RenderSlot> mRenderSlots;
+    QList<MapImage*> mRenderQueue;
 
     friend class MapImageManagerDeferral;
     void deferThreadResults(bool defer);
@@ -308,6 +275,7 @@ private:
     bool mDeferralQueued;
 
     static MapImageManager *mInstance;
+    static int mRenderThreadCount;
 };
 
 class MapImageManagerDeferral
@@ -41,6 +41,7 @@ using namespace SharedTools;
 #include "BuildingEditor/buildingtiles.h"
 #include "BuildingEditor/furnituregroups.h"
 
+#include <QCoreApplication>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
@@ -76,7 +77,7 @@ MapManager::MapManager() :
     mDeferralDepth(0),
     mDeferralQueued(false),
     mWaitingForMapInfo(nullptr),
-    mNextThreadForJob(0)
+    mUseBinaryCache(Preferences::instance()->useMapBinaryCache())
 #ifdef WORLDED
     , mReferenceEpoch(0)
 #endif
@@ -89,24 +90,6 @@ MapManager::MapManager() :
     connect(&mChangedFilesTimer, &QTimer::timeout,
             this, &MapManager::fileChangedTimeout);
 
-    qRegisterMetaType<MapInfo*>("BuildingEditor::Building*");
-    qRegisterMetaType<MapInfo*>("MapInfo*");
-
-    mMapReaderThread.resize(4);
-    mMapReaderWorker.resize(mMapReaderThread.size());
-    for (int i = 0; i < mMapReaderThread.size(); i++) {
-        mMapReaderThread[i] = new InterruptibleThread;
-        mMapReaderWorker[i] = new MapReaderWorker(mMapReaderThread[i], i);
-        mMapReaderWorker[i]->moveToThread(mMapReaderThread[i]);
-        connect(mMapReaderWorker[i], qOverload<Map*,MapInfo*>(&MapReaderWorker::loaded),
-                this, &MapManager::mapLoadedByThread);
-        connect(mMapReaderWorker[i], qOverload<BuildingEditor::Building*,MapInfo*>(&MapReaderWorker::loaded),
-                this, &MapManager::buildingLoadedByThread);
-        connect(mMapReaderWorker[i], &MapReaderWorker::failedToLoad,
-                this, &MapManager::failedToLoadByThread);
-        mMapReaderThread[i]->start();
-    }
-
     connect(TileMetaInfoMgr::instance(), &TileMetaInfoMgr::tilesetAdded,
             this, &MapManager::metaTilesetAdded);
     connect(TileMetaInfoMgr::instance(), &TileMetaInfoMgr::tilesetRemoved,
@@ -115,13 +98,8 @@ MapManager::MapManager() :
 
 MapManager::~MapManager()
 {
-    for (int i = 0; i < mMapReaderThread.size(); i++) {
-        mMapReaderThread[i]->interrupt(); // stop the long-running task
-        mMapReaderThread[i]->quit(); // exit the event loop
-        mMapReaderThread[i]->wait(); // wait for thread to terminate
-        delete mMapReaderThread[i];
-        delete mMapReaderWorker[i];
-    }
+    mReadToken.cancel();
+    JobScheduler::instance()->wait(mReadToken);
 
     TilesetManager *tilesetManager = TilesetManager::instance();
 
@@ -201,10 +179,7 @@ MapInfo *MapManager::loadMap(const QString &mapName, const QString &relativeTo,
     if (!mapInfo)
         return nullptr;
     if (mapInfo->mLoading) {
-        foreach (MapReaderWorker *w, mMapReaderWorker)
-            QMetaObject::invokeMethod(w, "possiblyRaisePriority",
-                                      Qt::QueuedConnection, Q_ARG(MapInfo*,mapInfo),
-                                      Q_ARG(int,priority));
+        possiblyRaisePriority(mapInfo, priority);
         if (!asynch) {
             noise() << "WAITING FOR MAP" << mapName << "with priority" << priority;
             Q_ASSERT(mWaitingForMapInfo == nullptr);
@@ -217,9 +192,7 @@ MapInfo *MapManager::loadMap(const QString &mapName, const QString &relativeTo,
                     break;
                 }
             }
-            while (mapInfo->mLoading) {
-                qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
-            }
+            waitForRead(mapInfo);
             mWaitingForMapInfo = nullptr;
             if (!mapInfo->map())
                 return nullptr;
@@ -227,26 +200,17 @@ MapInfo *MapManager::loadMap(const QString &mapName, const QString &relativeTo,
         return mapInfo;
     }
     mapInfo->mLoading = true;
-    QMetaObject::invokeMethod(mMapReaderWorker[mNextThreadForJob], "addJob",
-                              Qt::QueuedConnection, Q_ARG(MapInfo*,mapInfo),
-                              Q_ARG(int,priority));
-    mNextThreadForJob = (mNextThreadForJob + 1) % mMapReaderThread.size();
+    readMapInBackground(mapInfo, priority);
 
     if (asynch)
         return mapInfo;
 
-    // Wow.  Had a map *finish loading* after the PROGRESS call below displayed
-    // the dialog and started processing events but before the qApp->processEvents()
-    // call below, resulting in a hang because mWaitingForMapInfo wasn't set until
-    // after the PROGRESS call.
+    // Set this before the PROGRESS dialog processes any events, so the map is
+    // not deferred if it finishes loading in the meantime.
     Q_ASSERT(mWaitingForMapInfo == nullptr);
     mWaitingForMapInfo = mapInfo;
 
     PROGRESS progress(tr("Reading %1").arg(fileInfoMap.completeBaseName()));
-    foreach (MapReaderWorker *w, mMapReaderWorker)
-        QMetaObject::invokeMethod(w, "possiblyRaisePriority",
-                                  Qt::QueuedConnection, Q_ARG(MapInfo*,mapInfo),
-                                  Q_ARG(int,priority));
     noise() << "WAITING FOR MAP" << mapName << "with priority" << priority;
     for (int i = 0; i < mDeferredMaps.size(); i++) {
         MapDeferral md = mDeferredMaps[i];
@@ -256,9 +220,7 @@ MapInfo *MapManager::loadMap(const QString &mapName, const QString &relativeTo,
             break;
         }
     }
-    while (mapInfo->mLoading) {
-        qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
-    }
+    waitForRead(mapInfo);
     mWaitingForMapInfo = nullptr;
     if (mapInfo->map())
         return mapInfo;
@@ -284,7 +246,6 @@ MapInfo *MapManager::newFromMap(Map *map, const QString &mapFilePath)
     return info;
 }
 
-#include <QCoreApplication>
 #include <QXmlStreamReader>
 
 class MapInfoReader
@@ -678,6 +639,11 @@ Map *MapManager::convertOrientation(Map *map, Tiled::Map::Orientation orient)
 
 void MapManager::fileChanged(const QString &path)
 {
+    // The binary cache is only checked against the size and the timestamp
+    // or contents of the .tmx file, so don't leave it to catch the change.
+    if (path.endsWith(QLatin1String(".tmx")))
+        QFile::remove(MapReader::binaryCachePath(path));
+
     mChangedFiles.insert(path);
     mChangedFilesTimer.start();
 }
@@ -700,10 +666,7 @@ void MapManager::fileChangedTimeout()
                     Q_ASSERT(!mapInfo->isBeingEdited());
                     if (!mapInfo->isLoading()) {
                         mapInfo->mLoading = true; // FIXME: seems weird to change this for a loaded map
-                        QMetaObject::invokeMethod(mMapReaderWorker[mNextThreadForJob], "addJob",
-                                                  Qt::QueuedConnection, Q_ARG(MapInfo*,mapInfo),
-                                                  Q_ARG(int,PriorityLow));
-                        mNextThreadForJob = (mNextThreadForJob + 1) % mMapReaderThread.size();
+                        readMapInBackground(mapInfo, PriorityLow);
                     }
                 }
                 {
@@ -867,123 +830,79 @@ void MapManager::processDeferrals()
         mapLoadedByThread(md.map, md.mapInfo);
 }
 
-/////
-
-MapReaderWorker::MapReaderWorker(InterruptibleThread *thread, int id) :
-    BaseWorker(thread),
-    mID(id)
-{
-}
-
-MapReaderWorker::~MapReaderWorker()
+struct MapManager::ReadResult
 {
-}
+    ReadResult() : map(nullptr), building(nullptr) {}
+    Map *map;
+    Building *building;
+    QString error;
+};
 
-void MapReaderWorker::work()
+// Reads the map or building file in a worker thread.  The result is handed to
+// mapLoadedByThread() and friends in the GUI thread.
+void MapManager::readMapInBackground(MapInfo *mapInfo, int priority)
 {
-    IN_WORKER_THREAD
-
-    if (mJobs.size()) {
-        if (aborted()) {
-            mJobs.clear();
-            return;
-        }
+    QSharedPointer<ReadResult> result(new ReadResult);
+    const QString path = mapInfo->path();
+    const bool useBinaryCache = mUseBinaryCache;
 
-        Job job = mJobs.takeFirst();
-        debugJobs("take job");
-
-        if (job.mapInfo->path().endsWith(QLatin1String(".tbx"))) {
-            Building *building = loadBuilding(job.mapInfo);
-            if (building)
-                emit loaded(building, job.mapInfo);
-            else
-                emit failedToLoad(mError, job.mapInfo);
+    auto work = [result, path, useBinaryCache]() {
+        if (path.endsWith(QLatin1String(".tbx"))) {
+            BuildingReader reader;
+            result->building = reader.read(path);
+            if (!result->building)
+                result->error = reader.errorString();
         } else {
-//            noise() << "READING STARTED" << job.mapInfo->path();
-            Map *map = loadMap(job.mapInfo);
-//            noise() << "READING FINISHED" << job.mapInfo->path();
-            if (map)
-                emit loaded(map, job.mapInfo);
-            else
-                emit failedToLoad(mError, job.mapInfo);
+            EditorMapReader reader;
+//            reader.setTilesetImageCache(TilesetManager::instance()->imageCache()); // not thread-safe class
+            reader.setDecodeLayersInParallel(true);
+            reader.setUseBinaryCache(useBinaryCache);
+            result->map = reader.readMap(path);
+            if (!result->map)
+                result->error = reader.errorString();
         }
+    };
 
-//        QCoreApplication::processEvents(); // handle changing job priority
-    }
-
-    if (mJobs.size()) scheduleWork();
-}
-
-void MapReaderWorker::addJob(MapInfo *mapInfo, int priority)
-{
-    IN_WORKER_THREAD
-
-    int index = 0;
-    while ((index < mJobs.size()) && (mJobs[index].priority >= priority))
-        ++index;
-
-    mJobs.insert(index, Job(mapInfo, priority));
-    debugJobs("add job");
-    scheduleWork();
-}
-
-void MapReaderWorker::possiblyRaisePriority(MapInfo *mapInfo, int priority)
-{
-    IN_WORKER_THREAD
+    auto done = [this, mapInfo, result]() {
+        finishRead(mapInfo, result);
+    };
 
-    for (int i = 0; i < mJobs.size(); i++) {
-        if (mJobs[i].mapInfo == mapInfo && mJobs[i].priority < priority) {
-            int j;
-            for (j = i - 1; j >= 0 && mJobs[j].priority < priority; j--) {}
-            mJobs[i].priority = priority;
-            mJobs.move(i, j + 1);
-            debugJobs("raise priority");
-            break;
-        }
-    }
+    ReadJob &read = mReadJobs[mapInfo];
+    read.result = result;
+    read.job = JobScheduler::instance()->schedule(work, priority, mReadToken,
+                                                  this, done);
 }
 
-class MapReaderWorker_MapReader : public MapReader
-{
-protected:
-    /**
-     * Overridden to make sure the resolved reference is canonical.
-     */
-    QString resolveReference(const QString &reference, const QString &mapPath)
-    {
-        QString resolved = MapReader::resolveReference(reference, mapPath);
-        QString canonical = QFileInfo(resolved).canonicalFilePath();
-
-        // Make sure that we're not returning an empty string when the file is
-        // not found.
-        return canonical.isEmpty() ? resolved : canonical;
-    }
-};
-
-Map *MapReaderWorker::loadMap(MapInfo *mapInfo)
+void MapManager::possiblyRaisePriority(MapInfo *mapInfo, int priority)
 {
-    MapReaderWorker_MapReader reader;
-//    reader.setTilesetImageCache(TilesetManager::instance()->imageCache()); // not thread-safe class
-    Map *map = reader.readMap(mapInfo->path());
-    if (!map)
-        mError = reader.errorString();
-    return map;
+    JobHandle job = mReadJobs.value(mapInfo).job;
+    if (job.isValid())
+        job.raisePriority(priority);
 }
 
-Building *MapReaderWorker::loadBuilding(MapInfo *mapInfo)
+// Blocks until the map is read, reading it in this thread if no worker has
+// started on it yet.  The result is used right away rather than when the
+// job's continuation is called.
+void MapManager::waitForRead(MapInfo *mapInfo)
 {
-    BuildingReader reader;
-    Building *building = reader.read(mapInfo->path());
-    if (!building)
-        mError = reader.errorString();
-    return building;
+    if (!mReadJobs.contains(mapInfo))
+        return;
+    ReadJob read = mReadJobs[mapInfo];
+    JobScheduler::instance()->wait(read.job);
+    finishRead(mapInfo, read.result);
 }
 
-void MapReaderWorker::debugJobs(const char *msg)
+void MapManager::finishRead(MapInfo *mapInfo, const QSharedPointer<ReadResult> &result)
 {
-    QStringList out;
-    foreach (Job job, mJobs) {
-        out += QString::fromLatin1("    %1 priority=%2\n").arg(QFileInfo(job.mapInfo->path()).fileName()).arg(job.priority);
-    }
-    noise() << "MRW #" << mID << ": " << msg << "\n" << out;
+    // Already handled by waitForRead(), or replaced by a newer read.
+    if (mReadJobs.value(mapInfo).result != result)
+        return;
+    mReadJobs.remove(mapInfo);
+
+    if (result->building)
+        buildingLoadedByThread(result->building, mapInfo);
+    else if (result->map)
+        mapLoadedByThread(result->map, mapInfo);
+    else
+        failedToLoadByThread(result->error, mapInfo);
 }
@@ -20,7 +20,7 @@
 
 #include "map.h"
 #include "filesystemwatcher.h"
-#include "threads.h"
+#include "jobscheduler.h"
 
 #include <QDateTime>
 #include <QMap>
@@ -32,46 +32,6 @@ namespace BuildingEditor {
 class Building;
 }
 
-class MapReaderWorker : public BaseWorker
-{
-    Q_OBJECT
-public:
-    MapReaderWorker(InterruptibleThread *thread, int id);
-    ~MapReaderWorker();
-
-signals:
-    void loaded(Tiled::Map *map, MapInfo *mapInfo);
-    void loaded(BuildingEditor::Building *building, MapInfo *mapInfo);
-    void failedToLoad(const QString error, MapInfo *mapInfo);
-
-public slots:
-    void work();
-    void addJob(MapInfo *mapInfo, int priority);
-    void possiblyRaisePriority(MapInfo *mapInfo, int priority);
-
-private:
-    Tiled::Map *loadMap(MapInfo *mapInfo);
-    BuildingEditor::Building *loadBuilding(MapInfo *mapInfo);
-
-    class Job {
-    public:
-        Job(MapInfo *mapInfo, int priority) :
-            mapInfo(mapInfo),
-            priority(priority)
-        {
-        }
-
-        MapInfo *mapInfo;
-        int priority;
-    };
-    QList<Job> mJobs;
-
-    int mID;
-    void debugJobs(const char *msg);
-
-    QString mError;
-};
-
 class MapInfo
 {
 public:
@@ -203,6 +163,15 @@ public:
     QString errorString() const
     { return mError; }
 
+    /**
+     * When enabled, maps loaded by the reader threads use a .tmx.cache file
+     * next to each .tmx file.  See Tiled::MapReader::setUseBinaryCache().
+     */
+    void setUseBinaryCache(bool use)
+    { mUseBinaryCache = use; }
+    bool useBinaryCache() const
+    { return mUseBinaryCache; }
+
 signals:
     void mapAboutToChange(MapInfo *mapInfo);
     void mapChanged(MapInfo *mapInfo);
@@ -255,9 +224,20 @@ private:
     bool mDeferralQueued;
     MapInfo *mWaitingForMapInfo;
 
-    QVector<InterruptibleThread*> mMapReaderThread;
-    QVector<MapReaderWorker*> mMapReaderWorker;
-    int mNextThreadForJob;
+    // There is at most one read per MapInfo, so at most one per file.
+    struct ReadResult;
+    struct ReadJob
+    {
+        JobHandle job;
+        QSharedPointer<ReadResult> result;
+    };
+    void readMapInBackground(MapInfo *mapInfo, int priority);
+    void possiblyRaisePriority(MapInfo *mapInfo, int priority);
+    void waitForRead(MapInfo *mapInfo);
+    void finishRead(MapInfo *mapInfo, const QSharedPointer<ReadResult> &result);
+    JobToken mReadToken;
+    QMap<MapInfo*,ReadJob> mReadJobs;
+    bool mUseBinaryCache;
 #ifdef WORLDED
     int mReferenceEpoch;
 #endif
@@ -27,6 +27,7 @@
 #include "tilesetmanager.h"
 #include "ZomboidScene.h"
 
+#include "alphaflatten.h"
 #include "isometricrenderer.h"
 #include "map.h"
 #include "tilelayer.h"
@@ -36,12 +37,14 @@
 #include "worlded/worldcell.h"
 
 #include <qmath.h>
+#include <QCoreApplication>
 #include <QDebug>
 #include <QElapsedTimer>
 #include <QGraphicsPolygonItem>
 #include <QHBoxLayout>
 #include <QMouseEvent>
 #include <QScrollBar>
+#include <QThread>
 #include <QToolButton>
 
 using namespace Tiled;
@@ -53,6 +56,8 @@ inline QNoDebug noise() { return QNoDebug(); }
 inline QDebug noise() { return QDebug(QtDebugMsg); }
 #endif
 
+#define IN_APP_THREAD Q_ASSERT(QThread::currentThread() == qApp->thread());
+
 /////
 
 ShadowMap::ShadowMap(MapInfo *mapInfo)
@@ -171,19 +176,27 @@ void ShadowMap::mapChanged(MapInfo *mapInfo)
 
 /////
 
-MiniMapRenderWorker::MiniMapRenderWorker(MapInfo *mapInfo, InterruptibleThread *thread) :
-    BaseWorker(thread),
+MiniMapRenderWorker::MiniMapRenderWorker(MapInfo *mapInfo) :
+    QObject(),
     mRedrawAll(true),
-    mVisible(false)
+    mVisible(false),
+    mSuspended(false)
 {
     IN_APP_THREAD
+
+    // Connect before the ShadowMap's MapComposites do, so painting is stopped
+    // before they add any sub-maps that finished loading.
+    connect(MapManager::instance(), &MapManager::mapLoaded,
+            this, &MiniMapRenderWorker::mapLoaded);
+    connect(MapManager::instance(), &MapManager::mapFailedToLoad,
+            this, &MiniMapRenderWorker::mapLoaded);
+
     mShadowMap = new ShadowMap(mapInfo);
-    mShadowMap->mMapComposite->setParent(this); // so moveToThread() moves it
     (mapInfo->orientation() == Map::Isometric)
             ? mRenderer = new IsometricRenderer(mapInfo->map())
             : mRenderer = new ZLevelRenderer(mapInfo->map());
     mRenderer->setMaxLevel(mShadowMap->mMapComposite->maxLevel());
-    mRenderer->mAbortDrawing = thread->var();
+    mRenderer->setAbortFlag(mToken.abortFlag());
 
     QRectF r = mShadowMap->mMapComposite->boundingRect(mRenderer);
     qreal scale = 512.0 / r.width();
@@ -194,16 +207,20 @@ MiniMapRenderWorker::MiniMapRenderWorker(MapInfo *mapInfo, InterruptibleThread *
 MiniMapRenderWorker::~MiniMapRenderWorker()
 {
     IN_APP_THREAD
+    mToken.cancel();
+    mPaintJob.wait();
     delete mRenderer;
-    Q_ASSERT(mShadowMap->mMapComposite->QObject::parent() == this);
-    mShadowMap->mMapComposite->setParent(0);
     delete mShadowMap;
     qDeleteAll(mPendingChanges);
 }
 
-void MiniMapRenderWorker::work()
+void MiniMapRenderWorker::scheduleWork()
 {
-    IN_WORKER_THREAD
+    IN_APP_THREAD
+
+    // The ShadowMap and the image belong to the job until it is done.
+    if (mSuspended || mPaintJob.isValid())
+        return;
 
     processChanges(mPendingChanges);
     qDeleteAll(mPendingChanges);
@@ -224,7 +241,25 @@ void MiniMapRenderWorker::work()
     if (mRedrawAll)
         paintRect = sceneRect;
 
-    qreal scale = mImage.width() / qreal(mapSize.width());
+    // Blending changes the MapComposite's layers, so do it here.
+    mShadowMap->mMapComposite->bmpBlender()->flush(mRenderer, paintRect.toAlignedRect(), QPoint());
+
+    // A paint cancelled before it started doesn't run at all.
+    QSharedPointer<bool> aborted(new bool(true));
+    auto work = [this, sceneRect, paintRect, aborted]() {
+        paint(sceneRect, paintRect);
+        *aborted = mToken.isCancelled();
+    };
+    auto done = [this, sceneRect, aborted]() {
+        paintDone(sceneRect, *aborted);
+    };
+    mPaintJob = JobScheduler::instance()->schedule(work, JobScheduler::PriorityNormal,
+                                                   mToken, this, done);
+}
+
+void MiniMapRenderWorker::paint(const QRectF &sceneRect, const QRectF &paintRect)
+{
+    qreal scale = mImage.width() / qreal(sceneRect.size().toSize().width());
 
     QPainter painter(&mImage);
 
@@ -243,10 +278,6 @@ void MiniMapRenderWorker::work()
     QElapsedTimer timer;
     timer.start();
 
-    bool aborted = false;
-
-    mShadowMap->mMapComposite->bmpBlender()->flush(mRenderer, paintRect.toAlignedRect(), QPoint());
-
     MapComposite::ZOrderList zorder = mShadowMap->mMapComposite->zOrder();
     foreach (MapComposite::ZOrderItem zo, zorder) {
         if (zo.group)
@@ -257,46 +288,43 @@ void MiniMapRenderWorker::work()
             mRenderer->drawTileLayer(&painter, tl, paintRect);
         }
 
-        aborted = this->aborted();
-        if (aborted) {
+        if (mToken.isCancelled()) {
             noise() << "MiniMapRenderWorker: interrupting -" << timer.elapsed() << "ms wasted" << this;
-            break;
+            return;
         }
     }
 
     painter.end();
 
-    if (!aborted) {
-        for (int y = 0; y < mImage.height(); y++) {
-            QRgb *pixels = reinterpret_cast<QRgb*>(mImage.scanLine(y));
-            for (int x = 0; x < mImage.width(); x++) {
-                QRgb pixel = pixels[x];
-                if (qAlpha(pixel) > 0.01f) {
-                    pixels[x] = qRgba(qRed(pixel), qGreen(pixel), qBlue(pixel), 255);
-                }
-            }
-        }
+    // Only the painted part of the image needs flattening.
+    flattenAlpha(mImage, xform.mapRect(paintRect).toAlignedRect());
+
+    noise() << "MiniMapRenderWorker: painting took" << timer.elapsed() << "ms" << this;
+}
+
+void MiniMapRenderWorker::paintDone(const QRectF &sceneRect, bool aborted)
+{
+    mPaintJob = JobHandle();
 
-        noise() << "MiniMapRenderWorker: painting took" << timer.elapsed() << "ms" << this;
+    if (!aborted) {
         mRedrawAll = false;
         mDirtyRect = QRectF();
         emit painted(mImage, sceneRect);
     }
+
+    scheduleWork();
 }
 
 void MiniMapRenderWorker::applyChanges(const QList<MapChange *> &changes)
 {
-    IN_WORKER_THREAD
+    IN_APP_THREAD
     mPendingChanges += changes;
-
-    // I have a feeling this gets added to the queue we're processing now rather
-    // than waiting for the next event loop in this thread.
     scheduleWork();
 }
 
 void MiniMapRenderWorker::processChanges(const QList<MapChange *> &changes)
 {
-    IN_WORKER_THREAD
+    IN_APP_THREAD
 
     ShadowMap &sm = *mShadowMap;
     QRectF oldBounds = sm.mMapComposite->boundingRect(mRenderer);
@@ -545,9 +573,22 @@ void MiniMapRenderWorker::processChanges(const QList<MapChange *> &changes)
     noise() << "MiniMapRenderWorker: applied" << mPendingChanges.size() << "changes" << this;
 }
 
+void MiniMapRenderWorker::interrupt()
+{
+    mSuspended = true;
+    mToken.cancel();
+    mPaintJob.wait();
+}
+
 void MiniMapRenderWorker::resume()
 {
-//    scheduleWork();
+    if (!mSuspended)
+        return;
+    // The cancelled paint is finished, but its continuation may not have
+    // been called yet.  It calls scheduleWork() when it is.
+    mToken.reset();
+    mSuspended = false;
+    scheduleWork();
 }
 
 void MiniMapRenderWorker::setVisible(bool visible)
@@ -559,10 +600,16 @@ void MiniMapRenderWorker::setVisible(bool visible)
         scheduleWork();
 }
 
-void MiniMapRenderWorker::returnToAppThread()
+// A sub-map of the ShadowMap may be about to be added.
+void MiniMapRenderWorker::mapLoaded(MapInfo *mapInfo)
 {
-    IN_WORKER_THREAD
-    moveToThread(qApp->thread());
+    Q_UNUSED(mapInfo)
+    if (!mPaintJob.isValid() || !mShadowMap->mMapComposite->waitingForMapsToLoad())
+        return;
+    mToken.cancel();
+    mPaintJob.wait();
+    mToken.reset();
+    // paintDone() will start painting again.
 }
 
 /////
@@ -576,16 +623,11 @@ MiniMapItem::MiniMapItem(ZomboidScene *zscene, QGraphicsItem *parent)
 {
     mMapComposite = mScene->mapDocument()->mapComposite();
 
-    qRegisterMetaType<QList<MapChange*> >("QList<MapChange*>");
-    mRenderThread = new InterruptibleThread;
-    mRenderWorker = new MiniMapRenderWorker(mMapComposite->mapInfo(),
-                                            mRenderThread);
-    mRenderWorker->moveToThread(mRenderThread);
+    mRenderWorker = new MiniMapRenderWorker(mMapComposite->mapInfo());
     connect(mRenderWorker, &MiniMapRenderWorker::painted,
             this, &MiniMapItem::painted);
     connect(mRenderWorker, &MiniMapRenderWorker::imageResized,
             this, &MiniMapItem::imageResized);
-    mRenderThread->start();
 
     connect(mScene->mapDocument(), &MapDocument::layerAdded,
             this, &MiniMapItem::layerAdded);
@@ -650,14 +692,7 @@ MiniMapItem::MiniMapItem(ZomboidScene *zscene, QGraphicsItem *parent)
 
 MiniMapItem::~MiniMapItem()
 {
-    mRenderThread->interrupt();
-    QMetaObject::invokeMethod(mRenderWorker, "returnToAppThread", Qt::QueuedConnection);
-    while (mRenderWorker->thread() != qApp->thread())
-        Sleep::msleep(1);
-    mRenderThread->quit();
-    mRenderThread->wait();
     delete mRenderWorker;
-    delete mRenderThread;
 }
 
 QRectF MiniMapItem::boundingRect() const
@@ -694,16 +729,13 @@ void MiniMapItem::recreateImage()
 void MiniMapItem::minimapVisibilityChanged(bool visible)
 {
     mMiniMapVisible = visible;
-    QMetaObject::invokeMethod(mRenderWorker, "setVisible", Qt::QueuedConnection,
-                              Q_ARG(bool,visible));
+    mRenderWorker->setVisible(visible);
 }
 
 void MiniMapItem::queueChange(MapChange *c)
 {
     mPendingChanges += c;
     if (mPendingChanges.size() == 1) {
-//        mRenderThread->interrupt();
-//        mNeedsResume = true;
         QMetaObject::invokeMethod(this, "queueChanges", Qt::QueuedConnection);
     }
 }
@@ -828,7 +860,7 @@ void MiniMapItem::mapAboutToChange(MapInfo *mapInfo)
 {
     foreach (MapComposite *mc, mMapComposite->subMaps()) {
         if (mapInfo == mc->mapInfo()) {
-            mRenderThread->interrupt(true);
+            mRenderWorker->interrupt();
             // do not resume painting until resume()
             break;
         }
@@ -876,7 +908,7 @@ void MiniMapItem::tilesetAdded(int index, Tileset *tileset)
 
 void MiniMapItem::tilesetRemoved(Tileset *tileset)
 {
-    mRenderThread->interrupt(true);
+    mRenderWorker->interrupt();
     mNeedsResume = true;
 
     MapChange *c = new MapChange(MapChange::TilesetRemoved);
@@ -968,14 +1000,12 @@ void MiniMapItem::queueChanges()
 {
     if (mNeedsResume) {
         mNeedsResume = false;
-        mRenderThread->resume();
-        QMetaObject::invokeMethod(mRenderWorker, "resume", Qt::QueuedConnection);
+        mRenderWorker->resume();
     }
 
     // FIXME: merge sequences of RegionAltered changes into a single change.
     // Maybe use a SparseTileLayerGrid to pass changes.
-    QMetaObject::invokeMethod(mRenderWorker, "applyChanges", Qt::QueuedConnection,
-                              Q_ARG(QList<MapChange*>,mPendingChanges));
+    mRenderWorker->applyChanges(mPendingChanges);
     mPendingChanges.clear();
 }
 
@@ -21,7 +21,7 @@
 #include <QGraphicsItem>
 #include <QGraphicsView>
 
-#include "threads.h"
+#include "jobscheduler.h"
 
 #include "map.h"
 #include "tilelayer.h"
@@ -164,36 +164,50 @@ public:
     QRegion mRegion;
 };
 
-class MiniMapRenderWorker : public BaseWorker
+/**
+  * Keeps the ShadowMap up to date and paints it.  Changes are applied in the
+  * GUI thread between paints, the painting itself is a JobScheduler job.
+  */
+class MiniMapRenderWorker : public QObject
 {
     Q_OBJECT
 public:
-    MiniMapRenderWorker(MapInfo *mapInfo, InterruptibleThread *thread);
+    MiniMapRenderWorker(MapInfo *mapInfo);
     ~MiniMapRenderWorker();
 
-public slots:
-    void work();
     void applyChanges(const QList<MapChange*> &changes);
-    void resume();
     void setVisible(bool visible);
-    void returnToAppThread();
+
+    /**
+     * Stops painting right away, and doesn't start again until resume().
+     */
+    void interrupt();
+    void resume();
 
 signals:
     void painted(QImage image, QRectF r);
     void imageResized(QSize sz);
 
+private slots:
+    void mapLoaded(MapInfo *mapInfo);
+    void scheduleWork();
+
 private:
     void processChanges(const QList<MapChange *> &changes);
+    void paint(const QRectF &sceneRect, const QRectF &paintRect);
+    void paintDone(const QRectF &sceneRect, bool aborted);
 
     ShadowMap *mShadowMap;
     Tiled::MapRenderer *mRenderer;
     QImage mImage;
     QRectF mDirtyRect;
     QMap<quintptr,QRectF> mLotBounds;
-    bool mWorkPending;
     bool mRedrawAll;
     bool mVisible;
+    bool mSuspended;
     QList<MapChange*> mPendingChanges;
+    JobToken mToken;
+    JobHandle mPaintJob;
 };
 
 /**
@@ -276,7 +290,6 @@ private:
     bool mMiniMapVisible;
     QList<MapChange*> mPendingChanges;
     bool mNeedsResume;
-    InterruptibleThread *mRenderThread;
     MiniMapRenderWorker *mRenderWorker;
 };
 
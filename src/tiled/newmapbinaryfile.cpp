@@ -1,26 +1,61 @@
 #include "newmapbinaryfile.h"
 
+#include "jobscheduler.h"
 #include "mapcomposite.h"
 #include "mapmanager.h"
 #include "tilesetmanager.h"
 #include "tilemetainfomgr.h"
 
 #include "gidmapper.h"
+#include "lotfilewriter.h"
 #include "mapobject.h"
 #include "objectgroup.h"
 #include "tile.h"
 #include "tileset.h"
 
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QThread>
 #include <qmath.h>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
 
-NewMapBinaryFile::NewMapBinaryFile()
+Q_STATIC_ASSERT(CHUNK_WIDTH == LotSquareGrid::ChunkWidth && CHUNK_HEIGHT == LotSquareGrid::ChunkHeight);
+
+// The rows of one level that one FlattenTask gathers the tiles of, and the
+// tiles it found, in the order they are added to the grid.
+struct NewMapBinaryFile::FlattenBand
+{
+    CompositeLayerGroup *layerGroup;
+    QRect bounds;
+    QSize mapSize;
+    const QBitArray *reused;
+    Tile *missingTile;
+    QVector<QPair<int,uint>> tiles;
+};
+
+NewMapBinaryFile::NewMapBinaryFile() :
+    mIncremental(false),
+    mAtomicWrite(true),
+    mMaxThreadCount(qMax(1, QThread::idealThreadCount())),
+    mHasDirtyRegion(false)
 {
 
 }
 
+void NewMapBinaryFile::setMaxThreadCount(int count)
+{
+    mMaxThreadCount = qMax(1, count);
+}
+
+void NewMapBinaryFile::setDirtyRegion(const QRegion &region)
+{
+    mDirtyRegion = region;
+    mHasDirtyRegion = true;
+}
+
 bool NewMapBinaryFile::write(MapComposite *mapComposite, const QString &filePath)
 {
     MapInfo* mapInfo = mapComposite->mapInfo();
@@ -62,87 +97,204 @@ bool NewMapBinaryFile::write(MapComposite *mapComposite, const QString &filePath
     int NUM_CHUNKS_Y = (mapInfo->height() + CHUNK_HEIGHT - 1) / CHUNK_HEIGHT;
 
     // Resize the grid and cleanup data from the previous cell.
-    mGridData.resize(NUM_CHUNKS_X * CHUNK_WIDTH);
-    for (int x = 0; x < NUM_CHUNKS_X * CHUNK_WIDTH; x++) {
-        mGridData[x].resize(NUM_CHUNKS_Y * CHUNK_HEIGHT);
-        for (int y = 0; y < NUM_CHUNKS_Y * CHUNK_HEIGHT; y++) {
-            mGridData[x][y].fill(LotFile::Square(), MaxLevel);
+    mGrid.reset(NUM_CHUNKS_X, NUM_CHUNKS_Y, MaxLevel);
+
+    // Find the chunks that can be taken from the previous export.  Their
+    // squares are decoded into mGrid, since the header needs to know every
+    // tile used and the room objects.
+    const QString manifestPath = filePath + QLatin1String(".manifest");
+    LotFile::Manifest manifest;
+    QVector<QByteArray> keys;
+    QByteArray oldData;
+    QBitArray reused(NUM_CHUNKS_X * NUM_CHUNKS_Y);
+    if (mIncremental) {
+        keys = chunkKeys(mapComposite, NUM_CHUNKS_X, NUM_CHUNKS_Y);
+        QFile oldFile(filePath);
+        if (manifest.read(manifestPath) && oldFile.open(QIODevice::ReadOnly)
+                && oldFile.size() == manifest.fileSize
+                && manifest.chunksX == NUM_CHUNKS_X && manifest.chunksY == NUM_CHUNKS_Y
+                && manifest.levels == MaxLevel) {
+            oldData = oldFile.readAll();
+            QHash<QString,uint> nameToGid;
+            for (auto it = mTileMap.constBegin(); it != mTileMap.constEnd(); ++it)
+                nameToGid.insert(it.value()->name, it.key());
+            QVector<uint> idToGid;
+            idToGid.reserve(manifest.tileNames.size());
+            for (const QString &name : qAsConst(manifest.tileNames))
+                idToGid += nameToGid.value(name, LotSquareGrid::InvalidGid);
+            for (int cy = 0; cy < NUM_CHUNKS_Y; cy++) {
+                for (int cx = 0; cx < NUM_CHUNKS_X; cx++) {
+                    int m = cx + cy * NUM_CHUNKS_X;
+                    if (manifest.chunkKeys[m] != keys[m])
+                        continue;
+                    if (mHasDirtyRegion && mDirtyRegion.intersects(
+                                QRect(cx * CHUNK_WIDTH, cy * CHUNK_HEIGHT, CHUNK_WIDTH, CHUNK_HEIGHT)))
+                        continue;
+                    if (reuseChunk(manifest, oldData, idToGid, cx, cy))
+                        reused.setBit(m);
+                }
+            }
         }
     }
 
-    Tile *missingTile = Tiled::Internal::TilesetManager::instance()->missingTile();
-    QVector<const Tiled::Cell *> cells(40);
+    // Every level is cut into bands of rows.  The bands are flattened in
+    // parallel into lists of their own, which are then added to the grid in
+    // order.  prepareDrawing2() changes the layer groups, so it runs here
+    // before any of the bands.
+    const bool isometric = mapInfo->orientation() == Map::Isometric;
+    const int bandHeight = CHUNK_HEIGHT * 4;
+    QList<FlattenBand> bands;
     for (CompositeLayerGroup *lg : mapComposite->layerGroups()) {
         lg->prepareDrawing2();
-        int d = (mapInfo->orientation() == Map::Isometric) ? -3 : 0;
-        d *= lg->level();
-        for (int y = d; y < mapHeight; y++) {
-            for (int x = d; x < mapWidth; x++) {
-                cells.resize(0);
-                lg->orderedCellsAt2(QPoint(x, y), cells);
-                for (const Tiled::Cell *cell : cells) {
-                    if (cell->tile == missingTile) continue;
-                    int lx = x, ly = y;
-                    if (mapInfo->orientation() == Map::Isometric) {
-                        lx = x + lg->level() * 3;
-                        ly = y + lg->level() * 3;
-                    }
-                    if (lx >= mapWidth) continue;
-                    if (ly >= mapHeight) continue;
-                    LotFile::Entry *e = new LotFile::Entry(cellToGid(cell));
-                    mGridData[lx][ly][lg->level()].Entries.append(e);
-                    mTileMap[e->gid]->used = true;
-                }
-            }
+        const int d = isometric ? -3 * lg->level() : 0;
+        for (int top = d; top < mapHeight; top += bandHeight) {
+            FlattenBand band;
+            band.layerGroup = lg;
+            band.bounds = QRect(d, top, mapWidth - d, qMin(bandHeight, mapHeight - top));
+            band.mapSize = QSize(mapWidth, mapHeight);
+            band.reused = &reused;
+            band.missingTile = Tiled::Internal::TilesetManager::instance()->missingTile();
+            bands += band;
         }
     }
 
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly /*| QIODevice::Text*/)) {
-        mError = tr("Could not open file for writing.");
-        return false;
+    if (mMaxThreadCount > 1 && bands.size() > 1) {
+        QVector<JobScheduler::Function> work;
+        for (FlattenBand &band : bands) {
+            FlattenBand *b = &band;
+            work += [this, b]() { flattenBand(*b); };
+        }
+        JobScheduler::instance()->runAll(work);
+    } else {
+        for (FlattenBand &band : bands)
+            flattenBand(band);
     }
 
-    QDataStream out(&file);
-    out.setByteOrder(QDataStream::LittleEndian);
+    for (const FlattenBand &band : qAsConst(bands)) {
+        for (const QPair<int,uint> &tile : band.tiles) {
+            mGrid.addTile(tile.first, tile.second);
+            mTileMap[tile.second]->used = true;
+        }
+    }
+    bands.clear();
 
     generateBuildingObjects(mapWidth, mapHeight);
 
-    if (!generateHeaderAux(out, mapComposite))
-        return false;
+    mStats.gridBytes = mGrid.bytesAllocated();
 
-    qint64 chunkTablePosition = file.pos();
-
-//    out << qint32(NUM_CHUNKS_X * NUM_CHUNKS_Y);
-    for (int m = 0; m < NUM_CHUNKS_X * NUM_CHUNKS_Y; m++) {
-        out << qint64(m);
+    // The whole file is built in memory, then written with a few large
+    // writes: the header, the chunk table, and the chunk data.
+    QByteArray header;
+    {
+        QDataStream out(&header, QIODevice::WriteOnly);
+        out.setByteOrder(QDataStream::LittleEndian);
+        if (!generateHeaderAux(out, mapComposite))
+            return false;
     }
 
-    QList<qint64> PositionMap;
-
-    for (int y = 0; y < NUM_CHUNKS_Y; y++) {
-        for (int x = 0; x < NUM_CHUNKS_X; x++) {
-            PositionMap += file.pos();
-            if (!generateChunk(out, mapComposite, x, y))
-                return false;
+    // Reused chunks can be copied as-is when the tile IDs and room IDs they
+    // refer to are the same as last time.
+    QStringList tileNames;
+    for (LotFile::Tile *tile : mTileMap) {
+        if (tile->used)
+            tileNames += tile->name;
+    }
+    const QByteArray rooms = roomsKey();
+    const bool copyReused = (manifest.tileNames == tileNames) && (manifest.roomsKey == rooms);
+
+    // encodeChunk() looks up every tile, avoid the QMap for that.
+    mGidToId.fill(-1, int(mTileMap.lastKey()) + 1);
+    for (auto it = mTileMap.constBegin(); it != mTileMap.constEnd(); ++it)
+        mGidToId[int(it.key())] = it.value()->id;
+
+    const int chunkCount = NUM_CHUNKS_X * NUM_CHUNKS_Y;
+    const qint64 dataPosition = header.size() + chunkCount * qint64(sizeof(qint64));
+    QVector<qint64> PositionMap;
+    PositionMap.reserve(chunkCount + 1);
+
+    QByteArray chunkData;
+    chunkData.reserve(oldData.isEmpty() ? chunkCount * 1024 : oldData.size());
+    {
+        QDataStream out(&chunkData, QIODevice::WriteOnly);
+        out.setByteOrder(QDataStream::LittleEndian);
+        for (int y = 0; y < NUM_CHUNKS_Y; y++) {
+            for (int x = 0; x < NUM_CHUNKS_X; x++) {
+                PositionMap += dataPosition + chunkData.size();
+                int m = x + y * NUM_CHUNKS_X;
+                if (reused.testBit(m) && copyReused) {
+                    qint64 pos = manifest.chunkPositions[m];
+                    qint64 size = manifest.chunkPositions[m + 1] - pos;
+                    out.writeRawData(oldData.constData() + pos, int(size));
+                    ++mStats.chunksCopied;
+                    continue;
+                }
+                mGrid.encodeChunk(out, x, y, mGidToId);
+            }
         }
     }
-
-    file.close();
-    if (!file.open(QIODevice::ReadWrite | QIODevice::Append)) {
-        mError = tr("Could not open file for writing.");
+    PositionMap += dataPosition + chunkData.size();
+
+    QByteArray chunkTable;
+    {
+        QDataStream out(&chunkTable, QIODevice::WriteOnly);
+        out.setByteOrder(QDataStream::LittleEndian);
+        LotFileWriter::writeChunkTable(out, PositionMap.mid(0, chunkCount));
+    }
+
+    // A manifest left behind by a failed export would describe the wrong file.
+    if (mIncremental)
+        QFile::remove(manifestPath);
+
+    // With QSaveFile the data goes to a temporary file that replaces the
+    // target only once everything was written, so a failed or interrupted
+    // export leaves the previous file alone.
+    QScopedPointer<QFileDevice> file;
+    if (mAtomicWrite)
+        file.reset(new QSaveFile(filePath));
+    else
+        file.reset(new QFile(filePath));
+    if (!file->open(QIODevice::WriteOnly)) {
+        mError = tr("Could not open file for writing.\n%1").arg(file->errorString());
         return false;
     }
-    file.seek(chunkTablePosition);
-
-    QDataStream out2(&file);
-    out2.setByteOrder(QDataStream::LittleEndian);
-
-    for (int m = 0; m < NUM_CHUNKS_X * NUM_CHUNKS_Y; m++) {
-        out2 << qint64(PositionMap[m]);
+    if (file->write(header) != header.size()
+            || file->write(chunkTable) != chunkTable.size()
+            || file->write(chunkData) != chunkData.size()) {
+        mError = tr("Error writing to file.\n%1").arg(file->errorString());
+        if (!mAtomicWrite)
+            file->close();
+        return false;
+    }
+    if (mAtomicWrite) {
+        if (!static_cast<QSaveFile*>(file.data())->commit()) {
+            mError = tr("Error writing to file.\n%1").arg(file->errorString());
+            return false;
+        }
+    } else {
+        file->close();
+        if (file->error() != QFileDevice::NoError) {
+            mError = tr("Error writing to file.\n%1").arg(file->errorString());
+            return false;
+        }
     }
 
-    file.close();
+    mStats.chunksReused = reused.count(true);
+    mStats.chunksGenerated = NUM_CHUNKS_X * NUM_CHUNKS_Y - mStats.chunksReused;
+
+    if (mIncremental) {
+        manifest.fileSize = QFileInfo(filePath).size();
+        manifest.chunksX = NUM_CHUNKS_X;
+        manifest.chunksY = NUM_CHUNKS_Y;
+        manifest.levels = MaxLevel;
+        manifest.roomsKey = rooms;
+        manifest.tileNames = tileNames;
+        manifest.chunkKeys = keys;
+        manifest.chunkPositions = PositionMap;
+        if (!manifest.write(manifestPath)) {
+            // Not fatal, the next export just won't be incremental.
+            QFile::remove(manifestPath);
+        }
+    }
 #if 0
     Navigate::ChunkDataFile cdf;
     cdf.fromMap(cell->x(), cell->y(), mapComposite, mRoomRectByLevel[0], lotSettings);
@@ -181,7 +333,8 @@ bool NewMapBinaryFile::generateHeader(MapComposite *mapComposite)
     mTileMap.clear();
     mTileMap[0] = new LotFile::Tile;
 
-    mTilesetToFirstGid.clear();
+    mGidMapper.clear();
+    mTilesetNameToFirstGid.clear();
     uint firstGid = 1;
     for (Tileset *tileset : tilesets) {
         if (!handleTileset(tileset, firstGid)) {
@@ -291,64 +444,49 @@ bool NewMapBinaryFile::generateHeaderAux(QDataStream &out, MapComposite *mapComp
 //        return false;
 //    }
 
-    out << quint8('P') << quint8('Z') << quint8('B') << quint8('Y');
     Version = 0;
-    out << qint32(Version);
 
-    int tilecount = 0;
+    QStringList tileNames;
     for (LotFile::Tile *tile : mTileMap) {
         if (tile->used) {
-            tile->id = tilecount;
-            tilecount++;
+            tile->id = tileNames.size();
+            tileNames += tile->name;
 //            if (tile->name.startsWith(QLatin1String("jumbo_tree_01"))) {
 //                int nnn = 0;
 //            }
         }
     }
-    out << qint32(tilecount);
-
-    for (LotFile::Tile *tile : mTileMap) {
-        if (tile->used) {
-            SaveString(out, tile->name);
-        }
-    }
 
     MapInfo* mapInfo = mapComposite->mapInfo();
     int NUM_CHUNKS_X = (mapInfo->width() + CHUNK_WIDTH - 1) / CHUNK_WIDTH;
     int NUM_CHUNKS_Y = (mapInfo->height() + CHUNK_WIDTH - 1) / CHUNK_WIDTH;
 
-    out << qint32(NUM_CHUNKS_X);
-    out << qint32(NUM_CHUNKS_Y);
-    out << qint32(MaxLevel);
-
-    out << qint32(roomList.count());
+    QVector<LotFileReader::Room> rooms;
+    rooms.reserve(roomList.size());
     for (LotFile::Room *room : roomList) {
-        SaveString(out, room->name);
-        out << qint32(room->floor);
-
-        out << qint32(room->rects.size());
-        for (LotFile::RoomRect *rr : room->rects) {
-            out << qint32(rr->x);
-            out << qint32(rr->y);
-            out << qint32(rr->w);
-            out << qint32(rr->h);
-        }
-
-        out << qint32(room->objects.size());
+        LotFileReader::Room r;
+        r.name = room->name;
+        r.level = room->floor;
+        for (LotFile::RoomRect *rr : room->rects)
+            r.rects += QRect(rr->x, rr->y, rr->w, rr->h);
         for (const LotFile::RoomObject &object : room->objects) {
-            out << qint32(object.metaEnum);
-            out << qint32(object.x);
-            out << qint32(object.y);
+            LotFileReader::RoomObject o = { object.metaEnum, object.x, object.y };
+            r.objects += o;
         }
+        rooms += r;
     }
 
-    out << qint32(buildingList.count());
+    QVector<QVector<int>> buildings;
+    buildings.reserve(buildingList.size());
     for (LotFile::Building *building : buildingList) {
-        out << qint32(building->RoomList.count());
-        for (LotFile::Room *room : building->RoomList) {
-            out << qint32(room->ID);
-        }
+        QVector<int> roomIDs;
+        for (LotFile::Room *room : building->RoomList)
+            roomIDs += room->ID;
+        buildings += roomIDs;
     }
+
+    LotFileWriter::writeHeader(out, tileNames, NUM_CHUNKS_X, NUM_CHUNKS_Y, MaxLevel,
+                               rooms, buildings);
 /*
     for (int x = 0; x < 30; x++) {
         for (int y = 0; y < 30; y++) {
@@ -362,41 +500,108 @@ bool NewMapBinaryFile::generateHeaderAux(QDataStream &out, MapComposite *mapComp
     return true;
 }
 
-bool NewMapBinaryFile::generateChunk(QDataStream &out, MapComposite *mapComposite, int cx, int cy)
+static void writeFileKey(QDataStream &out, const QString &filePath)
 {
-    Q_UNUSED(mapComposite)
+    const QFileInfo info(filePath);
+    out << filePath << (info.exists() ? info.lastModified().toMSecsSinceEpoch() : qint64(0));
+}
 
-    int notdonecount = 0;
-    for (int z = 0; z < MaxLevel; z++)  {
-        for (int x = 0; x < CHUNK_WIDTH; x++) {
-            for (int y = 0; y < CHUNK_HEIGHT; y++) {
-                int gx = cx * CHUNK_WIDTH + x;
-                int gy = cy * CHUNK_HEIGHT + y;
-                const QList<LotFile::Entry*> &entries = mGridData[gx][gy][z].Entries;
-                if (entries.count() == 0) {
-                    notdonecount++;
-                } else {
-                    if (notdonecount > 0) {
-                        out << qint32(-1);
-                        out << qint32(notdonecount);
-                    }
-                    notdonecount = 0;
-                    out << qint32(entries.count() + 1);
-                    out << qint32(getRoomID(gx, gy, z));
-                }
-                for (LotFile::Entry *entry : entries) {
-                    Q_ASSERT(mTileMap[entry->gid]);
-                    Q_ASSERT(mTileMap[entry->gid]->id != -1);
-                    out << qint32(mTileMap[entry->gid]->id);
-                }
+// A chunk's key is a hash of every map that could put tiles in it.  Tiles
+// on isometric levels are shifted 3 squares per level, so the maps' bounds
+// are padded by that much.  Each map's key includes the BMP rules and
+// blends files its blends are made from, and every chunk depends on the
+// tile properties in Tilesets.txt.
+QVector<QByteArray> NewMapBinaryFile::chunkKeys(MapComposite *mapComposite, int chunksX, int chunksY)
+{
+    QByteArray tilesKey;
+    {
+        QDataStream out(&tilesKey, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        writeFileKey(out, TileMetaInfoMgr::instance()->txtPath());
+    }
+
+    QList<QRect> bounds;
+    QList<QByteArray> mapKeys;
+    const int pad = 3 * MaxLevel;
+    for (MapComposite *mc : mapComposite->maps()) {
+        QByteArray key;
+        QDataStream out(&key, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        out << mc->mapInfo()->path() << mc->originRecursive() << qint32(mc->levelRecursive())
+            << mc->map()->size() << qint32(mc->map()->orientation());
+        // The top-level map may be edited but not saved, its edits are
+        // given by the dirty region instead.
+        if (!(mc == mapComposite && mHasDirtyRegion))
+            out << QFileInfo(mc->mapInfo()->path()).lastModified().toMSecsSinceEpoch();
+        writeFileKey(out, mc->map()->bmpSettings()->rulesFile());
+        writeFileKey(out, mc->map()->bmpSettings()->blendsFile());
+        mapKeys += key;
+        bounds += QRect(mc->originRecursive(), mc->map()->size()).adjusted(-pad, -pad, pad, pad);
+    }
+
+    QVector<QByteArray> keys(chunksX * chunksY);
+    for (int cy = 0; cy < chunksY; cy++) {
+        for (int cx = 0; cx < chunksX; cx++) {
+            const QRect chunkBounds(cx * CHUNK_WIDTH, cy * CHUNK_HEIGHT, CHUNK_WIDTH, CHUNK_HEIGHT);
+            QCryptographicHash hash(QCryptographicHash::Md5);
+            hash.addData(tilesKey);
+            for (int i = 0; i < mapKeys.size(); i++) {
+                if (bounds[i].intersects(chunkBounds))
+                    hash.addData(mapKeys[i]);
             }
+            keys[cx + cy * chunksX] = hash.result();
         }
     }
-    if (notdonecount > 0) {
-        out << qint32(-1);
-        out << qint32(notdonecount);
+    return keys;
+}
+
+// Room IDs are stored in the chunks, so reused chunks can only be copied
+// when the rooms are unchanged.
+QByteArray NewMapBinaryFile::roomsKey() const
+{
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    for (LotFile::Room *room : roomList) {
+        out << qint32(room->ID) << qint32(room->floor);
+        for (LotFile::RoomRect *rr : room->rects)
+            out << rr->bounds();
     }
+    hash.addData(data);
+    return hash.result();
+}
+
+// Decodes a chunk written by encodeChunk() in the previous export into
+// mGrid.  Fails if a tile it uses no longer exists, in which case the
+// chunk is generated as usual.
+bool NewMapBinaryFile::reuseChunk(const LotFile::Manifest &manifest, const QByteArray &oldData,
+                                  const QVector<uint> &idToGid, int cx, int cy)
+{
+    const int m = cx + cy * manifest.chunksX;
+    const qint64 pos = manifest.chunkPositions[m];
+    const qint64 end = manifest.chunkPositions[m + 1];
+    if (pos < 0 || end < pos || end > oldData.size())
+        return false;
+
+    QDataStream in(QByteArray::fromRawData(oldData.constData() + pos, int(end - pos)));
+    in.setByteOrder(QDataStream::LittleEndian);
+    if (!mGrid.decodeChunk(in, cx, cy, idToGid))
+        return false;
 
+    // The room IDs are set again by generateBuildingObjects(), the rooms
+    // may have changed since the old file was written.
+    for (int z = 0; z < MaxLevel; z++) {
+        for (int x = 0; x < CHUNK_WIDTH; x++) {
+            for (int y = 0; y < CHUNK_HEIGHT; y++) {
+                const int index = mGrid.index(cx * CHUNK_WIDTH + x, cy * CHUNK_HEIGHT + y, z);
+                mGrid.setRoomID(index, -1);
+                const uint *gids = mGrid.tiles(index);
+                for (int i = 0; i < mGrid.count(index); i++)
+                    mTileMap[gids[i]]->used = true;
+            }
+        }
+    }
     return true;
 }
 
@@ -416,12 +621,14 @@ void NewMapBinaryFile::generateBuildingObjects(int mapWidth, int mapHeight,
         for (int y = rr->y; y < rr->y + rr->h; y++) {
 
             // Remember the room at each position in the map.
-            mGridData[x][y][room->floor].roomID = room->ID;
+            int index = mGrid.index(x, y, room->floor);
+            mGrid.setRoomID(index, room->ID);
 
             /* Examine every tile inside the room.  If the tile's metaEnum >= 0
                then create a new RoomObject for it. */
-            for (LotFile::Entry *entry : mGridData[x][y][room->floor].Entries) {
-                int metaEnum = mTileMap[entry->gid]->metaEnum;
+            const uint *gids = mGrid.tiles(index);
+            for (int i = 0; i < mGrid.count(index); i++) {
+                int metaEnum = mTileMap[gids[i]]->metaEnum;
                 if (metaEnum >= 0) {
                     LotFile::RoomObject object;
                     object.x = x;
@@ -438,8 +645,10 @@ void NewMapBinaryFile::generateBuildingObjects(int mapWidth, int mapHeight,
     int y = rr->y + rr->h;
     if (y < mapHeight) {
         for (int x = rr->x; x < rr->x + rr->w; x++) {
-            for (LotFile::Entry *entry : mGridData[x][y][room->floor].Entries) {
-                int metaEnum = mTileMap[entry->gid]->metaEnum;
+            int index = mGrid.index(x, y, room->floor);
+            const uint *gids = mGrid.tiles(index);
+            for (int i = 0; i < mGrid.count(index); i++) {
+                int metaEnum = mTileMap[gids[i]]->metaEnum;
                 if (metaEnum >= 0 && TileMetaInfoMgr::instance()->isEnumNorth(metaEnum)) {
                     LotFile::RoomObject object;
                     object.x = x;
@@ -456,8 +665,10 @@ void NewMapBinaryFile::generateBuildingObjects(int mapWidth, int mapHeight,
     int x = rr->x + rr->w;
     if (x < mapWidth) {
         for (int y = rr->y; y < rr->y + rr->h; y++) {
-            for (LotFile::Entry *entry : mGridData[x][y][room->floor].Entries) {
-                int metaEnum = mTileMap[entry->gid]->metaEnum;
+            int index = mGrid.index(x, y, room->floor);
+            const uint *gids = mGrid.tiles(index);
+            for (int i = 0; i < mGrid.count(index); i++) {
+                int metaEnum = mTileMap[gids[i]]->metaEnum;
                 if (metaEnum >= 0 && TileMetaInfoMgr::instance()->isEnumWest(metaEnum)) {
                     LotFile::RoomObject object;
                     object.x = x - 1;
@@ -481,7 +692,7 @@ QString NewMapBinaryFile::nameOfTileset(const Tileset *tileset)
     return name;
 }
 
-bool NewMapBinaryFile::handleTileset(const Tiled::Tileset *tileset, uint &firstGid)
+bool NewMapBinaryFile::handleTileset(Tiled::Tileset *tileset, uint &firstGid)
 {
     if (!tileset->fileName().isEmpty()) {
         mError = tr("Only tileset image files supported, not external tilesets");
@@ -492,15 +703,10 @@ bool NewMapBinaryFile::handleTileset(const Tiled::Tileset *tileset, uint &firstG
 
     // TODO: Verify that two tilesets sharing the same name are identical
     // between maps.
-    QMap<const Tileset*,uint>::const_iterator i = mTilesetToFirstGid.begin();
-    QMap<const Tileset*,uint>::const_iterator i_end = mTilesetToFirstGid.end();
-    while (i != i_end) {
-        QString name2 = nameOfTileset(i.key());
-        if (name == name2) {
-            mTilesetToFirstGid.insert(tileset, i.value());
-            return true;
-        }
-        ++i;
+    QHash<QString,uint>::const_iterator it = mTilesetNameToFirstGid.find(name);
+    if (it != mTilesetNameToFirstGid.end()) {
+        mGidMapper.insert(it.value(), tileset);
+        return true;
     }
 
     for (int i = 0; i < tileset->tileCount(); ++i) {
@@ -511,7 +717,8 @@ bool NewMapBinaryFile::handleTileset(const Tiled::Tileset *tileset, uint &firstG
         mTileMap[ID] = tile;
     }
 
-    mTilesetToFirstGid.insert(tileset, firstGid);
+    mGidMapper.insert(firstGid, tileset);
+    mTilesetNameToFirstGid.insert(name, firstGid);
     firstGid += uint(tileset->tileCount());
 
     return true;
@@ -519,22 +726,46 @@ bool NewMapBinaryFile::handleTileset(const Tiled::Tileset *tileset, uint &firstG
 
 int NewMapBinaryFile::getRoomID(int x, int y, int z)
 {
-    return mGridData[x][y][z].roomID;
+    return mGrid.roomID(mGrid.index(x, y, z));
 }
 
-uint NewMapBinaryFile::cellToGid(const Cell *cell)
+uint NewMapBinaryFile::cellToGid(const Cell *cell) const
 {
-    Tileset *tileset = cell->tile->tileset();
+    // Flip flags aren't stored in .lotpack files.
+    return mGidMapper.cellToGid(Cell(cell->tile));
+}
 
-    QMap<const Tileset*,uint>::const_iterator i = mTilesetToFirstGid.begin();
-    QMap<const Tileset*,uint>::const_iterator i_end = mTilesetToFirstGid.end();
-    while (i != i_end && i.key() != tileset) {
-        ++i;
-    }
-    if (i == i_end) {// tileset not found
-        return 0;
+// Called by the FlattenTasks.  Only reads the layer groups, the grid and
+// the gid mapper.
+void NewMapBinaryFile::flattenBand(FlattenBand &band) const
+{
+    const CompositeLayerGroup *lg = band.layerGroup;
+    const QRect &bounds = band.bounds;
+    const int level = lg->level();
+    const int d = bounds.left();
+    QBitArray nonEmpty;
+    lg->nonEmptyCells2(bounds, nonEmpty);
+    QVector<const Tiled::Cell *> cells(40);
+    for (int y = bounds.top(); y <= bounds.bottom(); y++) {
+        for (int x = bounds.left(); x <= bounds.right(); x++) {
+            if (!nonEmpty.testBit((y - bounds.top()) * bounds.width() + (x - bounds.left())))
+                continue;
+            // For isometric maps, d is -3 * level and the level's tiles
+            // are offset by 3 * level.
+            const int lx = x - d, ly = y - d;
+            if (lx >= band.mapSize.width()) continue;
+            if (ly >= band.mapSize.height()) continue;
+            if (band.reused->testBit(lx / CHUNK_WIDTH + (ly / CHUNK_HEIGHT) * mGrid.chunksX()))
+                continue;
+            cells.resize(0);
+            lg->orderedCellsAt2(QPoint(x, y), cells);
+            const int index = mGrid.index(lx, ly, level);
+            for (const Tiled::Cell *cell : cells) {
+                if (cell->tile == band.missingTile) continue;
+                band.tiles += qMakePair(index, cellToGid(cell));
+            }
+        }
     }
-    return i.value() + uint(cell->tile->id());
 }
 
 bool NewMapBinaryFile::processObjectGroups(MapComposite *mapComposite)
@@ -614,11 +845,49 @@ bool NewMapBinaryFile::processObjectGroup(ObjectGroup *objectGroup, int levelOff
     return true;
 }
 
-void NewMapBinaryFile::SaveString(QDataStream& out, const QString& str)
+/////
+
+bool LotFile::Manifest::read(const QString &fileName)
 {
-    for (int i = 0; i < str.length(); i++) {
-        if (str[i].toLatin1() == '\n') continue;
-        out << quint8(str[i].toLatin1());
-    }
-    out << quint8('\n');
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint8 p, z, c, m;
+    qint32 version;
+    in >> p >> z >> c >> m >> version;
+    if (p != 'P' || z != 'Z' || c != 'C' || m != 'M' || version != 1)
+        return false;
+
+    qint32 chunksX, chunksY, levels;
+    in >> fileSize >> chunksX >> chunksY >> levels;
+    this->chunksX = chunksX;
+    this->chunksY = chunksY;
+    this->levels = levels;
+    in >> roomsKey >> tileNames >> chunkKeys >> chunkPositions;
+
+    return in.status() == QDataStream::Ok
+            && chunkKeys.size() == chunksX * chunksY
+            && chunkPositions.size() == chunksX * chunksY + 1;
+}
+
+bool LotFile::Manifest::write(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setVersion(QDataStream::Qt_5_0);
+
+    out << quint8('P') << quint8('Z') << quint8('C') << quint8('M') << qint32(1);
+    out << fileSize << qint32(chunksX) << qint32(chunksY) << qint32(levels);
+    out << roomsKey << tileNames << chunkKeys << chunkPositions;
+
+    return out.status() == QDataStream::Ok;
 }
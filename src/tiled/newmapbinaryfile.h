@@ -1,10 +1,16 @@
 #ifndef TMXBINARY_H
 #define TMXBINARY_H
 
+#include "gidmapper.h"
+#include "lotsquaregrid.h"
+
+#include <QHash>
 #include <QMap>
 #include <QObject>
 #include <QRect>
+#include <QRegion>
 #include <QString>
+#include <QStringList>
 #include <QVector>
 
 class MapComposite;
@@ -55,41 +61,6 @@ public:
     int h;
 };
 
-class Entry
-{
-public:
-    Entry(uint gid) :
-        gid(gid)
-    {
-    }
-
-    uint gid;
-};
-
-class Square
-{
-public:
-    Square() :
-        roomID(-1)
-    {
-
-    }
-    ~Square()
-    {
-        qDeleteAll(Entries);
-    }
-    Square &operator=(const Square &other)
-    {
-        qDeleteAll(Entries);
-        Entries = other.Entries;
-        roomID = other.roomID;
-        return *this;
-    }
-
-    QList<Entry*> Entries;
-    int roomID;
-};
-
 class Zone
 {
 public:
@@ -225,6 +196,35 @@ public:
     QList<Room*> RoomList;
 };
 
+/**
+ * Written next to a .pzby file by an incremental export, as <file>.manifest.
+ * It remembers what each chunk was generated from, so the next export of
+ * the same cell can take unchanged chunks from the old file.
+ */
+class Manifest
+{
+public:
+    Manifest() :
+        fileSize(0),
+        chunksX(0),
+        chunksY(0),
+        levels(0)
+    {
+    }
+
+    bool read(const QString &fileName);
+    bool write(const QString &fileName) const;
+
+    qint64 fileSize; // of the .pzby, to notice it was replaced
+    int chunksX;
+    int chunksY;
+    int levels;
+    QByteArray roomsKey;
+    QStringList tileNames; // the .pzby's table of used tiles
+    QVector<QByteArray> chunkKeys;
+    QVector<qint64> chunkPositions; // plus the end of the last chunk
+};
+
 class Stats
 {
 public:
@@ -232,7 +232,11 @@ public:
         numBuildings(0),
         numRooms(0),
         numRoomRects(0),
-        numRoomObjects(0)
+        numRoomObjects(0),
+        gridBytes(0),
+        chunksGenerated(0),
+        chunksReused(0),
+        chunksCopied(0)
     {
     }
 
@@ -240,6 +244,10 @@ public:
     int numRooms;
     int numRoomRects;
     int numRoomObjects;
+    qint64 gridBytes;
+    int chunksGenerated; // scanned from the map
+    int chunksReused; // decoded from the previous export
+    int chunksCopied; // reused and written byte-for-byte
 };
 
 } // namespace LotFile
@@ -252,34 +260,80 @@ public:
 
     bool write(MapComposite* mapComposite, const QString& filePath);
 
+    /**
+     * When set, write() keeps a manifest of per-chunk hashes next to the
+     * .pzby file.  On the next export, chunks whose source maps haven't
+     * changed are taken from the old file instead of being generated.
+     * A chunk's sources are every map in MapComposite::maps() that overlaps
+     * it, compared by path, modification time, position and level.
+     */
+    void setIncremental(bool incremental) { mIncremental = incremental; }
+
+    /**
+     * For exports from a MapDocument whose map may not be saved: the part
+     * of the top-level map that was edited since it was last exported to
+     * the same file, in .pzby coordinates.  When set, chunks overlapping
+     * \a region are dirty, and the top-level map's modification time is
+     * ignored.
+     */
+    void setDirtyRegion(const QRegion &region);
+
+    /**
+     * When set, which is the default, write() writes to a temporary file and
+     * renames it over \a filePath once it is complete.
+     */
+    void setAtomicWrite(bool atomic) { mAtomicWrite = atomic; }
+
+    /**
+     * When more than 1, the tiles of the levels are gathered in bands of rows
+     * on the JobScheduler's threads.  Defaults to
+     * QThread::idealThreadCount().  Use 1 when several files are written at
+     * once.
+     */
+    void setMaxThreadCount(int count);
+
     bool generateHeader(MapComposite *mapComposite);
     bool generateHeaderAux(QDataStream& out, MapComposite *mapComposite);
-    bool generateChunk(QDataStream &out, MapComposite *mapComposite, int cx, int cy);
     void generateBuildingObjects(int mapWidth, int mapHeight);
     void generateBuildingObjects(int mapWidth, int mapHeight,
                                  LotFile::Room *room, LotFile::RoomRect *rr);
     QString nameOfTileset(const Tiled::Tileset *tileset);
-    bool handleTileset(const Tiled::Tileset *tileset, uint &firstGid);
+    bool handleTileset(Tiled::Tileset *tileset, uint &firstGid);
 
     int getRoomID(int x, int y, int z);
 
     QString errorString() const { return mError; }
 
+    const LotFile::Stats &stats() const { return mStats; }
+
 signals:
 
 private:
-    uint cellToGid(const Tiled::Cell *cell);
+    struct FlattenBand;
+
+    uint cellToGid(const Tiled::Cell *cell) const;
+    void flattenBand(FlattenBand &band) const;
     bool processObjectGroups(MapComposite *mapComposite);
     bool processObjectGroup(Tiled::ObjectGroup *objectGroup,
                             int levelOffset, const QPoint &offset);
-    void SaveString(QDataStream& out, const QString& str);
+    QVector<QByteArray> chunkKeys(MapComposite *mapComposite, int chunksX, int chunksY);
+    QByteArray roomsKey() const;
+    bool reuseChunk(const LotFile::Manifest &manifest, const QByteArray &oldData,
+                    const QVector<uint> &idToGid, int cx, int cy);
 
 private:
     QList<LotFile::Zone*> ZoneList;
-    QMap<const Tiled::Tileset*,uint> mTilesetToFirstGid;
+    Tiled::GidMapper mGidMapper;
+    QHash<QString,uint> mTilesetNameToFirstGid;
     Tiled::Tileset *mJumboTreeTileset;
     QMap<uint,LotFile::Tile*> mTileMap;
-    QVector<QVector<QVector<LotFile::Square> > > mGridData;
+    QVector<qint32> mGidToId;
+    Tiled::LotSquareGrid mGrid;
+    bool mIncremental;
+    bool mAtomicWrite;
+    int mMaxThreadCount;
+    bool mHasDirtyRegion;
+    QRegion mDirtyRegion;
     int MaxLevel;
     int Version;
     QList<LotFile::RoomRect*> mRoomRects;
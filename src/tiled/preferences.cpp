@@ -22,6 +22,7 @@
 
 #include "documentmanager.h"
 #include "languagemanager.h"
+#include "mapmanager.h"
 #include "tilesetmanager.h"
 #ifdef ZOMBOID
 #include "zprogress.h"
@@ -65,6 +66,10 @@ Preferences::Preferences()
     mDtdEnabled = mSettings->value(QLatin1String("DtdEnabled")).toBool();
     mReloadTilesetsOnChange =
             mSettings->value(QLatin1String("ReloadTilesets"), true).toBool();
+    mUseMapBinaryCache =
+            mSettings->value(QLatin1String("MapBinaryCache"), false).toBool();
+    mUseTilesetBinaryCache =
+            mSettings->value(QLatin1String("TilesetBinaryCache"), true).toBool();
     mSettings->endGroup();
 
     // Retrieve interface settings
@@ -281,6 +286,40 @@ void Preferences::setReloadTilesetsOnChanged(bool value)
     tilesetManager->setReloadTilesetsOnChange(mReloadTilesetsOnChange);
 }
 
+bool Preferences::useMapBinaryCache() const
+{
+    return mUseMapBinaryCache;
+}
+
+void Preferences::setUseMapBinaryCache(bool value)
+{
+    if (mUseMapBinaryCache == value)
+        return;
+
+    mUseMapBinaryCache = value;
+    mSettings->setValue(QLatin1String("Storage/MapBinaryCache"),
+                        mUseMapBinaryCache);
+
+    MapManager::instance()->setUseBinaryCache(mUseMapBinaryCache);
+}
+
+bool Preferences::useTilesetBinaryCache() const
+{
+    return mUseTilesetBinaryCache;
+}
+
+void Preferences::setUseTilesetBinaryCache(bool value)
+{
+    if (mUseTilesetBinaryCache == value)
+        return;
+
+    mUseTilesetBinaryCache = value;
+    mSettings->setValue(QLatin1String("Storage/TilesetBinaryCache"),
+                        mUseTilesetBinaryCache);
+
+    TilesetManager::instance()->setUseBinaryCache(mUseTilesetBinaryCache);
+}
+
 void Preferences::setUseOpenGL(bool useOpenGL)
 {
     if (mUseOpenGL == useOpenGL)
@@ -63,6 +63,12 @@ public:
     bool reloadTilesetsOnChange() const;
     void setReloadTilesetsOnChanged(bool value);
 
+    bool useMapBinaryCache() const;
+    void setUseMapBinaryCache(bool value);
+
+    bool useTilesetBinaryCache() const;
+    void setUseTilesetBinaryCache(bool value);
+
     bool useOpenGL() const { return mUseOpenGL; }
     void setUseOpenGL(bool useOpenGL);
 
@@ -237,6 +243,8 @@ private:
     bool mDtdEnabled;
     QString mLanguage;
     bool mReloadTilesetsOnChange;
+    bool mUseMapBinaryCache;
+    bool mUseTilesetBinaryCache;
     bool mUseOpenGL;
     bool menableDarkTheme;
     ObjectTypes mObjectTypes;
@@ -411,6 +411,8 @@ void PreferencesDialog::fromPreferences()
 {
     const Preferences *prefs = Preferences::instance();
     mUi->reloadTilesetImages->setChecked(prefs->reloadTilesetsOnChange());
+    mUi->mapBinaryCache->setChecked(prefs->useMapBinaryCache());
+    mUi->tilesetBinaryCache->setChecked(prefs->useTilesetBinaryCache());
     mUi->enableDtd->setChecked(prefs->dtdEnabled());
     if (mUi->openGL->isEnabled())
         mUi->openGL->setChecked(prefs->useOpenGL());
@@ -466,6 +468,8 @@ void PreferencesDialog::toPreferences()
     Preferences *prefs = Preferences::instance();
 
     prefs->setReloadTilesetsOnChanged(mUi->reloadTilesetImages->isChecked());
+    prefs->setUseMapBinaryCache(mUi->mapBinaryCache->isChecked());
+    prefs->setUseTilesetBinaryCache(mUi->tilesetBinaryCache->isChecked());
     prefs->setDtdEnabled(mUi->enableDtd->isChecked());
     prefs->setLayerDataFormat(layerDataFormat());
     prefs->setAutomappingDrawing(mUi->autoMapWhileDrawing->isChecked());
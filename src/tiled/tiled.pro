@@ -99,6 +99,8 @@ SOURCES += aboutdialog.cpp \
     languagemanager.cpp \
     layerdock.cpp \
     layermodel.cpp \
+    jobscheduler.cpp \
+    jobpipeline.cpp \
     luatable.cpp \
     main.cpp \
     mainwindow.cpp \
@@ -215,7 +217,6 @@ SOURCES += aboutdialog.cpp \
     BuildingEditor/buildingorthoview.cpp \
     BuildingEditor/buildingisoview.cpp \
     BuildingEditor/choosetemplatesdialog.cpp \
-    threads.cpp \
     BuildingEditor/buildingtileentryview.cpp \
     bmptool.cpp \
     bmpblender.cpp \
@@ -231,6 +232,8 @@ SOURCES += aboutdialog.cpp \
     luaconsole.cpp \
     worldeddock.cpp \
     worldlottool.cpp \
+    worldlotexporter.cpp \
+    batchmode.cpp \
     BuildingEditor/buildingdocumentmgr.cpp \
     BuildingEditor/categorydock.cpp \
     BuildingEditor/imode.cpp \
@@ -248,6 +251,7 @@ SOURCES += aboutdialog.cpp \
     bmpblendview.cpp \
     luamapsdialog.cpp \
     luaworlddialog.cpp \
+    luaworldrunner.cpp \
     edgetool.cpp \
     edgetooldialog.cpp \
     curbtool.cpp \
@@ -316,6 +320,8 @@ HEADERS += aboutdialog.h \
     languagemanager.h \
     layerdock.h \
     layermodel.h \
+    jobscheduler.h \
+    jobpipeline.h \
     luatable.h \
     macsupport.h \
     mainwindow.h \
@@ -435,7 +441,6 @@ HEADERS += aboutdialog.h \
     BuildingEditor/buildingorthoview.h \
     BuildingEditor/buildingisoview.h \
     BuildingEditor/choosetemplatesdialog.h \
-    threads.h \
     BuildingEditor/buildingtileentryview.h \
     bmptool.h \
     bmpblender.h \
@@ -451,6 +456,8 @@ HEADERS += aboutdialog.h \
     luaconsole.h \
     worldeddock.h \
     worldlottool.h \
+    worldlotexporter.h \
+    batchmode.h \
     BuildingEditor/buildingdocumentmgr.h \
     BuildingEditor/categorydock.h \
     BuildingEditor/imode.h \
@@ -472,6 +479,7 @@ HEADERS += aboutdialog.h \
     bmpblendview.h \
     luamapsdialog.h \
     luaworlddialog.h \
+    luaworldrunner.h \
     edgetool.h \
     edgetooldialog.h \
     curbtool.h \
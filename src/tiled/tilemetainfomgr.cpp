@@ -27,6 +27,7 @@
 #include "tile.h"
 #include "tileset.h"
 
+#include <QCoreApplication>
 #include <QDir>
 #include <QImage>
 #include <QImageReader>
@@ -713,17 +714,19 @@ QString TileMetaInfoMgr::tileEnum(Tile *tile)
     if (!mTilesetInfo.contains(tilesetName))
         return QString();
     QString key = TilesetMetaInfo::key(tile);
-    TilesetMetaInfo *info = mTilesetInfo[tilesetName];
+    // Only const lookups here, NewMapBinaryFile calls this from several
+    // threads at once when exporting a world.
+    const TilesetMetaInfo *info = mTilesetInfo.value(tilesetName);
     if (!info->mInfo.contains(key))
         return QString();
-    return info->mInfo[key].mMetaGameEnum;
+    return info->mInfo.value(key).mMetaGameEnum;
 }
 
 int TileMetaInfoMgr::tileEnumValue(Tile *tile)
 {
     QString enumName = tileEnum(tile);
     if (!enumName.isEmpty())
-        return mEnums[enumName];
+        return mEnums.value(enumName);
     return -1;
 }
 
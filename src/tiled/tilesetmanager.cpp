@@ -22,16 +22,20 @@
 #include "tilesetmanager.h"
 
 #include "filesystemwatcher.h"
+#include "mainwindow.h"
 #include "tileset.h"
 
 #include <QImage>
 #ifdef ZOMBOID
 #include "preferences.h"
 #include "tile.h"
+#include "tilesetbinarycache.h"
+#include <QCoreApplication>
 #include <QDebug>
 #include <QDir>
 #include <QImageReader>
 #include <QMetaType>
+#include <QStandardPaths>
 #endif
 
 using namespace Tiled;
@@ -75,21 +79,8 @@ TilesetManager::TilesetManager():
     mNoBlendTile = mNoBlendTileset->tileAt(0);
     mTilesets.insert(mNoBlendTileset, 1); //addReference(mNoBlendTileset);
 
-    qRegisterMetaType<Tileset*>("Tileset*");
-
-    mImageReaderThreads.resize(8);
-    mImageReaderWorkers.resize(mImageReaderThreads.size());
-    mNextThreadForJob = 0;
-    for (int i = 0; i < mImageReaderWorkers.size(); i++) {
-        mImageReaderThreads[i] = new InterruptibleThread;
-        mImageReaderWorkers[i] = new TilesetImageReaderWorker(i, mImageReaderThreads[i]);
-        mImageReaderWorkers[i]->moveToThread(mImageReaderThreads[i]);
-        connect(mImageReaderWorkers[i], &TilesetImageReaderWorker::imageLoaded,
-                this, qOverload<Tiled::Tileset*,Tiled::Tileset*>(&TilesetManager::imageLoaded));
-        mImageReaderThreads[i]->start();
-    }
-
     mReloadTilesetsOnChange = Preferences::instance()->reloadTilesetsOnChange();
+    setUseBinaryCache(Preferences::instance()->useTilesetBinaryCache());
 #endif
 
     connect(mWatcher, &FileSystemWatcher::fileChanged,
@@ -107,13 +98,8 @@ TilesetManager::~TilesetManager()
 #ifdef ZOMBOID
     removeReference(mMissingTileset);
     removeReference(mNoBlendTileset);
-    for (int i = 0; i < mImageReaderThreads.size(); i++) {
-        mImageReaderThreads[i]->interrupt();
-        mImageReaderThreads[i]->quit();
-        mImageReaderThreads[i]->wait();
-        delete mImageReaderWorkers[i];
-        delete mImageReaderThreads[i];
-    }
+    mImageReaderToken.cancel();
+    JobScheduler::instance()->wait(mImageReaderToken);
 
     delete mTilesetImageCache;
 #endif
@@ -399,6 +385,61 @@ void TilesetManager::imageLoaded(Tileset *fromThread, Tileset *tileset)
     }
 }
 
+void TilesetManager::readImageInBackground(Tileset *cached)
+{
+    const QString name = cached->name();
+    const QString imageSource = cached->imageSource();
+    const QString imageSource2x = cached->imageSource2x();
+    const QString cacheDirectory = mBinaryCacheDirectory;
+    QSharedPointer<Tileset*> fromThread(new Tileset*(nullptr));
+    auto work = [name, imageSource, imageSource2x, cacheDirectory, fromThread]() {
+        const QString imagePath = imageSource2x.isEmpty() ? imageSource : imageSource2x;
+        Tileset *tileset = new Tileset(name, 64, 128);
+        tileset->setImageSource2x(imageSource2x);
+        QString cachePath;
+        if (!cacheDirectory.isEmpty()) {
+            cachePath = TilesetBinaryCache::cachePath(cacheDirectory, imagePath, tileset);
+            if (TilesetBinaryCache::read(cachePath, imagePath, tileset, imageSource)) {
+                *fromThread = tileset;
+                return;
+            }
+        }
+        QImage image(imagePath);
+        if (tileset->loadFromImage(image, imageSource) && !cachePath.isEmpty())
+            TilesetBinaryCache::write(cachePath, imagePath, tileset);
+        *fromThread = tileset;
+    };
+    auto done = [this, fromThread, cached]() {
+        finishImageRead(cached, fromThread);
+    };
+    ImageRead &read = mImageReads[cached];
+    read.fromThread = fromThread;
+    read.job = JobScheduler::instance()->schedule(work, JobScheduler::PriorityNormal,
+                                                  mImageReaderToken, this, done);
+}
+
+// Blocks until the image is read, reading it in this thread if no worker has
+// started on it yet.
+void TilesetManager::waitForImageRead(Tileset *cached)
+{
+    if (!mImageReads.contains(cached))
+        return;
+    ImageRead read = mImageReads[cached];
+    JobScheduler::instance()->wait(read.job);
+    finishImageRead(cached, read.fromThread);
+}
+
+void TilesetManager::finishImageRead(Tileset *cached, const QSharedPointer<Tileset*> &fromThread)
+{
+    // Already handled by waitForImageRead().
+    if (mImageReads.value(cached).fromThread != fromThread)
+        return;
+    mImageReads.remove(cached);
+
+    if (*fromThread)
+        imageLoaded(*fromThread, cached);
+}
+
 void TilesetManager::loadTileset(Tileset *tileset, const QString &imageSource_)
 {
     // Hack to ignore TileMetaInfoMgr's tilesets that haven't been loaded,
@@ -428,10 +469,7 @@ void TilesetManager::loadTileset(Tileset *tileset, const QString &imageSource_)
             tileset->setImageSource2x(imageSource2x);
             cached = mTilesetImageCache->addTileset(tileset);
 #if 1 /* QT_POINTER_SIZE == 8 */
-            QMetaObject::invokeMethod(mImageReaderWorkers[mNextThreadForJob],
-                                      "addJob", Qt::QueuedConnection,
-                                      Q_ARG(Tileset*,cached));
-            mNextThreadForJob = (mNextThreadForJob + 1) % mImageReaderWorkers.size();
+            readImageInBackground(cached);
 #else
             QImage *image = new QImage(tileset->imageSource2x());
             imageLoaded(image, cached);
@@ -442,11 +480,7 @@ void TilesetManager::loadTileset(Tileset *tileset, const QString &imageSource_)
             tileset->setImageSource2x(QString());
             cached = mTilesetImageCache->addTileset(tileset);
 #if 1 /* QT_POINTER_SIZE == 8 */
-            QMetaObject::invokeMethod(mImageReaderWorkers[mNextThreadForJob],
-                                      "addJob", Qt::QueuedConnection,
-                                      Q_ARG(Tileset*,cached));
-            mNextThreadForJob = (mNextThreadForJob + 1) % mImageReaderWorkers.size();
-            qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+            readImageInBackground(cached);
 #else
             QImage *image = new QImage(tileset->imageSource());
             imageLoaded(image, cached);
@@ -464,20 +498,11 @@ void TilesetManager::loadTileset(Tileset *tileset, const QString &imageSource_)
 
 void TilesetManager::waitForTilesets(const QList<Tileset *> &tilesets)
 {
-    while (true) {
-        bool busy = false;
-        for (TilesetImageReaderWorker *worker : mImageReaderWorkers) {
-            if (worker->busy()) {
-                busy = true;
-                break;
-            }
-        }
-        if (!busy)
-            break;
-        Sleep::msleep(10);
-        qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+    if (tilesets.isEmpty()) {
+        foreach (Tileset *cached, mImageReads.keys())
+            waitForImageRead(cached);
+        return;
     }
-    qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
 
     foreach (Tileset *ts, tilesets) {
         if (ts->isLoaded())
@@ -485,16 +510,29 @@ void TilesetManager::waitForTilesets(const QList<Tileset *> &tilesets)
         // Missing tilesets aren't in mTilesetImageCache
         if (ts->isMissing())
             continue;
-        // There may be a thread already reading or about to read this image.
-        QImage *image = new QImage(ts->imageSource2x().isEmpty() ? ts->imageSource() : ts->imageSource2x());
         Tileset *cached = mTilesetImageCache->findMatch(ts, ts->imageSource(), ts->imageSource2x());
-        Q_ASSERT(cached != 0 && !cached->isLoaded());
-        if (cached) {
+        Q_ASSERT(cached != 0);
+        if (!cached)
+            continue;
+        // This loads every tileset using the image, including this one.
+        waitForImageRead(cached);
+        if (!cached->isLoaded()) {
+            QImage *image = new QImage(ts->imageSource2x().isEmpty() ? ts->imageSource() : ts->imageSource2x());
             imageLoaded(image, cached); // deletes image
         }
     }
 }
 
+void TilesetManager::setUseBinaryCache(bool use)
+{
+    if (use) {
+        mBinaryCacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                + QLatin1String("/tilesets");
+    } else {
+        mBinaryCacheDirectory.clear();
+    }
+}
+
 void TilesetManager::changeTilesetSource(Tileset *tileset, const QString &source,
                                          bool missing)
 {
@@ -761,9 +799,11 @@ void TilesetManager::readTileLayerNames(Tileset *ts)
             mTileLayerNames[imageSource] = new ZTileLayerNames(reader.result());
             // Handle the source image being resized
             mTileLayerNames[imageSource]->enforceSize(columns, rows);
-        } else {
-            QMessageBox::critical(0, tr("Error Reading Tile Layer Names"),
+        } else if (MainWindow::instance()) {
+            QMessageBox::critical(MainWindow::instance(), tr("Error Reading Tile Layer Names"),
                                   filePath + QLatin1String("\n") + reader.errorString());
+        } else {
+            qWarning().noquote() << filePath << reader.errorString();
         }
     }
 }
@@ -775,8 +815,11 @@ void TilesetManager::writeTileLayerNames(ZTileLayerNames *tln)
 //    qDebug() << "Writing: " << tln->mFilePath;
     ZTileLayerNamesWriter writer;
     if (writer.write(tln) == false) {
-        QMessageBox::critical(0, tr("Error Writing Tile Layer Names"),
-            tln->mFilePath + QLatin1String("\n") + writer.errorString());
+        if (MainWindow::instance())
+            QMessageBox::critical(MainWindow::instance(), tr("Error Writing Tile Layer Names"),
+                tln->mFilePath + QLatin1String("\n") + writer.errorString());
+        else
+            qWarning().noquote() << tln->mFilePath << writer.errorString();
     }
 }
 
@@ -790,64 +833,3 @@ void TilesetManager::syncTileLayerNames(Tileset *ts)
     }
 }
 #endif // ZOMBOID
-
-#ifdef ZOMBOID
-/////
-
-TilesetImageReaderWorker::TilesetImageReaderWorker(int id, InterruptibleThread *thread) :
-    BaseWorker(thread),
-    mID(id),
-    mHasJobs(false)
-{
-}
-
-TilesetImageReaderWorker::~TilesetImageReaderWorker()
-{
-}
-
-bool TilesetImageReaderWorker::busy()
-{
-    QMutexLocker locker(&mJobsMutex);
-    return mHasJobs;
-}
-
-void TilesetImageReaderWorker::work()
-{
-    IN_WORKER_THREAD
-
-    while (mJobs.size()) {
-        if (aborted()) {
-            mJobs.clear();
-            break;
-        }
-
-        Job job = mJobs.takeAt(0);
-
-        QImage *image = new QImage(job.tileset->imageSource2x().isEmpty() ? job.tileset->imageSource() : job.tileset->imageSource2x());
-#if 0
-        Sleep::msleep(500);
-        qDebug() << "TilesetImageReaderThread #" << mID << "loaded" << job.tileset->imageSource();
-#endif
-        Tileset *fromThread = new Tileset(job.tileset->name(), 64, 128);
-        fromThread->setImageSource2x(job.tileset->imageSource2x());
-        fromThread->loadFromImage(*image, job.tileset->imageSource());
-        delete image;
-        emit imageLoaded(fromThread, job.tileset);
-    }
-
-    QMutexLocker locker(&mJobsMutex);
-    mHasJobs = false;
-}
-
-void TilesetImageReaderWorker::addJob(Tileset *tileset)
-{
-    IN_WORKER_THREAD
-
-    QMutexLocker locker(&mJobsMutex);
-    mHasJobs = true;
-    locker.unlock();
-
-    mJobs += Job(tileset);
-    scheduleWork();
-}
-#endif // ZOMBOID
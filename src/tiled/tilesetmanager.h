@@ -33,46 +33,11 @@
 #include <QTimer>
 
 #ifdef ZOMBOID
-#include "threads.h"
-#include <QVector>
+#include "jobscheduler.h"
 namespace Tiled {
 class Tileset;
 }
 class QImage;
-class TilesetImageReaderWorker : public BaseWorker
-{
-    Q_OBJECT
-public:
-    TilesetImageReaderWorker(int id, InterruptibleThread *thread);
-
-    ~TilesetImageReaderWorker();
-
-    bool busy();
-
-    typedef Tiled::Tileset Tileset;
-signals:
-    void imageLoaded(Tiled::Tileset *tileset, Tiled::Tileset *fromThread);
-
-public slots:
-    void work();
-    void addJob(Tileset *tileset);
-
-private:
-    class Job {
-    public:
-        Job(Tiled::Tileset *tileset) :
-            tileset(tileset)
-        {
-        }
-
-        Tiled::Tileset *tileset;
-    };
-    QList<Job> mJobs;
-
-    int mID;
-    QMutex mJobsMutex;
-    bool mHasJobs;
-};
 #endif // ZOMBOID
 
 namespace Tiled {
@@ -195,7 +160,22 @@ public:
     TilesetImageCache *imageCache() const { return mTilesetImageCache; }
 
     void loadTileset(Tileset *tileset, const QString &imageSource);
+
+    /**
+     * Blocks until the images of \a tilesets are loaded, or every image
+     * being read if \a tilesets is empty.  Only the reads of those images are
+     * waited on, and no events are processed.
+     */
     void waitForTilesets(const QList<Tileset *> &tilesets = QList<Tileset*>());
+
+    /**
+     * When enabled, the tiles cut from each tileset image are kept in the
+     * user's cache directory and read from there until the image changes.
+     * See Tiled::Internal::TilesetBinaryCache.
+     */
+    void setUseBinaryCache(bool use);
+    bool useBinaryCache() const
+    { return !mBinaryCacheDirectory.isEmpty(); }
 #endif
 
 signals:
@@ -241,9 +221,19 @@ private:
     Tileset *mNoBlendTileset;
     Tile *mNoBlendTile;
 
-    QVector<InterruptibleThread*> mImageReaderThreads;
-    QVector<TilesetImageReaderWorker*> mImageReaderWorkers;
-    int mNextThreadForJob;
+    // One read per image, keyed by the tileset in mTilesetImageCache.
+    struct ImageRead
+    {
+        JobHandle job;
+        QSharedPointer<Tileset*> fromThread;
+    };
+    void readImageInBackground(Tileset *cached);
+    void waitForImageRead(Tileset *cached);
+    void finishImageRead(Tileset *cached, const QSharedPointer<Tileset*> &fromThread);
+
+    JobToken mImageReaderToken;
+    QMap<Tileset*,ImageRead> mImageReads;
+    QString mBinaryCacheDirectory;
 #endif
 
 #ifdef ZOMBOID
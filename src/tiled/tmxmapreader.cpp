@@ -81,6 +81,7 @@ Map *TmxMapReader::read(const QString &fileName)
     EditorMapReader reader;
 #ifdef ZOMBOID
     reader.setTilesetImageCache(TilesetManager::instance()->imageCache());
+    reader.setDecodeLayersInParallel(true);
 #endif
     Map *map = reader.readMap(fileName);
     if (!map)
@@ -35,6 +35,9 @@ bool TmxMapWriter::write(const Map *map, const QString &fileName)
     MapWriter writer;
     writer.setLayerDataFormat(prefs->layerDataFormat());
     writer.setDtdEnabled(prefs->dtdEnabled());
+#ifdef ZOMBOID
+    writer.setEncodeLayersInParallel(true);
+#endif
 
     bool result = writer.writeMap(map, fileName);
     if (!result)
@@ -54,6 +57,9 @@ bool TmxMapWriter::write(const Map *map, QFile &file, const QString &path)
     MapWriter writer;
     writer.setLayerDataFormat(prefs->layerDataFormat());
     writer.setDtdEnabled(prefs->dtdEnabled());
+#ifdef ZOMBOID
+    writer.setEncodeLayersInParallel(true);
+#endif
 
     writer.writeMap(map, &file, path);
     if (file.error() != QFile::NoError) {
@@ -0,0 +1,279 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "worldlotexporter.h"
+
+#include "bmpblender.h"
+#include "jobpipeline.h"
+#include "mapcomposite.h"
+#include "mapmanager.h"
+#include "newmapbinaryfile.h"
+#include "tilesetmanager.h"
+
+#include "worlded/world.h"
+#include "worlded/worldcell.h"
+
+#include "map.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QThread>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+class WorldLotExporter::Job
+{
+public:
+    Job() :
+        mapComposite(nullptr),
+        bytes(0)
+    {
+    }
+
+    MapComposite *mapComposite;
+#ifdef WORLDED
+    QList<MapInfo*> referencedMaps;
+#endif
+    qint64 bytes;
+    CellResult result;
+};
+
+/////
+
+WorldLotExporter::WorldLotExporter(World *world, QObject *parent) :
+    QObject(parent),
+    mWorld(world),
+    mMaxThreadCount(qMax(1, QThread::idealThreadCount())),
+    mMemoryBudget(qint64(1024) * 1024 * 1024)
+{
+}
+
+WorldLotExporter::~WorldLotExporter()
+{
+}
+
+void WorldLotExporter::setMaxThreadCount(int count)
+{
+    mMaxThreadCount = qMax(1, count);
+}
+
+void WorldLotExporter::setMemoryBudget(qint64 bytes)
+{
+    mMemoryBudget = bytes;
+}
+
+bool WorldLotExporter::exportWorld(const QString &directory)
+{
+    const QPoint origin = mWorld->getGenerateLotsSettings().worldOrigin;
+    const QDir dir(directory);
+
+    QList<CellResult> items;
+    for (int y = 0; y < mWorld->height(); y++) {
+        for (int x = 0; x < mWorld->width(); x++) {
+            WorldCell *cell = mWorld->cellAt(x, y);
+            if (!cell || cell->mapFilePath().isEmpty())
+                continue;
+            CellResult item;
+            item.cell = cell;
+            item.mapFilePath = cell->mapFilePath();
+            item.filePath = dir.filePath(QString(QLatin1String("%1_%2.pzby"))
+                                         .arg(origin.x() + x).arg(origin.y() + y));
+            items += item;
+        }
+    }
+
+    return exportItems(items);
+}
+
+bool WorldLotExporter::exportMaps(const QStringList &mapFiles, const QString &directory)
+{
+    const QDir dir(directory);
+
+    QList<CellResult> items;
+    for (const QString &mapFilePath : mapFiles) {
+        CellResult item;
+        item.mapFilePath = mapFilePath;
+        item.filePath = dir.filePath(QFileInfo(mapFilePath).completeBaseName()
+                                     + QLatin1String(".pzby"));
+        items += item;
+    }
+
+    return exportItems(items);
+}
+
+bool WorldLotExporter::exportItems(const QList<CellResult> &items)
+{
+    mResults.clear();
+
+    // Each cell only needs its own MapComposite, so any number of them can
+    // be written at once.  The pipeline holds the next one back until the
+    // ones in flight fit in the budget.
+    JobPipeline pipeline;
+    pipeline.setMaxRunning(mMaxThreadCount);
+    pipeline.setMemoryBudget(mMemoryBudget);
+
+    for (const CellResult &item : items) {
+        Job *job = loadCell(item);
+        if (!job->mapComposite) {
+            finishJob(job);
+            continue;
+        }
+
+        pipeline.start([job]() { exportCell(job); },
+                       [this, job]() { finishJob(job); },
+                       job->bytes);
+        emit cellStarted(item.cell);
+    }
+
+    pipeline.waitForAll();
+
+    return failureCount() == 0;
+}
+
+int WorldLotExporter::failureCount() const
+{
+    int count = 0;
+    for (const CellResult &result : mResults) {
+        if (!result.error.isEmpty())
+            ++count;
+    }
+    return count;
+}
+
+// MapManager, MapComposite and BmpBlender all live in the GUI thread, so
+// everything up to NewMapBinaryFile::write() happens here.
+WorldLotExporter::Job *WorldLotExporter::loadCell(const CellResult &item)
+{
+    Job *job = new Job;
+    job->result = item;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    MapInfo *mapInfo = MapManager::instance()->loadMap(item.mapFilePath);
+    if (!mapInfo) {
+        job->result.error = MapManager::instance()->errorString();
+        job->result.loadMS = timer.elapsed();
+        return job;
+    }
+#ifdef WORLDED
+    MapManager::instance()->addReferenceToMap(mapInfo);
+    job->referencedMaps += mapInfo;
+#endif
+
+    MapComposite *mapComposite = new MapComposite(mapInfo);
+    const QList<WorldCellLot*> lots = item.cell ? item.cell->lots() : QList<WorldCellLot*>();
+    for (WorldCellLot *lot : lots) {
+        MapInfo *subMapInfo = MapManager::instance()->loadMap(lot->mapName());
+        if (!subMapInfo) {
+            job->result.error = MapManager::instance()->errorString();
+            break;
+        }
+#ifdef WORLDED
+        MapManager::instance()->addReferenceToMap(subMapInfo);
+        job->referencedMaps += subMapInfo;
+#endif
+        mapComposite->addMap(subMapInfo, lot->pos(), lot->level());
+    }
+
+    // The lots placed in the maps themselves are read in the background.
+    // Loading them again waits on just those reads and adds them to the
+    // composite, whose new sub-maps may have lots of their own.  Each
+    // loadMap() returns once its map has finished or failed, so a composite
+    // still waiting on the very same maps afterwards will never get them.
+    while (job->result.error.isEmpty() && mapComposite->waitingForMapsToLoad()) {
+        const QList<MapInfo*> loading = mapComposite->mapsLoading();
+        for (MapInfo *subMapInfo : loading) {
+            if (!MapManager::instance()->loadMap(subMapInfo->path())) {
+                job->result.error = MapManager::instance()->errorString();
+                break;
+            }
+        }
+        if (job->result.error.isEmpty() && mapComposite->mapsLoading() == loading)
+            job->result.error = tr("Some lots never finished loading.");
+    }
+
+    QList<Tileset*> usedTilesets = mapComposite->usedTilesets();
+    usedTilesets.removeAll(TilesetManager::instance()->missingTileset());
+    TilesetManager::instance()->waitForTilesets(usedTilesets);
+
+    // CompositeLayerGroup::prepareDrawing2() flushes the blenders, which
+    // must not happen outside the GUI thread.  Flushing here leaves nothing
+    // for it to do.
+    for (MapComposite *mc : mapComposite->maps()) {
+        if (mc->bmpBlender())
+            mc->bmpBlender()->flush(QRect(QPoint(), mc->map()->size()));
+    }
+
+    job->mapComposite = mapComposite;
+    job->bytes = estimateBytes(mapComposite);
+    job->result.loadMS = timer.elapsed();
+
+    if (!job->result.error.isEmpty()) {
+        // A lot failed or never finished loading.  Don't export a cell with
+        // missing pieces.
+        delete job->mapComposite;
+        job->mapComposite = nullptr;
+    }
+
+    return job;
+}
+
+// Called in a worker thread.
+void WorldLotExporter::exportCell(Job *job)
+{
+    QElapsedTimer timer;
+    timer.start();
+    NewMapBinaryFile file;
+    file.setIncremental(true);
+    // The cells already keep every thread busy.
+    file.setMaxThreadCount(1);
+    if (!file.write(job->mapComposite, job->result.filePath))
+        job->result.error = file.errorString();
+    job->result.gridBytes = file.stats().gridBytes;
+    job->result.chunksReused = file.stats().chunksReused;
+    job->result.chunkCount = file.stats().chunksReused + file.stats().chunksGenerated;
+    job->result.exportMS = timer.elapsed();
+}
+
+void WorldLotExporter::finishJob(Job *job)
+{
+    delete job->mapComposite;
+#ifdef WORLDED
+    for (MapInfo *mapInfo : job->referencedMaps)
+        MapManager::instance()->removeReferenceToMap(mapInfo);
+#endif
+    mResults += job->result;
+    emit cellFinished(job->result.cell, job->result.error);
+    delete job;
+}
+
+// NewMapBinaryFile's LotSquareGrid keeps an offset, count and room ID
+// for every square on every level, plus the tile IDs.  Assume a couple of
+// tiles per square.
+qint64 WorldLotExporter::estimateBytes(MapComposite *mapComposite) const
+{
+    int maxLevel = mapComposite->maxLevel();
+    for (MapComposite *mc : mapComposite->maps())
+        maxLevel = qMax(maxLevel, mc->maxLevel());
+    const qint64 squares = qint64(mapComposite->map()->width()) * mapComposite->map()->height()
+            * (maxLevel + 1);
+    const qint64 perSquare = sizeof(uint) + sizeof(quint16) + sizeof(qint32) + 2 * sizeof(uint);
+    return squares * perSquare;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORLDLOTEXPORTER_H
+#define WORLDLOTEXPORTER_H
+
+#include <QList>
+#include <QObject>
+#include <QStringList>
+
+class MapComposite;
+class MapInfo;
+class World;
+class WorldCell;
+
+/**
+ * Writes a .pzby file for every cell in a World that has a map, or for a list
+ * of maps.
+ *
+ * Cells are loaded through MapManager in the GUI thread, then handed to a
+ * JobPipeline that runs NewMapBinaryFile::write() on each of them in the
+ * JobScheduler's threads, so the header and chunk data of different cells
+ * are generated at the same time.  Loading runs ahead of the threads only
+ * while the estimated size of the cells in flight stays under the memory
+ * budget.
+ */
+class WorldLotExporter : public QObject
+{
+    Q_OBJECT
+public:
+    struct CellResult
+    {
+        CellResult() : cell(nullptr), loadMS(0), exportMS(0), gridBytes(0),
+            chunksReused(0), chunkCount(0) {}
+
+        WorldCell *cell;
+        QString mapFilePath;
+        QString filePath;
+        QString error;
+        qint64 loadMS;
+        qint64 exportMS;
+        qint64 gridBytes;
+        int chunksReused;
+        int chunkCount;
+    };
+
+    /**
+     * \a world may be null if only exportMaps() is used.
+     */
+    WorldLotExporter(World *world, QObject *parent = nullptr);
+    ~WorldLotExporter();
+
+    /**
+     * The number of cells exported at once.  Defaults to
+     * QThread::idealThreadCount().
+     */
+    void setMaxThreadCount(int count);
+    int maxThreadCount() const
+    { return mMaxThreadCount; }
+
+    /**
+     * The approximate number of bytes of map and lot data allowed to be
+     * loaded or exporting at any time.  At least one cell is always in
+     * flight, however large it is.
+     */
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const
+    { return mMemoryBudget; }
+
+    /**
+     * Exports every cell to \a directory as X_Y.pzby, where X and Y include
+     * the world origin from the world's lot settings.  Blocks until every
+     * cell is done and returns false if any of them failed.  Exports are
+     * incremental, chunks of a cell whose maps haven't changed since the
+     * last export are copied from the old file.
+     */
+    bool exportWorld(const QString &directory);
+
+    /**
+     * Exports maps that aren't part of a world to \a directory as
+     * <map name>.pzby.  Only the lots placed in the maps themselves are
+     * included.  The cell in the results and signals is null.
+     */
+    bool exportMaps(const QStringList &mapFiles, const QString &directory);
+
+    /**
+     * One entry per cell that was attempted, in the order they finished.
+     */
+    const QList<CellResult> &results() const
+    { return mResults; }
+
+    int failureCount() const;
+
+signals:
+    void cellStarted(WorldCell *cell);
+    void cellFinished(WorldCell *cell, const QString &error);
+
+private:
+    class Job;
+
+    bool exportItems(const QList<CellResult> &items);
+    Job *loadCell(const CellResult &item);
+    static void exportCell(Job *job);
+    void finishJob(Job *job);
+    qint64 estimateBytes(MapComposite *mapComposite) const;
+
+    World *mWorld;
+    int mMaxThreadCount;
+    qint64 mMemoryBudget;
+    QList<CellResult> mResults;
+};
+
+#endif // WORLDLOTEXPORTER_H
@@ -33,6 +33,7 @@ ZProgressManager *ZProgressManager::instance()
 ZProgressManager::ZProgressManager()
     : mMainWindow(0)
     , mDialog(0)
+    , mLabel(0)
     , mDepth(0)
 {
     mInstance = this;
@@ -57,8 +58,15 @@ void ZProgressManager::setMainWindow(QWidget *mainWindow)
     mDialog->setWindowFlags(Qt::CustomizeWindowHint | Qt::Dialog);
 }
 
+// Without a main window (batch mode) there is no dialog.  Only the start of
+// each step is reported, the updates would flood the console.
 void ZProgressManager::begin(const QString &text)
 {
+    if (!mDialog) {
+        mDepth++;
+        emit stepStarted(text);
+        return;
+    }
     mLabel->setText(text);
     if (mDepth++ == 0)
         mDialog->show();
@@ -68,6 +76,8 @@ void ZProgressManager::begin(const QString &text)
 void ZProgressManager::update(const QString &text)
 {
     Q_ASSERT(mDepth > 0);
+    if (!mDialog)
+        return;
     mLabel->setText(text);
     qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
 }
@@ -76,6 +86,10 @@ void ZProgressManager::end()
 {
     Q_ASSERT(mDepth > 0);
 //    mDialog->setValue(mDialog->maximum()); // hides dialog!
+    if (!mDialog) {
+        --mDepth;
+        return;
+    }
     if (--mDepth == 0)
         mDialog->hide();
     qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
@@ -40,6 +40,13 @@ public:
 
     void setMainWindow(QWidget *parent);
 
+signals:
+    /**
+     * Emitted by begin() when there is no main window to show the progress
+     * dialog over.
+     */
+    void stepStarted(const QString &text);
+
 private:
     Q_DISABLE_COPY(ZProgressManager)
 
@@ -0,0 +1,149 @@
+#include "alphaflatten.h"
+
+#include <QImage>
+#include <QRandomGenerator>
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+/**
+ * Checks the vectorized alpha flattening against the per-pixel loop that
+ * map thumbnails and the mini-map used before, and times both on an image
+ * the size of a large mini-map.
+ */
+class test_AlphaFlatten : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void flatten_data();
+    void flatten();
+    void flattenRect();
+    void flattenToARGB4444_data();
+    void flattenToARGB4444();
+
+    void benchmark_data();
+    void benchmark();
+
+private:
+    QImage randomImage(int width, int height) const;
+};
+
+static void flattenScalar(QImage &image)
+{
+    for (int y = 0; y < image.height(); y++) {
+        QRgb *pixels = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); x++) {
+            QRgb pixel = pixels[x];
+            if (qAlpha(pixel) > 0.01f) {
+                pixels[x] = qRgba(qRed(pixel), qGreen(pixel), qBlue(pixel), 255);
+            }
+        }
+    }
+}
+
+QImage test_AlphaFlatten::randomImage(int width, int height) const
+{
+    // A third of the pixels fully transparent, some barely visible.
+    QRandomGenerator random(quint32(width * height));
+    QImage image(width, height, QImage::Format_ARGB32);
+    for (int y = 0; y < height; ++y) {
+        QRgb *pixels = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            int alpha = random.bounded(256);
+            if (random.bounded(3) == 0)
+                alpha = 0;
+            else if (random.bounded(5) == 0)
+                alpha = 1;
+            pixels[x] = qRgba(random.bounded(256), random.bounded(256), random.bounded(256), alpha);
+        }
+    }
+    return image;
+}
+
+void test_AlphaFlatten::flatten_data()
+{
+    QTest::addColumn<int>("width");
+    QTest::newRow("1") << 1;
+    QTest::newRow("7") << 7;
+    QTest::newRow("33") << 33;
+    QTest::newRow("512") << 512;
+}
+
+void test_AlphaFlatten::flatten()
+{
+    QFETCH(int, width);
+    QImage expected = randomImage(width, 13);
+    QImage actual = expected.copy();
+    flattenScalar(expected);
+    flattenAlpha(actual);
+    QCOMPARE(actual, expected);
+}
+
+void test_AlphaFlatten::flattenRect()
+{
+    const QImage original = randomImage(100, 50);
+    QImage image = original.copy();
+    const QRect rect(13, 5, 200, 20); // sticks out of the image
+    flattenAlpha(image, rect);
+    const QRect clipped = rect & image.rect();
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x) {
+            const QRgb pixel = original.pixel(x, y);
+            QRgb expected = pixel;
+            if (clipped.contains(x, y) && qAlpha(pixel))
+                expected = pixel | 0xFF000000;
+            QCOMPARE(image.pixel(x, y), expected);
+        }
+    }
+}
+
+void test_AlphaFlatten::flattenToARGB4444_data()
+{
+    flatten_data();
+}
+
+void test_AlphaFlatten::flattenToARGB4444()
+{
+    QFETCH(int, width);
+    const QImage image = randomImage(width, 13);
+    QImage flattened = image.copy();
+    flattenScalar(flattened);
+    const QImage expected = flattened.convertToFormat(QImage::Format_ARGB4444_Premultiplied);
+    const QImage actual = flattenAlphaToARGB4444(image);
+    QCOMPARE(actual.format(), QImage::Format_ARGB4444_Premultiplied);
+    QCOMPARE(actual, expected);
+}
+
+void test_AlphaFlatten::benchmark_data()
+{
+    QTest::addColumn<QString>("method");
+    QTest::newRow("scalar") << QString::fromLatin1("scalar");
+    QTest::newRow("flattenAlpha") << QString::fromLatin1("flattenAlpha");
+    QTest::newRow("scalar + convertToFormat") << QString::fromLatin1("scalar4444");
+    QTest::newRow("flattenAlphaToARGB4444") << QString::fromLatin1("flatten4444");
+}
+
+void test_AlphaFlatten::benchmark()
+{
+    QFETCH(QString, method);
+    const QImage original = randomImage(2048, 1536);
+    QImage image = original.copy();
+    QImage result;
+
+    QBENCHMARK {
+        if (method == QLatin1String("scalar")) {
+            flattenScalar(image);
+        } else if (method == QLatin1String("flattenAlpha")) {
+            flattenAlpha(image);
+        } else if (method == QLatin1String("scalar4444")) {
+            flattenScalar(image);
+            result = image.convertToFormat(QImage::Format_ARGB4444_Premultiplied);
+        } else {
+            result = flattenAlphaToARGB4444(original);
+        }
+    }
+}
+
+QTEST_MAIN(test_AlphaFlatten)
+#include "test_alphaflatten.moc"
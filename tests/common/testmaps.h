@@ -0,0 +1,60 @@
+#ifndef TESTMAPS_H
+#define TESTMAPS_H
+
+#include "map.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QRandomGenerator>
+
+/**
+ * Maps shared by the tests and benchmarks that need a Project Zomboid sized
+ * cell to work on.
+ */
+namespace TestMaps {
+
+/**
+ * A 64x128 tileset with 128 empty tiles.  It has no image, so it is fast to
+ * create and its tiles are only compared by id.
+ */
+inline Tiled::Tileset *createFloorsTileset()
+{
+    Tiled::Tileset *tileset = new Tiled::Tileset(QLatin1String("floors"), 64, 128);
+    tileset->loadFromNothing(QSize(1024, 1024), QLatin1String("floors.png"));
+    return tileset;
+}
+
+/**
+ * An isometric map of \a size x \a size cells with \a layerCount tile layers
+ * named like those of a cell, 12 per level.  The first layer of each level is
+ * mostly full and the rest are mostly empty.  The tiles are picked at random
+ * from \a tileset, but the same \a seed always gives the same map.
+ *
+ * The map doesn't own \a tileset.
+ */
+inline Tiled::Map *createCellMap(Tiled::Tileset *tileset, int size, int layerCount,
+                                 quint32 seed = 1)
+{
+    using namespace Tiled;
+
+    Map *map = new Map(Map::LevelIsometric, size, size, 64, 32);
+    map->addTileset(tileset);
+
+    QRandomGenerator random(seed);
+    for (int i = 0; i < layerCount; ++i) {
+        TileLayer *tl = new TileLayer(QString::fromLatin1("%1_Layer%2").arg(i / 12).arg(i),
+                                      0, 0, size, size);
+        const int percent = (i % 12) ? 5 : 90;
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+                if (random.bounded(100) < percent)
+                    tl->setCell(x, y, Cell(tileset->tileAt(random.bounded(tileset->tileCount()))));
+        map->addLayer(tl);
+    }
+    return map;
+}
+
+} // namespace TestMaps
+
+#endif // TESTMAPS_H
@@ -0,0 +1,44 @@
+#ifndef TESTTILESHEET_H
+#define TESTTILESHEET_H
+
+#include <QColor>
+#include <QImage>
+#include <QPainter>
+#include <QRandomGenerator>
+
+/**
+ * Tile sheets shared by the tests that cut tilesets from an image.
+ */
+namespace TestTileSheet {
+
+/**
+ * A \a width x \a height sheet of 64x128 tiles that only cover part of their
+ * cell, so they are trimmed, with some left empty and some on a white
+ * background for the transparent color.  The same \a seed always gives the
+ * same sheet.
+ */
+inline QImage createTileSheet(int width, int height, quint32 seed = 1)
+{
+    QImage image(width, height, QImage::Format_ARGB32);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    QRandomGenerator random(seed);
+    for (int y = 0; y < height; y += 128) {
+        for (int x = 0; x < width; x += 64) {
+            if (random.bounded(10) == 0)
+                continue;
+            if (random.bounded(4) == 0)
+                painter.fillRect(x, y, 64, 128, Qt::white);
+            const int w = 8 + random.bounded(56);
+            const int h = 8 + random.bounded(120);
+            painter.fillRect(x + random.bounded(65 - w), y + random.bounded(129 - h), w, h,
+                             QColor(random.bounded(256), random.bounded(256),
+                                    random.bounded(256), 1 + random.bounded(255)));
+        }
+    }
+    return image;
+}
+
+} // namespace TestTileSheet
+
+#endif // TESTTILESHEET_H
@@ -0,0 +1,142 @@
+#include "gidmapper.h"
+#include "map.h"
+#include "mapwriter.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QBuffer>
+#include <QRandomGenerator>
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+/**
+ * Saving a Project Zomboid cell may reference several hundred tilesets.
+ * GidMapper::cellToGid() is called for every cell written, so it must not
+ * depend on the number of tilesets.
+ */
+class test_GidMapper : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void cellToGid();
+    void sharedFirstGid();
+
+    void benchmarkCellToGid();
+    void benchmarkWriteMap();
+
+private:
+    QList<Tileset*> mTilesets;
+    Map *mMap;
+};
+
+static const int TILESET_COUNT = 320;
+static const int MAP_SIZE = 300;
+static const int LAYER_COUNT = 8;
+
+void test_GidMapper::initTestCase()
+{
+    for (int i = 0; i < TILESET_COUNT; ++i) {
+        Tileset *ts = new Tileset(QString::fromLatin1("tileset_%1").arg(i), 64, 128);
+        ts->loadFromNothing(QSize(512, 512), ts->name() + QLatin1String(".png"));
+        mTilesets += ts;
+    }
+
+    mMap = new Map(Map::LevelIsometric, MAP_SIZE, MAP_SIZE, 64, 32);
+    foreach (Tileset *ts, mTilesets)
+        mMap->addTileset(ts);
+
+    // Every cell uses a different tileset, walking all of them in turn.
+    QRandomGenerator random(1);
+    for (int i = 0; i < LAYER_COUNT; ++i) {
+        TileLayer *tl = new TileLayer(QString::fromLatin1("0_Layer%1").arg(i),
+                                      0, 0, MAP_SIZE, MAP_SIZE);
+        for (int y = 0; y < MAP_SIZE; ++y) {
+            for (int x = 0; x < MAP_SIZE; ++x) {
+                if (random.bounded(4))
+                    continue;
+                Tileset *ts = mTilesets.at(random.bounded(TILESET_COUNT));
+                tl->setCell(x, y, Cell(ts->tileAt(random.bounded(ts->tileCount()))));
+            }
+        }
+        mMap->addLayer(tl);
+    }
+}
+
+void test_GidMapper::cleanupTestCase()
+{
+    delete mMap;
+    qDeleteAll(mTilesets);
+}
+
+void test_GidMapper::cellToGid()
+{
+    GidMapper mapper(mTilesets);
+    uint firstGid = 1;
+    foreach (Tileset *ts, mTilesets) {
+        QCOMPARE(mapper.firstGid(ts), firstGid);
+        Tile *tile = ts->tileAt(ts->tileCount() - 1);
+        uint gid = mapper.cellToGid(Cell(tile));
+        QCOMPARE(gid, firstGid + tile->id());
+
+        bool ok;
+        QVERIFY(mapper.gidToCell(gid, ok).tile == tile);
+        QVERIFY(ok);
+
+        firstGid += ts->tileCount();
+    }
+
+    Tileset unknown(QLatin1String("unknown"), 64, 128);
+    unknown.loadFromNothing(QSize(64, 128), QLatin1String("unknown.png"));
+    QCOMPARE(mapper.cellToGid(Cell(unknown.tileAt(0))), 0u);
+
+    mapper.clear();
+    QVERIFY(mapper.isEmpty());
+    QCOMPARE(mapper.cellToGid(Cell(mTilesets.first()->tileAt(0))), 0u);
+}
+
+void test_GidMapper::sharedFirstGid()
+{
+    // Lot exporting maps identically-named tilesets from different maps to
+    // the same gids.
+    GidMapper mapper;
+    mapper.insert(1, mTilesets.at(0));
+    mapper.insert(1, mTilesets.at(1));
+    QCOMPARE(mapper.cellToGid(Cell(mTilesets.at(0)->tileAt(3))), 4u);
+    QCOMPARE(mapper.cellToGid(Cell(mTilesets.at(1)->tileAt(3))), 4u);
+}
+
+void test_GidMapper::benchmarkCellToGid()
+{
+    GidMapper mapper(mTilesets);
+    uint sum = 0;
+    QBENCHMARK {
+        foreach (Layer *layer, mMap->layers()) {
+            TileLayer *tl = layer->asTileLayer();
+            for (int y = 0; y < MAP_SIZE; ++y)
+                for (int x = 0; x < MAP_SIZE; ++x)
+                    sum += mapper.cellToGid(tl->cellAt(x, y));
+        }
+    }
+    QVERIFY(sum > 0);
+}
+
+void test_GidMapper::benchmarkWriteMap()
+{
+    MapWriter writer;
+    writer.setDtdEnabled(false);
+    QBENCHMARK {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        writer.writeMap(mMap, &buffer);
+        QVERIFY(buffer.size() > 0);
+    }
+}
+
+QTEST_MAIN(test_GidMapper)
+#include "test_gidmapper.moc"
@@ -0,0 +1,383 @@
+#include "lotfilereader.h"
+#include "lotfilewriter.h"
+#include "lotsquaregrid.h"
+#include "map.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+/**
+ * Exports sample cells to .pzby the way NewMapBinaryFile does, with the
+ * same LotFileWriter and LotSquareGrid encoding, reads them
+ * back with LotFileReader and compares every square with the layers of the
+ * map it came from.  The throughput benchmarks report tiles per second for
+ * exporting and reading a typical 300x300 cell.
+ */
+class test_LotFileReader : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void roundTrip_data();
+    void roundTrip();
+
+    void readFile();
+    void corruptFile_data();
+    void corruptFile();
+
+    void throughput_data();
+    void throughput();
+
+private:
+    struct Room
+    {
+        QString name;
+        int level;
+        QRect rect;
+        int metaEnum;
+    };
+
+    Map *createMap(int width, int height) const;
+    QByteArray exportMap(const Map *map, int *tileCount = nullptr);
+    void compare(const Map *map, const LotFileReader &reader) const;
+
+    QList<Tileset*> mTilesets;
+    QList<Room> mRooms;
+    LotSquareGrid mGrid;
+};
+
+static const int LEVELS = 3;
+static const int LAYERS_PER_LEVEL = 4;
+
+void test_LotFileReader::initTestCase()
+{
+    static const char *names[] = { "floors_interior_01", "walls_exterior_01", "furniture_seating_01" };
+    for (const char *name : names) {
+        Tileset *tileset = new Tileset(QLatin1String(name), 64, 128);
+        tileset->loadFromNothing(QSize(1024, 1024), QLatin1String(name) + QLatin1String(".png"));
+        mTilesets += tileset;
+    }
+
+    Room kitchen = { QLatin1String("kitchen"), 0, QRect(12, 5, 6, 4), 3 };
+    Room bedroom = { QLatin1String("bedroom"), 1, QRect(12, 5, 6, 4), -1 };
+    mRooms << kitchen << bedroom;
+}
+
+void test_LotFileReader::cleanupTestCase()
+{
+    qDeleteAll(mTilesets);
+}
+
+// Each level has a nearly solid floor, some walls and a little furniture,
+// the upper levels less of everything.
+Map *test_LotFileReader::createMap(int width, int height) const
+{
+    Map *map = new Map(Map::LevelIsometric, width, height, 64, 32);
+    for (Tileset *tileset : mTilesets)
+        map->addTileset(tileset);
+
+    QRandomGenerator random(quint32(width * height));
+    static const int percent[LAYERS_PER_LEVEL] = { 90, 10, 3, 1 };
+    for (int z = 0; z < LEVELS; ++z) {
+        for (int i = 0; i < LAYERS_PER_LEVEL; ++i) {
+            TileLayer *tl = new TileLayer(QString::fromLatin1("%1_Layer%2").arg(z).arg(i),
+                                          0, 0, width, height);
+            tl->setLevel(z);
+            Tileset *tileset = mTilesets[qMin(i, mTilesets.size() - 1)];
+            for (int y = 0; y < height; ++y)
+                for (int x = 0; x < width; ++x)
+                    if (random.bounded(100) < percent[i] / (z + 1))
+                        tl->setCell(x, y, Cell(tileset->tileAt(random.bounded(tileset->tileCount()))));
+            map->addLayer(tl);
+        }
+    }
+    return map;
+}
+
+// Writes the header, chunk table and chunks in the same order as
+// NewMapBinaryFile::write(), from a single map instead of a MapComposite.
+QByteArray test_LotFileReader::exportMap(const Map *map, int *tileCount)
+{
+    QHash<Tileset*,uint> firstGid;
+    QStringList gidNames(QString()); // gid 0 is no tile
+    for (Tileset *tileset : map->tilesets()) {
+        firstGid[tileset] = uint(gidNames.size());
+        for (int i = 0; i < tileset->tileCount(); ++i)
+            gidNames += tileset->name() + QLatin1String("_") + QString::number(i);
+    }
+
+    const int chunksX = (map->width() + LotSquareGrid::ChunkWidth - 1) / LotSquareGrid::ChunkWidth;
+    const int chunksY = (map->height() + LotSquareGrid::ChunkHeight - 1) / LotSquareGrid::ChunkHeight;
+    mGrid.reset(chunksX, chunksY, LEVELS);
+
+    QVector<QVector<const TileLayer*>> layers(LEVELS);
+    for (const TileLayer *tl : map->tileLayers())
+        layers[tl->level()] += tl;
+
+    QVector<bool> used(gidNames.size());
+    int tiles = 0;
+    for (int z = 0; z < LEVELS; ++z) {
+        for (int y = 0; y < map->height(); ++y) {
+            for (int x = 0; x < map->width(); ++x) {
+                const int index = mGrid.index(x, y, z);
+                for (const TileLayer *tl : qAsConst(layers[z])) {
+                    const Cell &cell = tl->cellAt(x, y);
+                    if (cell.isEmpty())
+                        continue;
+                    const uint gid = firstGid[cell.tile->tileset()] + uint(cell.tile->id());
+                    mGrid.addTile(index, gid);
+                    used[int(gid)] = true;
+                    ++tiles;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < mRooms.size(); ++i) {
+        const Room &room = mRooms[i];
+        for (int y = room.rect.top(); y <= room.rect.bottom(); ++y)
+            for (int x = room.rect.left(); x <= room.rect.right(); ++x)
+                mGrid.setRoomID(mGrid.index(x, y, room.level), i);
+    }
+
+    QVector<qint32> gidToId(gidNames.size(), -1);
+    QStringList tileNames;
+    for (int gid = 0; gid < gidNames.size(); ++gid) {
+        if (used[gid]) {
+            gidToId[gid] = tileNames.size();
+            tileNames += gidNames[gid];
+        }
+    }
+
+    QVector<LotFileReader::Room> rooms;
+    for (const Room &room : qAsConst(mRooms)) {
+        LotFileReader::Room r;
+        r.name = room.name;
+        r.level = room.level;
+        r.rects += room.rect;
+        if (room.metaEnum >= 0) {
+            LotFileReader::RoomObject object = { room.metaEnum, room.rect.x(), room.rect.y() };
+            r.objects += object;
+        }
+        rooms += r;
+    }
+    QVector<int> building;
+    for (int i = 0; i < mRooms.size(); ++i)
+        building += i;
+
+    QByteArray header;
+    {
+        QDataStream out(&header, QIODevice::WriteOnly);
+        out.setByteOrder(QDataStream::LittleEndian);
+        LotFileWriter::writeHeader(out, tileNames, chunksX, chunksY, LEVELS,
+                                   rooms, QVector<QVector<int>>() << building);
+    }
+
+    const qint64 dataPosition = header.size() + chunksX * chunksY * qint64(sizeof(qint64));
+    QVector<qint64> positions;
+    QByteArray chunkData;
+    {
+        QDataStream out(&chunkData, QIODevice::WriteOnly);
+        out.setByteOrder(QDataStream::LittleEndian);
+        for (int cy = 0; cy < chunksY; ++cy) {
+            for (int cx = 0; cx < chunksX; ++cx) {
+                positions += dataPosition + chunkData.size();
+                mGrid.encodeChunk(out, cx, cy, gidToId);
+            }
+        }
+    }
+
+    QByteArray data = header;
+    {
+        QDataStream out(&data, QIODevice::Append);
+        out.setByteOrder(QDataStream::LittleEndian);
+        LotFileWriter::writeChunkTable(out, positions);
+    }
+    data += chunkData;
+
+    if (tileCount)
+        *tileCount = tiles;
+    return data;
+}
+
+void test_LotFileReader::compare(const Map *map, const LotFileReader &reader) const
+{
+    QCOMPARE(reader.levels(), LEVELS);
+    QCOMPARE(reader.chunksX() * LotSquareGrid::ChunkWidth - map->width() < LotSquareGrid::ChunkWidth, true);
+    QCOMPARE(reader.chunksY() * LotSquareGrid::ChunkHeight - map->height() < LotSquareGrid::ChunkHeight, true);
+
+    QCOMPARE(reader.rooms().size(), mRooms.size());
+    for (int i = 0; i < mRooms.size(); ++i) {
+        const LotFileReader::Room &room = reader.rooms()[i];
+        QCOMPARE(room.name, mRooms[i].name);
+        QCOMPARE(room.level, mRooms[i].level);
+        QCOMPARE(room.rects, QVector<QRect>() << mRooms[i].rect);
+        QCOMPARE(room.objects.size(), mRooms[i].metaEnum >= 0 ? 1 : 0);
+    }
+    QCOMPARE(reader.buildings(), QVector<QVector<int>>() << (QVector<int>() << 0 << 1));
+
+    QVector<QVector<const TileLayer*>> layers(LEVELS);
+    for (const TileLayer *tl : map->tileLayers())
+        layers[tl->level()] += tl;
+
+    for (int z = 0; z < LEVELS; ++z) {
+        for (int y = 0; y < reader.chunksY() * LotSquareGrid::ChunkHeight; ++y) {
+            for (int x = 0; x < reader.chunksX() * LotSquareGrid::ChunkWidth; ++x) {
+                QStringList expected;
+                for (const TileLayer *tl : qAsConst(layers[z])) {
+                    if (!tl->contains(x, y))
+                        continue;
+                    const Cell &cell = tl->cellAt(x, y);
+                    if (!cell.isEmpty())
+                        expected += cell.tile->tileset()->name() + QLatin1String("_")
+                                + QString::number(cell.tile->id());
+                }
+                const QStringList actual = reader.tileNamesAt(x, y, z);
+                if (actual != expected) {
+                    QFAIL(qPrintable(QString::fromLatin1("tiles differ at %1,%2,%3: expected '%4' got '%5'")
+                                     .arg(x).arg(y).arg(z)
+                                     .arg(expected.join(QLatin1Char(' ')))
+                                     .arg(actual.join(QLatin1Char(' ')))));
+                }
+
+                int roomID = -1;
+                for (int i = 0; i < mRooms.size(); ++i)
+                    if (mRooms[i].level == z && mRooms[i].rect.contains(x, y))
+                        roomID = i;
+                QCOMPARE(reader.roomIDAt(x, y, z), roomID);
+            }
+        }
+    }
+}
+
+void test_LotFileReader::roundTrip_data()
+{
+    QTest::addColumn<int>("width");
+    QTest::addColumn<int>("height");
+
+    QTest::newRow("cell") << 300 << 300;
+    QTest::newRow("partial chunks") << 35 << 23;
+}
+
+void test_LotFileReader::roundTrip()
+{
+    QFETCH(int, width);
+    QFETCH(int, height);
+
+    QScopedPointer<Map> map(createMap(width, height));
+    const QByteArray data = exportMap(map.data());
+
+    LotFileReader reader;
+    QVERIFY2(reader.read(data), qPrintable(reader.errorString()));
+    QCOMPARE(reader.version(), 0);
+    compare(map.data(), reader);
+}
+
+void test_LotFileReader::readFile()
+{
+    QScopedPointer<Map> map(createMap(35, 23));
+    const QByteArray data = exportMap(map.data());
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QLatin1String("0_0.pzby"));
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(data);
+    file.close();
+
+    LotFileReader reader;
+    QVERIFY2(reader.read(fileName), qPrintable(reader.errorString()));
+    compare(map.data(), reader);
+
+    QVERIFY(!reader.read(dir.filePath(QLatin1String("missing.pzby"))));
+    QVERIFY(!reader.errorString().isEmpty());
+}
+
+void test_LotFileReader::corruptFile_data()
+{
+    QTest::addColumn<int>("truncate");
+    QTest::addColumn<int>("offset");
+
+    QTest::newRow("empty") << 0 << -1;
+    QTest::newRow("header only") << 100 << -1;
+    QTest::newRow("missing last chunk") << -20 << -1;
+    QTest::newRow("bad magic") << -1 << 0;
+    QTest::newRow("bad version") << -1 << 4;
+    QTest::newRow("bad chunk data") << -1 << -8;
+}
+
+void test_LotFileReader::corruptFile()
+{
+    QFETCH(int, truncate);
+    QFETCH(int, offset);
+
+    QScopedPointer<Map> map(createMap(35, 23));
+    QByteArray data = exportMap(map.data());
+
+    if (truncate >= 0)
+        data.truncate(truncate);
+    else if (truncate < -1)
+        data.chop(-truncate);
+    if (offset != -1) {
+        // The last chunk ends with a run of empty squares past the edge of
+        // the map, so 8 bytes from the end is its -1 marker.
+        const int pos = offset >= 0 ? offset : data.size() + offset;
+        data[pos] = char(0x7F);
+    }
+
+    LotFileReader reader;
+    QVERIFY(!reader.read(data));
+    QVERIFY(!reader.errorString().isEmpty());
+}
+
+void test_LotFileReader::throughput_data()
+{
+    QTest::addColumn<bool>("read");
+
+    QTest::newRow("export") << false;
+    QTest::newRow("read") << true;
+}
+
+void test_LotFileReader::throughput()
+{
+    QFETCH(bool, read);
+
+    QScopedPointer<Map> map(createMap(300, 300));
+    int tileCount = 0;
+    QByteArray data = exportMap(map.data(), &tileCount);
+
+    LotFileReader reader;
+    QElapsedTimer timer;
+    int runs = 0;
+    timer.start();
+    QBENCHMARK {
+        if (read)
+            QVERIFY(reader.read(data));
+        else
+            data = exportMap(map.data());
+        ++runs;
+    }
+    const qint64 ns = timer.nsecsElapsed();
+    if (ns > 0)
+        qDebug() << (read ? "read" : "export") << "tiles/second:"
+                 << qint64(double(tileCount) * runs * 1e9 / ns)
+                 << "file size (KB):" << data.size() / 1024;
+
+    QVERIFY(reader.read(data));
+    compare(map.data(), reader);
+}
+
+QTEST_MAIN(test_LotFileReader)
+#include "test_lotfilereader.moc"
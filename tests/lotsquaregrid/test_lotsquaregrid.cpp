@@ -0,0 +1,244 @@
+#include "lotsquaregrid.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+/**
+ * Checks that LotSquareGrid::encodeChunk() writes exactly the bytes the
+ * square-by-square loop in NewMapBinaryFile::generateChunk() used to, both
+ * against a copy of that loop and against a golden file written by it.
+ */
+class test_LotSquareGrid : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void matchesReference();
+    void matchesGoldenFile();
+    void emptyChunk();
+    void emptyLevelsAcrossChunk();
+
+    void benchmark_data();
+    void benchmark();
+
+private:
+    void fill(LotSquareGrid &grid) const;
+    void fillSparse(LotSquareGrid &grid) const;
+    QByteArray encodeAll(const LotSquareGrid &grid, bool reference) const;
+    void referenceEncodeChunk(QDataStream &out, const LotSquareGrid &grid,
+                              int cx, int cy) const;
+
+    QVector<qint32> mGidToId;
+};
+
+static const int CHUNKS_X = 3;
+static const int CHUNKS_Y = 2;
+static const int LEVELS = 4;
+static const int MAX_GID = 50;
+
+// The golden file was generated with the same generator, so keep the two
+// in step.
+static quint32 sSeed;
+
+static int nextRandom()
+{
+    sSeed = sSeed * 1103515245u + 12345u;
+    return int((sSeed >> 16) & 0x7FFF);
+}
+
+void test_LotSquareGrid::initTestCase()
+{
+    mGidToId.fill(-1, MAX_GID + 1);
+    for (int gid = 1; gid <= MAX_GID; gid++)
+        mGidToId[gid] = gid + 7;
+}
+
+// Level 3 is empty everywhere, and so is the chunk at 2,1.
+void test_LotSquareGrid::fill(LotSquareGrid &grid) const
+{
+    sSeed = 12345;
+    grid.reset(CHUNKS_X, CHUNKS_Y, LEVELS);
+    const int width = CHUNKS_X * LotSquareGrid::ChunkWidth;
+    const int height = CHUNKS_Y * LotSquareGrid::ChunkHeight;
+    for (int z = 0; z < LEVELS; z++) {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                if (z == 3 || (x >= 20 && y >= 10))
+                    continue;
+                if (nextRandom() % 100 >= 30)
+                    continue;
+                const int index = grid.index(x, y, z);
+                const int count = 1 + nextRandom() % 3;
+                for (int i = 0; i < count; i++)
+                    grid.addTile(index, uint(1 + nextRandom() % MAX_GID));
+                if (nextRandom() % 4 == 0)
+                    grid.setRoomID(index, nextRandom() % 5);
+            }
+        }
+    }
+}
+
+// Like a typical cell: a nearly solid floor, a few walls above it, and
+// empty upper levels.
+void test_LotSquareGrid::fillSparse(LotSquareGrid &grid) const
+{
+    sSeed = 1;
+    const int chunks = 300 / LotSquareGrid::ChunkWidth;
+    grid.reset(chunks, chunks, 8);
+    for (int z = 0; z < 2; z++) {
+        const int percent = z ? 5 : 90;
+        for (int y = 0; y < 300; y++) {
+            for (int x = 0; x < 300; x++) {
+                if (nextRandom() % 100 < percent)
+                    grid.addTile(grid.index(x, y, z), uint(1 + nextRandom() % MAX_GID));
+            }
+        }
+    }
+}
+
+QByteArray test_LotSquareGrid::encodeAll(const LotSquareGrid &grid, bool reference) const
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    for (int cy = 0; cy < grid.chunksY(); cy++) {
+        for (int cx = 0; cx < grid.chunksX(); cx++) {
+            if (reference)
+                referenceEncodeChunk(out, grid, cx, cy);
+            else
+                grid.encodeChunk(out, cx, cy, mGidToId);
+        }
+    }
+    return data;
+}
+
+// The loop from NewMapBinaryFile::generateChunk() before it used the
+// occupancy masks.
+void test_LotSquareGrid::referenceEncodeChunk(QDataStream &out, const LotSquareGrid &grid,
+                                              int cx, int cy) const
+{
+    int notdonecount = 0;
+    for (int z = 0; z < grid.levels(); z++)  {
+        for (int x = 0; x < LotSquareGrid::ChunkWidth; x++) {
+            for (int y = 0; y < LotSquareGrid::ChunkHeight; y++) {
+                int gx = cx * LotSquareGrid::ChunkWidth + x;
+                int gy = cy * LotSquareGrid::ChunkHeight + y;
+                int index = grid.index(gx, gy, z);
+                int count = grid.count(index);
+                if (count == 0) {
+                    notdonecount++;
+                } else {
+                    if (notdonecount > 0) {
+                        out << qint32(-1);
+                        out << qint32(notdonecount);
+                    }
+                    notdonecount = 0;
+                    out << qint32(count + 1);
+                    out << qint32(grid.roomID(index));
+                }
+                const uint *gids = grid.tiles(index);
+                for (int i = 0; i < count; i++)
+                    out << qint32(mGidToId[int(gids[i])]);
+            }
+        }
+    }
+    if (notdonecount > 0) {
+        out << qint32(-1);
+        out << qint32(notdonecount);
+    }
+}
+
+void test_LotSquareGrid::matchesReference()
+{
+    LotSquareGrid grid;
+    fill(grid);
+    QCOMPARE(encodeAll(grid, false), encodeAll(grid, true));
+}
+
+void test_LotSquareGrid::matchesGoldenFile()
+{
+    QFile file(QLatin1String("../data/lotsquaregrid.golden"));
+    QVERIFY2(file.open(QIODevice::ReadOnly), qPrintable(file.errorString()));
+    const QByteArray golden = file.readAll();
+
+    LotSquareGrid grid;
+    fill(grid);
+    QCOMPARE(encodeAll(grid, false), golden);
+}
+
+void test_LotSquareGrid::emptyChunk()
+{
+    LotSquareGrid grid;
+    fill(grid);
+    QVERIFY(grid.isChunkEmpty(2, 1));
+    QVERIFY(!grid.isChunkEmpty(0, 0));
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    grid.encodeChunk(out, 2, 1, mGidToId);
+
+    QDataStream in(data);
+    in.setByteOrder(QDataStream::LittleEndian);
+    qint32 marker, skip;
+    in >> marker >> skip;
+    QCOMPARE(marker, qint32(-1));
+    QCOMPARE(skip, qint32(LEVELS * LotSquareGrid::SquaresPerChunk));
+    QVERIFY(in.atEnd());
+}
+
+// A run of empty squares continues from one level into the next.
+void test_LotSquareGrid::emptyLevelsAcrossChunk()
+{
+    LotSquareGrid grid;
+    grid.reset(1, 1, 3);
+    grid.addTile(grid.index(9, 9, 0), 1);
+    grid.addTile(grid.index(0, 1, 2), 2);
+    grid.addTile(grid.index(0, 1, 2), 3);
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    grid.encodeChunk(out, 0, 0, mGidToId);
+
+    QByteArray expected;
+    QDataStream exp(&expected, QIODevice::WriteOnly);
+    exp.setByteOrder(QDataStream::LittleEndian);
+    exp << qint32(-1) << qint32(99)
+        << qint32(2) << qint32(-1) << qint32(mGidToId[1])
+        << qint32(-1) << qint32(100 + 1)
+        << qint32(3) << qint32(-1) << qint32(mGidToId[2]) << qint32(mGidToId[3])
+        << qint32(-1) << qint32(98);
+    QCOMPARE(data, expected);
+    QCOMPARE(encodeAll(grid, false), encodeAll(grid, true));
+}
+
+void test_LotSquareGrid::benchmark_data()
+{
+    QTest::addColumn<bool>("reference");
+
+    QTest::newRow("square by square") << true;
+    QTest::newRow("occupancy masks") << false;
+}
+
+void test_LotSquareGrid::benchmark()
+{
+    QFETCH(bool, reference);
+
+    LotSquareGrid grid;
+    fillSparse(grid);
+
+    QByteArray data;
+    QBENCHMARK {
+        data = encodeAll(grid, reference);
+    }
+    QCOMPARE(data, encodeAll(grid, !reference));
+}
+
+QTEST_MAIN(test_LotSquareGrid)
+#include "test_lotsquaregrid.moc"
@@ -0,0 +1,169 @@
+#include "map.h"
+#include "mapreader.h"
+#include "mapwriter.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include "testmaps.h"
+
+#include <QBuffer>
+#include <QTemporaryDir>
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+/**
+ * Measures how long it takes to load a Project Zomboid sized cell (300x300,
+ * 100 tile layers) with the layer data decoded serially or in parallel, or
+ * from a binary map cache.
+ */
+class test_MapReaderBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void sameResult();
+    void binaryCache();
+
+    void readMap_data();
+    void readMap();
+
+private:
+    enum Mode { Serial, Parallel, Cached };
+    Map *read(Mode mode);
+    void compare(Map *map1, Map *map2);
+
+    QByteArray mData;
+    QTemporaryDir mDir;
+    QString mFileName;
+};
+
+static const int MAP_SIZE = 300;
+static const int LAYER_COUNT = 100;
+
+void test_MapReaderBenchmark::initTestCase()
+{
+    QScopedPointer<Tileset> tileset(TestMaps::createFloorsTileset());
+    QScopedPointer<Map> map(TestMaps::createCellMap(tileset.data(), MAP_SIZE, LAYER_COUNT));
+
+    QBuffer buffer(&mData);
+    buffer.open(QIODevice::WriteOnly);
+    MapWriter writer;
+    writer.setDtdEnabled(false);
+    writer.setLayerDataFormat(MapWriter::Base64Zlib);
+    writer.writeMap(map.data(), &buffer);
+
+    QVERIFY(mDir.isValid());
+    mFileName = mDir.filePath(QLatin1String("benchmark.tmx"));
+    QFile file(mFileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(mData);
+}
+
+Map *test_MapReaderBenchmark::read(Mode mode)
+{
+    MapReader reader;
+    reader.setDecodeLayersInParallel(mode == Parallel);
+    if (mode == Cached) {
+        reader.setUseBinaryCache(true);
+        return reader.readMap(mFileName);
+    }
+    QBuffer buffer(&mData);
+    buffer.open(QIODevice::ReadOnly);
+    return reader.readMap(&buffer);
+}
+
+namespace {
+
+// Maps read by MapReader own their tilesets.
+struct MapDeleter
+{
+    static void cleanup(Map *map)
+    {
+        if (map)
+            qDeleteAll(map->tilesets());
+        delete map;
+    }
+};
+
+typedef QScopedPointer<Map, MapDeleter> MapPointer;
+
+} // anonymous namespace
+
+void test_MapReaderBenchmark::sameResult()
+{
+    MapPointer serial(read(Serial));
+    MapPointer parallel(read(Parallel));
+    compare(serial.data(), parallel.data());
+}
+
+void test_MapReaderBenchmark::binaryCache()
+{
+    const QString cachePath = MapReader::binaryCachePath(mFileName);
+    QFile::remove(cachePath);
+
+    // The first read creates the cache, the second one uses it.
+    MapPointer serial(read(Serial));
+    MapPointer recorded(read(Cached));
+    QVERIFY(QFileInfo::exists(cachePath));
+    MapPointer cached(read(Cached));
+    compare(serial.data(), recorded.data());
+    compare(serial.data(), cached.data());
+
+    // A damaged cache is ignored and rewritten.
+    QFile file(cachePath);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write("garbage");
+    file.close();
+    MapPointer rewritten(read(Cached));
+    compare(serial.data(), rewritten.data());
+    QVERIFY(QFileInfo(cachePath).size() > 7);
+}
+
+void test_MapReaderBenchmark::compare(Map *map1, Map *map2)
+{
+    QVERIFY(map1);
+    QVERIFY(map2);
+    QCOMPARE(map2->layerCount(), LAYER_COUNT);
+
+    for (int i = 0; i < LAYER_COUNT; ++i) {
+        TileLayer *tl1 = map1->layerAt(i)->asTileLayer();
+        TileLayer *tl2 = map2->layerAt(i)->asTileLayer();
+        QCOMPARE(tl2->name(), tl1->name());
+        for (int y = 0; y < MAP_SIZE; ++y) {
+            for (int x = 0; x < MAP_SIZE; ++x) {
+                const Tile *t1 = tl1->cellAt(x, y).tile;
+                const Tile *t2 = tl2->cellAt(x, y).tile;
+                QCOMPARE(t1 ? t1->id() : -1, t2 ? t2->id() : -1);
+            }
+        }
+    }
+    QCOMPARE(map2->usedTilesets().size(), 1);
+}
+
+void test_MapReaderBenchmark::readMap_data()
+{
+    QTest::addColumn<int>("mode");
+    QTest::newRow("serial") << int(Serial);
+    QTest::newRow("parallel") << int(Parallel);
+    QTest::newRow("cached") << int(Cached);
+}
+
+void test_MapReaderBenchmark::readMap()
+{
+    QFETCH(int, mode);
+    if (mode == Cached) {
+        MapPointer map(read(Cached)); // create the cache
+        QVERIFY(map);
+    }
+    QBENCHMARK {
+        MapPointer map(read(Mode(mode)));
+        QVERIFY(map);
+    }
+}
+
+QTEST_MAIN(test_MapReaderBenchmark)
+#include "test_mapreaderbenchmark.moc"
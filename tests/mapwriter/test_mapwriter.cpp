@@ -0,0 +1,133 @@
+#include "map.h"
+#include "mapreader.h"
+#include "mapwriter.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include "testmaps.h"
+
+#include <QBuffer>
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+/**
+ * Measures how long it takes to save a Project Zomboid sized cell (300x300,
+ * 100 tile layers) with the layer data encoded serially or in parallel, and
+ * with the default or the fast zlib compression level.
+ */
+class test_MapWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void parallelSameResult();
+    void fastCompression();
+
+    void writeMap_data();
+    void writeMap();
+
+private:
+    QByteArray write(bool parallel) const;
+
+    Tileset *mTileset;
+    Map *mMap;
+};
+
+static const int MAP_SIZE = 300;
+static const int LAYER_COUNT = 100;
+
+void test_MapWriter::initTestCase()
+{
+    mTileset = TestMaps::createFloorsTileset();
+    mMap = TestMaps::createCellMap(mTileset, MAP_SIZE, LAYER_COUNT);
+}
+
+void test_MapWriter::cleanupTestCase()
+{
+    delete mMap;
+    delete mTileset;
+}
+
+QByteArray test_MapWriter::write(bool parallel) const
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    MapWriter writer;
+    writer.setDtdEnabled(false);
+    writer.setLayerDataFormat(MapWriter::Base64Zlib);
+    writer.setEncodeLayersInParallel(parallel);
+    writer.writeMap(mMap, &buffer);
+    return data;
+}
+
+void test_MapWriter::parallelSameResult()
+{
+    const QByteArray serial = write(false);
+    const QByteArray parallel = write(true);
+    QVERIFY(!serial.isEmpty());
+    QVERIFY(serial == parallel);
+}
+
+void test_MapWriter::fastCompression()
+{
+    const QByteArray normal = write(true);
+    mMap->setProperty(QLatin1String("FastCompression"), QLatin1String("true"));
+    const QByteArray fast = write(true);
+    mMap->setProperties(Properties());
+    qDebug() << "size (KB) default:" << normal.size() / 1024
+             << "fast:" << fast.size() / 1024;
+
+    // The fast level still writes plain zlib data.
+    QVERIFY(fast.contains("compression=\"zlib\""));
+
+    QBuffer buffer;
+    buffer.setData(fast);
+    buffer.open(QIODevice::ReadOnly);
+    MapReader reader;
+    QScopedPointer<Map> map(reader.readMap(&buffer));
+    QVERIFY(map);
+    QCOMPARE(map->layerCount(), LAYER_COUNT);
+    for (int i = 0; i < LAYER_COUNT; ++i) {
+        const TileLayer *tl1 = mMap->layerAt(i)->asTileLayer();
+        const TileLayer *tl2 = map->layerAt(i)->asTileLayer();
+        for (int y = 0; y < MAP_SIZE; ++y) {
+            for (int x = 0; x < MAP_SIZE; ++x) {
+                const Tile *t1 = tl1->cellAt(x, y).tile;
+                const Tile *t2 = tl2->cellAt(x, y).tile;
+                QCOMPARE(t1 ? t1->id() : -1, t2 ? t2->id() : -1);
+            }
+        }
+    }
+    qDeleteAll(map->tilesets());
+}
+
+void test_MapWriter::writeMap_data()
+{
+    QTest::addColumn<bool>("parallel");
+    QTest::addColumn<bool>("fast");
+    QTest::newRow("serial") << false << false;
+    QTest::newRow("parallel") << true << false;
+    QTest::newRow("serial fast") << false << true;
+    QTest::newRow("parallel fast") << true << true;
+}
+
+void test_MapWriter::writeMap()
+{
+    QFETCH(bool, parallel);
+    QFETCH(bool, fast);
+    if (fast)
+        mMap->setProperty(QLatin1String("FastCompression"), QLatin1String("true"));
+    QBENCHMARK {
+        QVERIFY(!write(parallel).isEmpty());
+    }
+    mMap->setProperties(Properties());
+}
+
+QTEST_MAIN(test_MapWriter)
+#include "test_mapwriter.moc"
@@ -1,4 +1,15 @@
 TEMPLATE=subdirs
 SUBDIRS = \
+    alphaflatten \
+    gidmapper \
+    lotfilereader \
+    lotsquaregrid \
     mapreader \
-    staggeredrenderer
+    mapreaderbenchmark \
+    mapwriter \
+    staggeredrenderer \
+    tilelayer \
+    tileset \
+    tilesetbinarycache \
+    zlevelrenderer \
+    ztilelayergroup
@@ -0,0 +1,290 @@
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QHash>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+/**
+ * Compares the chunked SparseTileGrid against the QHash and QVector storage
+ * it replaced.  The grids are filled the way typical Project Zomboid layers
+ * are: a 300x300 cell where most layers hold only a few percent of tiles,
+ * some are half full and the floor is nearly solid.
+ */
+class test_TileLayer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void sparseGrid();
+    void sparseGridOddSize();
+    void tileLayer();
+
+    void cellAt_data();
+    void cellAt();
+
+    void forEachNonEmptyCell();
+    void eraseRegion();
+
+    void scan_data();
+    void scan();
+
+private:
+    void fill(int percent, QList<QPoint> &points) const;
+
+    Tileset *mTileset;
+    Tile *mTile;
+};
+
+static const int MAP_SIZE = 300;
+
+void test_TileLayer::initTestCase()
+{
+    mTileset = new Tileset(QLatin1String("test"), 64, 128);
+    mTile = new Tile(64, 128, 0, mTileset);
+}
+
+void test_TileLayer::cleanupTestCase()
+{
+    delete mTile;
+    delete mTileset;
+}
+
+void test_TileLayer::fill(int percent, QList<QPoint> &points) const
+{
+    QRandomGenerator random(quint32(percent));
+    for (int y = 0; y < MAP_SIZE; ++y)
+        for (int x = 0; x < MAP_SIZE; ++x)
+            if (random.bounded(100) < percent)
+                points += QPoint(x, y);
+}
+
+void test_TileLayer::sparseGrid()
+{
+    SparseTileGrid grid(MAP_SIZE, MAP_SIZE);
+    QVERIFY(grid.isEmpty());
+    QCOMPARE(grid.allocatedChunkCount(), 0);
+
+    grid.replace(9, 9, Cell(mTile));
+    grid.replace(10, 10, Cell(mTile));
+    QCOMPARE(grid.count(), 2);
+    QCOMPARE(grid.allocatedChunkCount(), 2);
+    QVERIFY(grid.at(9, 9).tile == mTile);
+    QVERIFY(grid.at(10 + 10 * MAP_SIZE).tile == mTile);
+    QVERIFY(grid.at(9, 10).isEmpty());
+
+    // Replacing a cell with itself doesn't change the count.
+    grid.replace(9, 9, Cell(mTile));
+    QCOMPARE(grid.count(), 2);
+
+    // Erasing the last cell in a chunk frees the chunk.
+    grid.replace(9, 9, Cell());
+    QCOMPARE(grid.count(), 1);
+    QCOMPARE(grid.allocatedChunkCount(), 1);
+
+    // Copies are independent.
+    SparseTileGrid copy = grid;
+    copy.replace(10, 10, Cell());
+    QVERIFY(copy.isEmpty());
+    QVERIFY(grid.at(10, 10).tile == mTile);
+
+    grid.clear();
+    QVERIFY(grid.isEmpty());
+    QVERIFY(grid.at(10, 10).isEmpty());
+}
+
+void test_TileLayer::sparseGridOddSize()
+{
+    // Partial chunks along the right and bottom edges.
+    SparseTileGrid grid(25, 13);
+    for (int y = 0; y < 13; ++y)
+        for (int x = 0; x < 25; ++x)
+            grid.replace(x, y, Cell(mTile));
+    QCOMPARE(grid.count(), 25 * 13);
+    QCOMPARE(grid.allocatedChunkCount(), 3 * 2);
+    QVERIFY(grid.at(24, 12).tile == mTile);
+}
+
+void test_TileLayer::tileLayer()
+{
+    TileLayer layer(QString(), 0, 0, 35, 35);
+    QVERIFY(layer.isEmpty());
+    layer.setCell(34, 0, Cell(mTile));
+    QVERIFY(!layer.isEmpty());
+
+    layer.rotate(TileLayer::RotateRight);
+    QVERIFY(layer.cellAt(34, 34).tile == mTile);
+
+    layer.resize(QSize(40, 40), QPoint(5, 5));
+    QVERIFY(layer.cellAt(39, 39).tile == mTile);
+
+    layer.erase();
+    QVERIFY(layer.isEmpty());
+}
+
+void test_TileLayer::cellAt_data()
+{
+    QTest::addColumn<QString>("storage");
+    QTest::addColumn<int>("percent");
+
+    static const char *storage[] = { "hash", "vector", "chunked" };
+    static const int percent[] = { 2, 10, 50, 95 };
+    for (const char *s : storage) {
+        for (int p : percent) {
+            QByteArray tag = QByteArray(s) + ' ' + QByteArray::number(p) + '%';
+            QTest::newRow(tag.constData()) << QString::fromLatin1(s) << p;
+        }
+    }
+}
+
+void test_TileLayer::cellAt()
+{
+    QFETCH(QString, storage);
+    QFETCH(int, percent);
+
+    QList<QPoint> points;
+    fill(percent, points);
+
+    QHash<int,Cell> hash;
+    QVector<Cell> vector;
+    SparseTileGrid chunked(MAP_SIZE, MAP_SIZE);
+    int bytes = 0;
+
+    // The old SparseTileGrid switched to a vector past 1/3 full.
+    bool useHash = storage == QLatin1String("hash");
+    if (useHash && points.size() > MAP_SIZE * MAP_SIZE / 3)
+        QSKIP("the hash was never used at this density");
+
+    if (useHash) {
+        for (const QPoint &p : qAsConst(points))
+            hash.insert(p.x() + p.y() * MAP_SIZE, Cell(mTile));
+        // Node plus key plus bucket pointer, roughly.
+        bytes = hash.size() * int(sizeof(Cell) + sizeof(int) + 3 * sizeof(void*));
+    } else if (storage == QLatin1String("vector")) {
+        vector.resize(MAP_SIZE * MAP_SIZE);
+        for (const QPoint &p : qAsConst(points))
+            vector[p.x() + p.y() * MAP_SIZE] = Cell(mTile);
+        bytes = vector.size() * int(sizeof(Cell));
+    } else {
+        for (const QPoint &p : qAsConst(points))
+            chunked.replace(p.x(), p.y(), Cell(mTile));
+        bytes = chunked.allocatedChunkCount()
+                * SparseTileGrid::CHUNK_SIZE * SparseTileGrid::CHUNK_SIZE
+                * int(sizeof(Cell));
+    }
+    qDebug() << storage << percent << "% memory (KB):" << bytes / 1024;
+
+    const Cell emptyCell;
+    int found = 0;
+    QBENCHMARK {
+        found = 0;
+        for (int y = 0; y < MAP_SIZE; ++y) {
+            for (int x = 0; x < MAP_SIZE; ++x) {
+                const Cell *cell;
+                if (useHash) {
+                    QHash<int,Cell>::const_iterator it = hash.find(x + y * MAP_SIZE);
+                    cell = (it != hash.end()) ? &(*it) : &emptyCell;
+                } else if (!vector.isEmpty()) {
+                    cell = &vector.at(x + y * MAP_SIZE);
+                } else {
+                    cell = &chunked.at(x, y);
+                }
+                if (!cell->isEmpty())
+                    ++found;
+            }
+        }
+    }
+    QCOMPARE(found, points.size());
+}
+
+void test_TileLayer::forEachNonEmptyCell()
+{
+    QList<QPoint> points;
+    fill(10, points);
+    TileLayer layer(QString(), 0, 0, MAP_SIZE, MAP_SIZE);
+    for (const QPoint &p : qAsConst(points))
+        layer.setCell(p.x(), p.y(), Cell(mTile));
+
+    // A rect that isn't chunk-aligned and sticks out of the layer.
+    const QRect rects[] = {
+        QRect(0, 0, MAP_SIZE, MAP_SIZE),
+        QRect(13, 7, 41, 55),
+        QRect(-5, 290, 20, 20)
+    };
+    for (const QRect &rect : rects) {
+        QSet<int> expected;
+        for (const QPoint &p : qAsConst(points))
+            if (rect.contains(p))
+                expected.insert(p.x() + p.y() * MAP_SIZE);
+        QSet<int> visited;
+        layer.forEachNonEmptyCell(rect, [&](int x, int y, const Cell &cell) {
+            QVERIFY(cell.tile == mTile);
+            visited.insert(x + y * MAP_SIZE);
+        });
+        QCOMPARE(visited, expected);
+    }
+}
+
+void test_TileLayer::eraseRegion()
+{
+    TileLayer layer(QString(), 0, 0, 40, 40);
+    for (int y = 0; y < 40; ++y)
+        for (int x = 0; x < 40; ++x)
+            layer.setCell(x, y, Cell(mTile));
+    QRegion rgn(5, 5, 20, 3);
+    rgn += QRect(30, 0, 10, 40);
+    layer.erase(rgn);
+    for (int y = 0; y < 40; ++y)
+        for (int x = 0; x < 40; ++x)
+            QCOMPARE(layer.cellAt(x, y).isEmpty(), rgn.contains(QPoint(x, y)));
+}
+
+void test_TileLayer::scan_data()
+{
+    QTest::addColumn<bool>("iterate");
+    QTest::addColumn<int>("percent");
+
+    static const int percent[] = { 2, 10, 50 };
+    for (int p : percent) {
+        QTest::newRow(QByteArray("cellAt " + QByteArray::number(p) + '%').constData()) << false << p;
+        QTest::newRow(QByteArray("forEachNonEmptyCell " + QByteArray::number(p) + '%').constData()) << true << p;
+    }
+}
+
+void test_TileLayer::scan()
+{
+    QFETCH(bool, iterate);
+    QFETCH(int, percent);
+
+    QList<QPoint> points;
+    fill(percent, points);
+    TileLayer layer(QString(), 0, 0, MAP_SIZE, MAP_SIZE);
+    for (const QPoint &p : qAsConst(points))
+        layer.setCell(p.x(), p.y(), Cell(mTile));
+
+    int found = 0;
+    QBENCHMARK {
+        found = 0;
+        if (iterate) {
+            layer.forEachNonEmptyCell([&found](int, int, const Cell &) {
+                ++found;
+            });
+        } else {
+            for (int y = 0; y < MAP_SIZE; ++y)
+                for (int x = 0; x < MAP_SIZE; ++x)
+                    if (!layer.cellAt(x, y).isEmpty())
+                        ++found;
+        }
+    }
+    QCOMPARE(found, points.size());
+}
+
+QTEST_MAIN(test_TileLayer)
+#include "test_tilelayer.moc"
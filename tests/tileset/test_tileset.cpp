@@ -0,0 +1,123 @@
+#include "tile.h"
+#include "tileset.h"
+
+#include "testtilesheet.h"
+
+#include <QImage>
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+/**
+ * Checks that Tileset::loadFromImage() cuts the same tiles as copying each
+ * one out of the image and letting Tile::setImage() trim it, and measures how
+ * long it takes.
+ */
+class test_Tileset : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void loadFromImage_data();
+    void loadFromImage();
+
+    void benchmarkLoadFromImage_data();
+    void benchmarkLoadFromImage();
+
+private:
+    Tileset *createTileset(const QString &kind) const;
+
+    QImage mImage;
+};
+
+static const int IMAGE_WIDTH = 1024;
+static const int IMAGE_HEIGHT = 2048;
+
+void test_Tileset::initTestCase()
+{
+    mImage = TestTileSheet::createTileSheet(IMAGE_WIDTH, IMAGE_HEIGHT);
+}
+
+Tileset *test_Tileset::createTileset(const QString &kind) const
+{
+    Tileset *tileset = new Tileset(QLatin1String("tiles"), 64, 128);
+    if (kind == QLatin1String("2x"))
+        tileset->setImageSource2x(QLatin1String("tiles2x.png"));
+    else if (kind == QLatin1String("transparent color"))
+        tileset->setTransparentColor(Qt::white);
+    return tileset;
+}
+
+void test_Tileset::loadFromImage_data()
+{
+    QTest::addColumn<QString>("kind");
+    QTest::newRow("1x") << QString::fromLatin1("1x");
+    QTest::newRow("2x") << QString::fromLatin1("2x");
+    QTest::newRow("transparent color") << QString::fromLatin1("transparent color");
+}
+
+void test_Tileset::loadFromImage()
+{
+    QFETCH(QString, kind);
+
+    QScopedPointer<Tileset> tileset(createTileset(kind));
+    QVERIFY(tileset->loadFromImage(mImage, QLatin1String("tiles.png")));
+    QVERIFY(tileset->isLoaded());
+
+    const int tileWidth = tileset->imageSource2x().isEmpty() ? 64 : 128;
+    const int tileHeight = tileset->imageSource2x().isEmpty() ? 128 : 256;
+    const QImage image = mImage.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QCOMPARE(tileset->tileCount(), (IMAGE_WIDTH / tileWidth) * (IMAGE_HEIGHT / tileHeight));
+
+    // The same tiles, cut one at a time.
+    QScopedPointer<Tileset> reference(createTileset(kind));
+    int tileNum = 0;
+    for (int y = 0; y < IMAGE_HEIGHT; y += tileHeight) {
+        for (int x = 0; x < IMAGE_WIDTH; x += tileWidth, ++tileNum) {
+            QImage tileImage = image.copy(x, y, tileWidth, tileHeight);
+            if (kind == QLatin1String("transparent color")) {
+                for (int ty = 0; ty < tileHeight; ++ty)
+                    for (int tx = 0; tx < tileWidth; ++tx)
+                        if (tileImage.pixel(tx, ty) == QColor(Qt::white).rgba())
+                            tileImage.setPixel(tx, ty, qRgba(0, 0, 0, 0));
+            }
+            Tile expected(tileImage, tileNum, reference.data());
+            const Tile *tile = tileset->tileAt(tileNum);
+            QCOMPARE(tile->size(), expected.size());
+            QCOMPARE(tile->offset(), expected.offset());
+            QVERIFY(tile->image() == expected.image());
+        }
+    }
+
+    // Painting on a copy of a tile image doesn't change the tile.
+    for (int i = 0; i < tileset->tileCount(); ++i) {
+        const Tile *tile = tileset->tileAt(i);
+        if (tile->image().isNull())
+            continue;
+        const QImage before = tile->image().copy();
+        QImage copy = tile->image();
+        copy.fill(Qt::red);
+        QVERIFY(tile->image() == before);
+        break;
+    }
+}
+
+void test_Tileset::benchmarkLoadFromImage_data()
+{
+    loadFromImage_data();
+}
+
+void test_Tileset::benchmarkLoadFromImage()
+{
+    QFETCH(QString, kind);
+
+    QBENCHMARK {
+        QScopedPointer<Tileset> tileset(createTileset(kind));
+        tileset->loadFromImage(mImage, QLatin1String("tiles.png"));
+    }
+}
+
+QTEST_MAIN(test_Tileset)
+#include "test_tileset.moc"
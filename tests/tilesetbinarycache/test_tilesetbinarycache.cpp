@@ -0,0 +1,181 @@
+#include "tile.h"
+#include "tileset.h"
+#include "tilesetbinarycache.h"
+
+#include "testtilesheet.h"
+
+#include <QImage>
+#include <QTemporaryDir>
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+using namespace Tiled::Internal;
+
+/**
+ * Checks that a tileset read from a TilesetBinaryCache matches one cut from
+ * the image, and measures how long each takes.  Decoding the image stands in
+ * for a cold start, reading the cache for a warm one.
+ */
+class test_TilesetBinaryCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void sameResult_data();
+    void sameResult();
+    void outOfDate();
+
+    void loadTileset_data();
+    void loadTileset();
+
+private:
+    Tileset *createTileset(const QString &kind) const;
+    QString cachePath(const Tileset *tileset) const;
+    void compare(const Tileset *ts1, const Tileset *ts2);
+
+    QTemporaryDir mDir;
+    QString mImagePath;
+    QString mCacheDirectory;
+};
+
+static const int IMAGE_SIZE = 2048;
+
+void test_TilesetBinaryCache::initTestCase()
+{
+    QVERIFY(mDir.isValid());
+    mImagePath = mDir.filePath(QLatin1String("tiles.png"));
+    mCacheDirectory = mDir.filePath(QLatin1String("cache"));
+
+    const QImage image = TestTileSheet::createTileSheet(IMAGE_SIZE, IMAGE_SIZE);
+    QVERIFY(image.save(mImagePath));
+}
+
+Tileset *test_TilesetBinaryCache::createTileset(const QString &kind) const
+{
+    Tileset *tileset = new Tileset(QLatin1String("tiles"), 64, 128);
+    if (kind == QLatin1String("2x"))
+        tileset->setImageSource2x(mImagePath);
+    else if (kind == QLatin1String("transparent color"))
+        tileset->setTransparentColor(Qt::white);
+    return tileset;
+}
+
+QString test_TilesetBinaryCache::cachePath(const Tileset *tileset) const
+{
+    return TilesetBinaryCache::cachePath(mCacheDirectory, mImagePath, tileset);
+}
+
+void test_TilesetBinaryCache::compare(const Tileset *ts1, const Tileset *ts2)
+{
+    QVERIFY(ts2->isLoaded());
+    QCOMPARE(ts2->imageSource(), ts1->imageSource());
+    QCOMPARE(ts2->imageWidth(), ts1->imageWidth());
+    QCOMPARE(ts2->imageHeight(), ts1->imageHeight());
+    QCOMPARE(ts2->columnCount(), ts1->columnCount());
+    QCOMPARE(ts2->tileCount(), ts1->tileCount());
+    for (int i = 0; i < ts1->tileCount(); ++i) {
+        const Tile *t1 = ts1->tileAt(i);
+        const Tile *t2 = ts2->tileAt(i);
+        QCOMPARE(t2->size(), t1->size());
+        QCOMPARE(t2->offset(), t1->offset());
+        QVERIFY(t2->image() == t1->image());
+    }
+}
+
+void test_TilesetBinaryCache::sameResult_data()
+{
+    QTest::addColumn<QString>("kind");
+    QTest::newRow("1x") << QString::fromLatin1("1x");
+    QTest::newRow("2x") << QString::fromLatin1("2x");
+    QTest::newRow("transparent color") << QString::fromLatin1("transparent color");
+}
+
+void test_TilesetBinaryCache::sameResult()
+{
+    QFETCH(QString, kind);
+
+    QScopedPointer<Tileset> decoded(createTileset(kind));
+    QVERIFY(decoded->loadFromImage(QImage(mImagePath), mImagePath));
+    QVERIFY(TilesetBinaryCache::write(cachePath(decoded.data()), mImagePath, decoded.data()));
+
+    QScopedPointer<Tileset> cached(createTileset(kind));
+    QVERIFY(TilesetBinaryCache::read(cachePath(cached.data()), mImagePath,
+                                     cached.data(), mImagePath));
+    compare(decoded.data(), cached.data());
+
+    // Reading into a tileset that already has tiles replaces them.
+    QVERIFY(TilesetBinaryCache::read(cachePath(cached.data()), mImagePath,
+                                     cached.data(), mImagePath));
+    compare(decoded.data(), cached.data());
+
+    // The tile images keep the mapped file alive after the tileset is gone.
+    QVector<QImage> images;
+    for (int i = 0; i < cached->tileCount(); ++i)
+        images += cached->tileAt(i)->image();
+    cached.reset();
+    for (int i = 0; i < decoded->tileCount(); ++i)
+        QVERIFY(images[i] == decoded->tileAt(i)->image());
+}
+
+void test_TilesetBinaryCache::outOfDate()
+{
+    QScopedPointer<Tileset> decoded(createTileset(QLatin1String("1x")));
+    QVERIFY(decoded->loadFromImage(QImage(mImagePath), mImagePath));
+    const QString path = cachePath(decoded.data());
+    QVERIFY(TilesetBinaryCache::write(path, mImagePath, decoded.data()));
+
+    // Tiles of another size or color have their own cache.
+    QScopedPointer<Tileset> other(createTileset(QLatin1String("transparent color")));
+    QVERIFY(cachePath(other.data()) != path);
+    QVERIFY(!TilesetBinaryCache::read(path, mImagePath, other.data(), mImagePath));
+    QVERIFY(!other->isLoaded());
+
+    // A changed image makes the cache out of date.
+    QFile image(mImagePath);
+    QVERIFY(image.open(QIODevice::ReadWrite));
+    const QDateTime modified = image.fileTime(QFileDevice::FileModificationTime);
+    QVERIFY(image.setFileTime(modified.addSecs(10), QFileDevice::FileModificationTime));
+    QScopedPointer<Tileset> cached(createTileset(QLatin1String("1x")));
+    QVERIFY(!TilesetBinaryCache::read(path, mImagePath, cached.data(), mImagePath));
+    QVERIFY(image.setFileTime(modified, QFileDevice::FileModificationTime));
+    image.close();
+    QVERIFY(TilesetBinaryCache::read(path, mImagePath, cached.data(), mImagePath));
+
+    // So does a damaged one.
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    file.resize(file.size() / 2);
+    file.close();
+    QScopedPointer<Tileset> damaged(createTileset(QLatin1String("1x")));
+    QVERIFY(!TilesetBinaryCache::read(path, mImagePath, damaged.data(), mImagePath));
+}
+
+void test_TilesetBinaryCache::loadTileset_data()
+{
+    QTest::addColumn<bool>("cached");
+    QTest::newRow("decode") << false;
+    QTest::newRow("cached") << true;
+}
+
+void test_TilesetBinaryCache::loadTileset()
+{
+    QFETCH(bool, cached);
+
+    QScopedPointer<Tileset> decoded(createTileset(QLatin1String("1x")));
+    QVERIFY(decoded->loadFromImage(QImage(mImagePath), mImagePath));
+    const QString path = cachePath(decoded.data());
+    QVERIFY(TilesetBinaryCache::write(path, mImagePath, decoded.data()));
+
+    QBENCHMARK {
+        QScopedPointer<Tileset> tileset(createTileset(QLatin1String("1x")));
+        if (cached)
+            QVERIFY(TilesetBinaryCache::read(path, mImagePath, tileset.data(), mImagePath));
+        else
+            QVERIFY(tileset->loadFromImage(QImage(mImagePath), mImagePath));
+    }
+}
+
+QTEST_MAIN(test_TilesetBinaryCache)
+#include "test_tilesetbinarycache.moc"
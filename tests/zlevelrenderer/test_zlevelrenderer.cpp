@@ -0,0 +1,271 @@
+#include "map.h"
+#include "maprenderer.h"
+#include "tile.h"
+#include "tilelayer.h"
+#include "tileset.h"
+#include "zlevelrenderer.h"
+#include "ztilelayergroup.h"
+
+#include <QImage>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+/**
+ * A layer group that draws the non-empty cells of its layers from bottom to
+ * top.
+ */
+class TestLayerGroup : public ZTileLayerGroup
+{
+public:
+    TestLayerGroup(Map *map)
+        : ZTileLayerGroup(map, 0)
+    {}
+
+    void prepareDrawing(const MapRenderer *renderer, const QRect &rect) override
+    {
+        Q_UNUSED(renderer)
+        Q_UNUSED(rect)
+    }
+
+    bool orderedCellsAt(const QPoint &pos, QVector<const Cell*> &cells,
+                        QVector<qreal> &opacities) const override
+    {
+        for (const TileLayer *tl : mLayers) {
+            if (!tl->contains(pos))
+                continue;
+            const Cell *cell = &tl->cellAt(pos);
+            if (!cell->isEmpty())
+                cells.append(cell);
+        }
+        opacities.fill(1.0, cells.size());
+        return !cells.isEmpty();
+    }
+};
+
+/**
+ * Measures the time ZLevelRenderer::drawTileLayerGroup() spends on one frame
+ * of a Project Zomboid level with a dozen layers, and checks that drawing
+ * with CellRenderer or in bands gives the same pixels.
+ */
+class test_ZLevelRenderer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void drawTileLayerGroup();
+
+    void cellRenderer_data();
+    void cellRenderer();
+
+    void bands();
+
+private:
+    TestLayerGroup *createGroup() const;
+
+    Tileset *mTileset;
+    Map *mMap;
+};
+
+static const int MAP_SIZE = 100;
+
+void test_ZLevelRenderer::initTestCase()
+{
+    QImage image(1024, 1024, QImage::Format_ARGB32_Premultiplied);
+    image.fill(qRgba(128, 96, 64, 255));
+    mTileset = new Tileset(QLatin1String("floors"), 64, 128);
+    QVERIFY(mTileset->loadFromImage(image, QLatin1String("floors.png")));
+
+    mMap = new Map(Map::LevelIsometric, MAP_SIZE, MAP_SIZE, 64, 32);
+    mMap->addTileset(mTileset);
+
+    static const char *names[] = {
+        "0_Floor", "0_FloorOverlay", "0_FloorOverlay2", "0_Vegetation",
+        "0_Walls", "0_Walls2", "0_RoofCap", "0_WallOverlay", "0_Furniture",
+        "0_Furniture2", "0_Roof", "0_Furniture_AboveLot"
+    };
+    QRandomGenerator random(1);
+    int i = 0;
+    for (const char *name : names) {
+        TileLayer *tl = new TileLayer(QLatin1String(name), 0, 0, MAP_SIZE, MAP_SIZE);
+        const int percent = i++ ? 10 : 95;
+        for (int y = 0; y < MAP_SIZE; ++y)
+            for (int x = 0; x < MAP_SIZE; ++x)
+                if (random.bounded(100) < percent)
+                    tl->setCell(x, y, Cell(mTileset->tileAt(random.bounded(mTileset->tileCount()))));
+        mMap->addLayer(tl);
+    }
+}
+
+void test_ZLevelRenderer::cleanupTestCase()
+{
+    delete mMap;
+    delete mTileset;
+}
+
+TestLayerGroup *test_ZLevelRenderer::createGroup() const
+{
+    TestLayerGroup *group = new TestLayerGroup(mMap);
+    for (int i = 0; i < mMap->layerCount(); ++i) {
+        TileLayer *tl = mMap->layerAt(i)->asTileLayer();
+        group->addTileLayer(tl, i);
+        tl->setGroup(0);
+    }
+    return group;
+}
+
+void test_ZLevelRenderer::drawTileLayerGroup()
+{
+    QScopedPointer<TestLayerGroup> group(createGroup());
+    ZLevelRenderer renderer(mMap);
+
+    // One 1920x1080 frame from the middle of the map.
+    const QPointF center = renderer.tileToPixelCoords(MAP_SIZE / 2, MAP_SIZE / 2);
+    const QRectF exposed(center.x() - 960, center.y() - 540, 1920, 1080);
+    QImage frame(1920, 1080, QImage::Format_ARGB32_Premultiplied);
+
+    QBENCHMARK {
+        frame.fill(Qt::transparent);
+        QPainter painter(&frame);
+        painter.translate(-exposed.topLeft());
+        renderer.drawTileLayerGroup(&painter, group.data(), exposed);
+    }
+}
+
+void test_ZLevelRenderer::cellRenderer_data()
+{
+    QTest::addColumn<qreal>("scale");
+    QTest::newRow("1x") << qreal(1);
+    QTest::newRow("2x") << qreal(2);
+    QTest::newRow("0.5x") << qreal(0.5);
+}
+
+/**
+ * CellRenderer must produce the same pixels as setting the painter's
+ * transform for each tile, for plain, flipped and translucent tiles.
+ */
+void test_ZLevelRenderer::cellRenderer()
+{
+    QFETCH(qreal, scale);
+
+    QImage tile(64, 128, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < tile.height(); ++y)
+        for (int x = 0; x < tile.width(); ++x)
+            tile.setPixel(x, y, qRgba(x * 4, y * 2, 128, 255));
+
+    const QTransform transforms[] = {
+        QTransform(1, 0, 0, 1, 10, 20),
+        QTransform(-1, 0, 0, 1, 150, 20),
+        QTransform(1, 0, 0, -1, 200, 140),
+        QTransform(0, 1, 1, 0, 40, 160),
+        QTransform(1, 0, 0, 1, 90, 60)
+    };
+    const qreal opacities[] = { 1.0, 1.0, 0.5, 1.0, 0.99 };
+
+    QImage expected(512, 512, QImage::Format_ARGB32_Premultiplied);
+    expected.fill(Qt::transparent);
+    {
+        QPainter painter(&expected);
+        painter.scale(scale, scale);
+        const QTransform baseTransform = painter.transform();
+        for (int i = 0; i < 5; ++i) {
+            painter.setTransform(transforms[i] * baseTransform);
+            painter.setOpacity(opacities[i]);
+            painter.drawImage(0, 0, tile);
+        }
+    }
+
+    QImage actual(512, 512, QImage::Format_ARGB32_Premultiplied);
+    actual.fill(Qt::transparent);
+    {
+        QPainter painter(&actual);
+        painter.scale(scale, scale);
+        const QTransform baseTransform = painter.transform();
+        {
+            CellRenderer cellRenderer(&painter);
+            for (int i = 0; i < 5; ++i)
+                cellRenderer.render(tile, transforms[i], opacities[i]);
+        }
+        QCOMPARE(painter.transform(), baseTransform);
+        QCOMPARE(painter.opacity(), qreal(1));
+    }
+
+    QCOMPARE(actual, expected);
+}
+
+/**
+ * Draws one band of a frame, as MapImageBandTask does on MapImageManager's
+ * JobScheduler.  A QThreadPool stands in for the scheduler here.
+ */
+class BandTask : public QRunnable
+{
+public:
+    BandTask(const ZLevelRenderer *renderer, ZTileLayerGroup *group,
+             const QRectF &exposed, QImage &frame, int top, int height) :
+        mRenderer(renderer),
+        mGroup(group),
+        mExposed(exposed),
+        mTop(top),
+        mBand(frame.bits() + top * frame.bytesPerLine(), frame.width(), height,
+              frame.bytesPerLine(), frame.format())
+    {}
+
+    void run()
+    {
+        QPainter painter(&mBand);
+        painter.translate(-mExposed.left(), -mExposed.top() - mTop);
+        mRenderer->drawTileLayerGroup(&painter, mGroup,
+                                      QRectF(mExposed.left(), mExposed.top() + mTop,
+                                             mBand.width(), mBand.height()));
+    }
+
+private:
+    const ZLevelRenderer *mRenderer;
+    ZTileLayerGroup *mGroup;
+    QRectF mExposed;
+    int mTop;
+    QImage mBand;
+};
+
+/**
+ * Drawing a frame as bands on several threads gives the same pixels as
+ * drawing it in one go.
+ */
+void test_ZLevelRenderer::bands()
+{
+    QScopedPointer<TestLayerGroup> group(createGroup());
+    ZLevelRenderer renderer(mMap);
+
+    const QPointF center = renderer.tileToPixelCoords(MAP_SIZE / 2, MAP_SIZE / 2);
+    const QRectF exposed(center.x() - 480, center.y() - 270, 960, 540);
+
+    QImage expected(960, 540, QImage::Format_ARGB32_Premultiplied);
+    expected.fill(Qt::transparent);
+    {
+        QPainter painter(&expected);
+        painter.translate(-exposed.topLeft());
+        renderer.drawTileLayerGroup(&painter, group.data(), exposed);
+    }
+
+    QImage actual(960, 540, QImage::Format_ARGB32_Premultiplied);
+    actual.fill(Qt::transparent);
+    group->prepareDrawing(&renderer, exposed.toAlignedRect());
+    renderer.setLayerGroupsPrepared(true);
+    QThreadPool pool;
+    const int bandHeight = 540 / 6;
+    for (int top = 0; top < actual.height(); top += bandHeight)
+        pool.start(new BandTask(&renderer, group.data(), exposed, actual, top, bandHeight));
+    pool.waitForDone();
+
+    QCOMPARE(actual, expected);
+}
+
+QTEST_MAIN(test_ZLevelRenderer)
+#include "test_zlevelrenderer.moc"
@@ -0,0 +1,235 @@
+#include "regionbitmap.h"
+#include "ztilelayergroup.h"
+
+#include <QRandomGenerator>
+#include <QtTest/QtTest>
+
+using namespace Tiled;
+
+/**
+ * CompositeLayerGroup::orderedCellsAt() runs for every layer of every cell
+ * drawn.  Instead of comparing layer names and searching the suppressed
+ * QRegion each time, it uses the ZTileLayerGroup::layerRoles() bits worked
+ * out when the layers change and a RegionBitmap of the suppressed area.
+ * These check that both give the same answers as what they replace, and
+ * measure the difference.
+ */
+class test_ZTileLayerGroup : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void layerRoles_data();
+    void layerRoles();
+
+    void regionBitmap_data();
+    void regionBitmap();
+    void emptyRegion();
+
+    void benchmarkLayerNames_data();
+    void benchmarkLayerNames();
+    void benchmarkSuppressed_data();
+    void benchmarkSuppressed();
+};
+
+static const QString sNoBlend = QLatin1String("0_Curbs");
+
+static const char *sLayerNames[] = {
+    "0_Floor", "0_FloorOverlay", "0_Curbs", "0_Walls", "0_Furniture",
+    "0_Vegetation", "0_RoofCap", "0_Floor_AboveLot", "0_Walls_AboveLot"
+};
+static const int sLayerNameCount = sizeof(sLayerNames) / sizeof(sLayerNames[0]);
+
+// What orderedCellsAt() used to work out for each layer.
+static quint8 referenceRoles(const QString &name, int level, int index,
+                             const QString &noBlendLayer)
+{
+    quint8 roles = 0;
+    if (!level && !index && name == QLatin1String("0_Floor"))
+        roles |= ZTileLayerGroup::RoleFloor;
+    if (name.contains(QLatin1String("_AboveLot")))
+        roles |= ZTileLayerGroup::RoleAboveLot;
+    if (name == noBlendLayer)
+        roles |= ZTileLayerGroup::RoleNoBlend;
+    return roles;
+}
+
+static QRegion randomRegion(QRandomGenerator &random, const QRect &area,
+                            int rects)
+{
+    QRegion region;
+    for (int i = 0; i < rects; i++) {
+        const int x = area.left() + random.bounded(area.width());
+        const int y = area.top() + random.bounded(area.height());
+        const int w = 1 + random.bounded(qMin(40, area.right() - x + 1));
+        const int h = 1 + random.bounded(qMin(40, area.bottom() - y + 1));
+        region |= QRect(x, y, w, h);
+    }
+    return region;
+}
+
+void test_ZTileLayerGroup::layerRoles_data()
+{
+    QTest::addColumn<QString>("name");
+    QTest::addColumn<int>("level");
+    QTest::addColumn<int>("index");
+    QTest::addColumn<int>("roles");
+
+    QTest::newRow("floor") << "0_Floor" << 0 << 0 << int(ZTileLayerGroup::RoleFloor);
+    QTest::newRow("floor not first") << "0_Floor" << 0 << 1 << 0;
+    QTest::newRow("floor above ground") << "0_Floor" << 1 << 0 << 0;
+    QTest::newRow("above lot") << "1_Walls_AboveLot" << 1 << 3
+                               << int(ZTileLayerGroup::RoleAboveLot);
+    QTest::newRow("no blend") << "0_Curbs" << 0 << 2
+                              << int(ZTileLayerGroup::RoleNoBlend);
+    QTest::newRow("plain") << "0_Walls" << 0 << 3 << 0;
+}
+
+void test_ZTileLayerGroup::layerRoles()
+{
+    QFETCH(QString, name);
+    QFETCH(int, level);
+    QFETCH(int, index);
+    QFETCH(int, roles);
+
+    QCOMPARE(int(ZTileLayerGroup::layerRoles(name, level, index, sNoBlend)), roles);
+
+    // Every name at every position, against the string compares it replaces.
+    for (int i = 0; i < sLayerNameCount; i++) {
+        const QString layerName = QLatin1String(sLayerNames[i]);
+        for (int l = 0; l < 2; l++) {
+            QCOMPARE(ZTileLayerGroup::layerRoles(layerName, l, i, sNoBlend),
+                     referenceRoles(layerName, l, i, sNoBlend));
+            QCOMPARE(ZTileLayerGroup::layerRoles(layerName, l, 0, QString()),
+                     referenceRoles(layerName, l, 0, QString()));
+        }
+    }
+}
+
+void test_ZTileLayerGroup::regionBitmap_data()
+{
+    QTest::addColumn<int>("seed");
+    QTest::addColumn<QRect>("area");
+    QTest::addColumn<int>("rects");
+
+    QTest::newRow("one rect") << 1 << QRect(0, 0, 300, 300) << 1;
+    QTest::newRow("few rects") << 2 << QRect(0, 0, 300, 300) << 5;
+    QTest::newRow("many rects") << 3 << QRect(0, 0, 300, 300) << 60;
+    QTest::newRow("negative origin") << 4 << QRect(-150, -90, 300, 300) << 20;
+}
+
+void test_ZTileLayerGroup::regionBitmap()
+{
+    QFETCH(int, seed);
+    QFETCH(QRect, area);
+    QFETCH(int, rects);
+
+    QRandomGenerator random(quint32(seed));
+    const QRegion region = randomRegion(random, area, rects);
+    const RegionBitmap bitmap(region);
+
+    QCOMPARE(bitmap.bounds(), region.boundingRect());
+
+    const QRect test = area.adjusted(-2, -2, 2, 2);
+    for (int y = test.top(); y <= test.bottom(); y++) {
+        for (int x = test.left(); x <= test.right(); x++) {
+            const QPoint pos(x, y);
+            if (bitmap.contains(pos) != region.contains(pos))
+                QFAIL(qPrintable(QString(QLatin1String("differs at %1,%2")).arg(x).arg(y)));
+        }
+    }
+}
+
+void test_ZTileLayerGroup::emptyRegion()
+{
+    RegionBitmap bitmap;
+    QVERIFY(!bitmap.contains(QPoint(0, 0)));
+
+    bitmap.setRegion(QRegion(QRect(5, 5, 2, 2)));
+    QVERIFY(bitmap.contains(QPoint(6, 6)));
+
+    bitmap.setRegion(QRegion());
+    QVERIFY(!bitmap.contains(QPoint(6, 6)));
+    QVERIFY(!bitmap.contains(QPoint(0, 0)));
+}
+
+void test_ZTileLayerGroup::benchmarkLayerNames_data()
+{
+    QTest::addColumn<bool>("roleBits");
+
+    QTest::newRow("names") << false;
+    QTest::newRow("role bits") << true;
+}
+
+// The per-cell checks orderedCellsAt() makes of each layer, for a 300x300
+// cell's worth of squares.
+void test_ZTileLayerGroup::benchmarkLayerNames()
+{
+    QFETCH(bool, roleBits);
+
+    QVector<QString> names;
+    QVector<quint8> roles;
+    for (int i = 0; i < sLayerNameCount; i++) {
+        names += QLatin1String(sLayerNames[i]);
+        roles += ZTileLayerGroup::layerRoles(names.last(), 0, i, sNoBlend);
+    }
+
+    int count = 0;
+    QBENCHMARK {
+        count = 0;
+        for (int square = 0; square < 300 * 300; square++) {
+            for (int i = 0; i < names.size(); i++) {
+                if (roleBits) {
+                    const quint8 r = roles[i];
+                    count += (r & ZTileLayerGroup::RoleFloor) != 0;
+                    count += (r & ZTileLayerGroup::RoleAboveLot) != 0;
+                    count += (r & ZTileLayerGroup::RoleNoBlend) != 0;
+                } else {
+                    const QString &name = names[i];
+                    count += (!i && name == QLatin1String("0_Floor"));
+                    count += name.contains(QLatin1String("_AboveLot"));
+                    count += (name == sNoBlend);
+                }
+            }
+        }
+    }
+    QCOMPARE(count, 300 * 300 * 4);
+}
+
+void test_ZTileLayerGroup::benchmarkSuppressed_data()
+{
+    QTest::addColumn<bool>("bitmap");
+    QTest::addColumn<int>("rects");
+
+    QTest::newRow("QRegion, 5 rects") << false << 5;
+    QTest::newRow("RegionBitmap, 5 rects") << true << 5;
+    QTest::newRow("QRegion, 60 rects") << false << 60;
+    QTest::newRow("RegionBitmap, 60 rects") << true << 60;
+}
+
+// One suppressed-area lookup per square of a 300x300 cell.
+void test_ZTileLayerGroup::benchmarkSuppressed()
+{
+    QFETCH(bool, bitmap);
+    QFETCH(int, rects);
+
+    QRandomGenerator random(quint32(rects));
+    const QRegion region = randomRegion(random, QRect(0, 0, 300, 300), rects);
+    const RegionBitmap regionBitmap(region);
+
+    int count = 0;
+    QBENCHMARK {
+        count = 0;
+        for (int y = 0; y < 300; y++) {
+            for (int x = 0; x < 300; x++) {
+                if (bitmap ? regionBitmap.contains(QPoint(x, y))
+                           : region.contains(QPoint(x, y)))
+                    count++;
+            }
+        }
+    }
+    QVERIFY(count > 0);
+}
+
+QTEST_MAIN(test_ZTileLayerGroup)
+#include "test_ztilelayergroup.moc"